@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// Hardware counters of the calling thread, read with perf_event_open. When the
+// kernel refuses to open them (no PMU in a VM, perf_event_paranoid too high)
+// or on other platforms, isAvailable() is false and every read returns 0.
+class PerfCounters {
+public:
+	enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTERS_SIZE };
+
+	PerfCounters() {
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			this->fds[i] = -1;
+			this->values[i] = 0;
+		}
+#ifdef __linux__
+		const uint64_t configs[COUNTERS_SIZE] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES
+		};
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = configs[i];
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			this->fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+#endif
+	}
+
+	~PerfCounters() {
+#ifdef __linux__
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			if (this->fds[i] >= 0) close(this->fds[i]);
+		}
+#endif
+	}
+
+	bool isAvailable() const {
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			if (this->fds[i] < 0) return false;
+		}
+
+		return true;
+	}
+
+	void start() {
+#ifdef __linux__
+		if (!this->isAvailable()) return;
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			ioctl(this->fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(this->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	void stop() {
+#ifdef __linux__
+		if (!this->isAvailable()) return;
+		for (int i = 0; i < COUNTERS_SIZE; i++) {
+			ioctl(this->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+			uint64_t value = 0;
+			if (read(this->fds[i], &value, sizeof(value)) != sizeof(value)) value = 0;
+			this->values[i] = value;
+		}
+#endif
+	}
+
+	uint64_t get(Counter counter) const {
+		return this->values[counter];
+	}
+
+private:
+	int fds[COUNTERS_SIZE];
+	uint64_t values[COUNTERS_SIZE];
+};
+
+#endif
@@ -0,0 +1,469 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/recommender.h"
+#include "../include/Utils.h"
+#include "../include/RatingMatrix.h"
+#include "../include/BinaryMatrix.h"
+#include "../include/PostingList.h"
+#include "../include/Arena.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+// Native benchmarks of the kernels behind the addon, without V8 marshalling
+// and callbacks in the loop. Built as the recommender_bench target:
+//
+//   node-gyp rebuild && ./build/Release/recommender_bench [options]
+//
+// Options:
+//   --filter=<text>        Run only benchmarks whose name contains text.
+//   --sizes=<n,...>        Vector lengths and matrix columns. (Default: 64,1024,16384)
+//   --densities=<d,...>    Share of rated cells in matrices. (Default: 0.01,0.1,0.5)
+//   --documents=<n,...>    Corpus sizes for the text kernels. (Default: 16,128,512)
+//   --rows=<n>             Rows of the rating matrices. (Default: 1000)
+//   --min-time=<ms>        Minimum measured time per benchmark. (Default: 200)
+//   --counters             Report hardware counters per op (Linux only).
+
+const int RANDOM_SEED = 42;
+const int ZIPF_VOCABULARY_SIZE = 5000;
+const int WORDS_PER_DOCUMENT = 20;
+const int WORDS_PER_QUERY = 8;
+
+struct BenchOptions {
+	string filter;
+	vector<int> sizes;
+	vector<double> densities;
+	vector<int> documents;
+	int rows;
+	double minTime;
+	bool counters;
+
+	BenchOptions() : rows(1000), minTime(200), counters(false) {
+		this->sizes = { 64, 1024, 16384 };
+		this->densities = { 0.01, 0.1, 0.5 };
+		this->documents = { 16, 128, 512 };
+	}
+};
+
+// Keeps results alive so the measured calls are not optimized away.
+static volatile double sink;
+
+// Counts the allocations of the whole process, so the allocs/op of a kernel
+// show whether it allocates once it is warm. Every form of new and delete is
+// replaced, so all of them are counted and all of them allocate with malloc.
+static atomic<uint64_t> allocations(0);
+
+static void *allocate(size_t size) {
+	allocations.fetch_add(1, memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+// Kept out of line, so the compiler doesn't see the pointers of new reach free
+// once delete is inlined into the caller, and warn about a mismatch.
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#endif
+static void deallocate(void *pointer) {
+	free(pointer);
+}
+
+void *operator new(size_t size) {
+	void *pointer = allocate(size);
+	if (!pointer) throw bad_alloc();
+	return pointer;
+}
+
+void *operator new[](size_t size) {
+	void *pointer = allocate(size);
+	if (!pointer) throw bad_alloc();
+	return pointer;
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void *pointer) noexcept {
+	deallocate(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	deallocate(pointer);
+}
+
+void operator delete(void *pointer, const nothrow_t &) noexcept {
+	deallocate(pointer);
+}
+
+void operator delete[](void *pointer, const nothrow_t &) noexcept {
+	deallocate(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *pointer, size_t) noexcept {
+	deallocate(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	deallocate(pointer);
+}
+#endif
+
+// The private kernels of Recommender are reached through this friend.
+class RecommenderBench {
+public:
+	template <typename T>
+	static Recommender::Neighbourhood getSimilarities(Recommender &r, const RatingMatrix<T> &ratings, int rowIndex, double normA) {
+		return r.getSimilarities(ratings, ratings.getRow(rowIndex), rowIndex, -1, normA);
+	}
+
+	static vector<string> splitLineToWords(Recommender &r, const string &line, bool useStopWords) {
+		r.useStopWords = useStopWords;
+		return r.splitLineToWords(line);
+	}
+};
+
+class BenchRunner {
+public:
+	explicit BenchRunner(const BenchOptions &options) : options(options) {
+		if (options.counters && !this->perfCounters.isAvailable()) {
+			fprintf(stderr, "Hardware counters are not available, running without them.\n");
+		}
+		this->printHeader();
+	}
+
+	bool isSelected(const string &name) const {
+		return this->options.filter.empty() || name.find(this->options.filter) != string::npos;
+	}
+
+	// Runs fn in batches which double in size until a batch takes a tenth of
+	// the minimum time, then measures for at least the minimum time. Items are
+	// the units of throughput, e.g. vector elements or documents.
+	template <typename Fn>
+	void run(const string &name, const string &params, double itemsPerOp, Fn fn) {
+		if (!this->isSelected(name)) return;
+
+		long batch = 1;
+		while (this->measure(batch, fn) < this->options.minTime / 10 && batch < (1L << 30)) batch *= 2;
+
+		bool counters = this->options.counters && this->perfCounters.isAvailable();
+		long iterations = 0;
+		double elapsed = 0;
+		uint64_t totals[PerfCounters::COUNTERS_SIZE] = { 0 };
+		uint64_t allocationsBefore = allocations.load();
+		while (elapsed < this->options.minTime) {
+			if (counters) this->perfCounters.start();
+			elapsed += this->measure(batch, fn);
+			if (counters) {
+				this->perfCounters.stop();
+				for (int i = 0; i < PerfCounters::COUNTERS_SIZE; i++) {
+					totals[i] += this->perfCounters.get((PerfCounters::Counter)i);
+				}
+			}
+			iterations += batch;
+		}
+		double allocationsPerOp = (double)(allocations.load() - allocationsBefore) / iterations;
+
+		double nsPerOp = elapsed * 1e6 / iterations;
+		double opsPerSecond = 1e9 / nsPerOp;
+		printf("%-28s %-26s %12ld %14.1f %14.0f %14.3e %10.2f", name.c_str(), params.c_str(), iterations, nsPerOp, opsPerSecond,
+			itemsPerOp * opsPerSecond, allocationsPerOp);
+		if (counters) {
+			double cycles = (double)totals[PerfCounters::CYCLES] / iterations;
+			double instructions = (double)totals[PerfCounters::INSTRUCTIONS] / iterations;
+			printf(" %14.1f %14.1f %6.2f %12.2f %12.2f", cycles, instructions, cycles > 0 ? instructions / cycles : 0,
+				(double)totals[PerfCounters::CACHE_MISSES] / iterations, (double)totals[PerfCounters::BRANCH_MISSES] / iterations);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+private:
+	const BenchOptions &options;
+	PerfCounters perfCounters;
+
+	// Returns the elapsed milliseconds.
+	template <typename Fn>
+	double measure(long iterations, Fn &fn) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (long i = 0; i < iterations; i++) fn();
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	void printHeader() {
+		printf("%-28s %-26s %12s %14s %14s %14s %10s", "benchmark", "params", "iterations", "ns/op", "ops/s", "items/s", "allocs/op");
+		if (this->options.counters && this->perfCounters.isAvailable()) {
+			printf(" %14s %14s %6s %12s %12s", "cycles/op", "instr/op", "IPC", "llc-miss/op", "br-miss/op");
+		}
+		printf("\n");
+	}
+};
+
+vector<double> generateVector(mt19937 &random, int size, double density) {
+	uniform_real_distribution<double> cell(0, 1);
+	uniform_int_distribution<int> rating(1, 5);
+	vector<double> result(size, 0);
+	for (int i = 0; i < size; i++) {
+		if (cell(random) < density) result[i] = rating(random);
+	}
+
+	return result;
+}
+
+// Every row gets at least one rating, so no row has an undefined mean.
+vector<vector<double>> generateRatings(mt19937 &random, int rows, int cols, double density) {
+	vector<vector<double>> result;
+	uniform_int_distribution<int> col(0, cols - 1);
+	for (int i = 0; i < rows; i++) {
+		result.push_back(generateVector(random, cols, density));
+		if (Utils::normalizeVector(result[i]) == 0) result[i][col(random)] = 1;
+	}
+
+	return result;
+}
+
+class ZipfWords {
+public:
+	explicit ZipfWords(int vocabularySize) : cumulative(vocabularySize) {
+		double sum = 0;
+		for (int i = 0; i < vocabularySize; i++) {
+			sum += 1.0 / (i + 1);
+			this->cumulative[i] = sum;
+		}
+		for (int i = 0; i < vocabularySize; i++) this->cumulative[i] /= sum;
+	}
+
+	string getLine(mt19937 &random, int words) {
+		uniform_real_distribution<double> uniform(0, 1);
+		string line;
+		for (int i = 0; i < words; i++) {
+			int rank = lower_bound(this->cumulative.begin(), this->cumulative.end(), uniform(random)) - this->cumulative.begin();
+			if (i) line += " ";
+			line += "w" + to_string(rank);
+		}
+
+		return line;
+	}
+
+private:
+	vector<double> cumulative;
+};
+
+template <typename T>
+void runSimilarities(BenchRunner &runner, const string &name, const vector<vector<double>> &rows, const string &params) {
+	if (!runner.isSelected(name)) return;
+
+	Recommender r;
+	RatingMatrix<T> ratings = RatingMatrix<T>::fromRows(rows);
+	const T *row = ratings.getRow(0);
+	double normA = Utils::getCenteredNorm(row, ratings.getCols(), ratings.getScale());
+	runner.run(name, params, (double)ratings.getRows() * ratings.getCols(), [&]() {
+		ArenaScope scope;
+		sink = RecommenderBench::getSimilarities(r, ratings, 0, normA).size();
+	});
+}
+
+template <typename T>
+void runTopCF(BenchRunner &runner, const string &name, const vector<vector<double>> &rows, const string &params) {
+	if (!runner.isSelected(name)) return;
+
+	Recommender r;
+	RatingMatrix<T> ratings = RatingMatrix<T>::fromRows(rows);
+	runner.run(name, params, (double)ratings.getRows() * ratings.getCols(), [&]() {
+		sink = r.getTopCFRecommendations(ratings, 0, 10, -1).size();
+	});
+}
+
+template <typename S>
+void runBinary(BenchRunner &runner, const string &name, const vector<vector<double>> &rows, const string &params) {
+	if (!runner.isSelected(name)) return;
+
+	Recommender r;
+	BinaryMatrix interactions = BinaryMatrix::fromRows(rows);
+	runner.run(name, params, (double)interactions.getRows() * interactions.getCols(), [&]() {
+		sink = r.getBinaryRecommendations<S>(interactions, 0, 10, -1).size();
+	});
+}
+
+void runVectorKernels(BenchRunner &runner, const BenchOptions &options) {
+	mt19937 random(RANDOM_SEED);
+	for (int size : options.sizes) {
+		string params = "n=" + to_string(size);
+		vector<double> a = generateVector(random, size, 1);
+		vector<double> b = generateVector(random, size, 1);
+		RatingMatrix<float> floats = RatingMatrix<float>::fromRows({ a, b });
+		RatingMatrix<uint8_t> bytes = RatingMatrix<uint8_t>::fromRows({ a, b });
+		BinaryMatrix bits = BinaryMatrix::fromRows({ generateVector(random, size, 0.5), generateVector(random, size, 0.5) });
+
+		runner.run("calculateDotProduct", params, size, [&]() {
+			sink = Utils::calculateDotProduct(a, b);
+		});
+		runner.run("calculateDotProduct<double>", params, size, [&]() {
+			sink = Utils::calculateDotProduct(a.data(), b.data(), size);
+		});
+		runner.run("calculateDotProduct<float>", params, size, [&]() {
+			sink = Utils::calculateDotProduct(floats.getRow(0), floats.getRow(1), size);
+		});
+		runner.run("calculateDotProduct<uint8>", params, size, [&]() {
+			sink = Utils::calculateDotProduct(bytes.getRow(0), bytes.getRow(1), size);
+		});
+		runner.run("countCommon", params, size, [&]() {
+			sink = BinaryMatrix::countCommon(bits.getRow(0), bits.getRow(1), bits.getWords());
+		});
+		runner.run("normalizeVector", params, size, [&]() {
+			sink = Utils::normalizeVector(a);
+		});
+	}
+}
+
+void runMatrixKernels(BenchRunner &runner, const BenchOptions &options) {
+	mt19937 random(RANDOM_SEED);
+	for (int size : options.sizes) {
+		for (double density : options.densities) {
+			if (!runner.isSelected("getSimilarities") && !runner.isSelected("getTopCFRecommendations") &&
+				!runner.isSelected("getBinaryRecommendations")) continue;
+			char params[64];
+			snprintf(params, sizeof(params), "%dx%d d=%g", options.rows, size, density);
+			vector<vector<double>> rows = generateRatings(random, options.rows, size, density);
+			runSimilarities<double>(runner, "getSimilarities<double>", rows, params);
+			runSimilarities<float>(runner, "getSimilarities<float>", rows, params);
+			runSimilarities<uint8_t>(runner, "getSimilarities<uint8>", rows, params);
+			runTopCF<double>(runner, "getTopCFRecommendations", rows, params);
+			runBinary<CosineSimilarity>(runner, "getBinaryRecommendations<cosine>", rows, params);
+			runBinary<JaccardSimilarity>(runner, "getBinaryRecommendations<jaccard>", rows, params);
+		}
+	}
+}
+
+void runTextKernels(BenchRunner &runner, const BenchOptions &options) {
+	mt19937 random(RANDOM_SEED);
+	ZipfWords zipf(ZIPF_VOCABULARY_SIZE);
+	for (int documentsSize : options.documents) {
+		string params = "docs=" + to_string(documentsSize);
+		vector<string> documents;
+		for (int i = 0; i < documentsSize; i++) documents.push_back(zipf.getLine(random, WORDS_PER_DOCUMENT));
+		string query = zipf.getLine(random, WORDS_PER_QUERY);
+
+		Recommender r;
+		map<string, double> weights = r.tfidf(query, documents, false);
+		vector<double> similarities = r.recommend(weights);
+
+		runner.run("recommend", params, documentsSize, [&]() {
+			sink = r.recommend(weights).size();
+		});
+		runner.run("getSortedDocuments", params, documentsSize, [&]() {
+			sink = r.getSortedDocuments(similarities).size();
+		});
+		runner.run("splitLineToWords", params, documentsSize * WORDS_PER_DOCUMENT, [&]() {
+			size_t words = 0;
+			for (int i = 0; i < documentsSize; i++) words += RecommenderBench::splitLineToWords(r, documents[i], false).size();
+			sink = words;
+		});
+		runner.run("splitLineToWords+stopwords", params, documentsSize * WORDS_PER_DOCUMENT, [&]() {
+			size_t words = 0;
+			for (int i = 0; i < documentsSize; i++) words += RecommenderBench::splitLineToWords(r, documents[i], true).size();
+			sink = words;
+		});
+	}
+}
+
+// Posting lists of terms which are in a share of the documents as large as the
+// density, decoded whole and walked with skips.
+void runPostingKernels(BenchRunner &runner, const BenchOptions &options) {
+	mt19937 random(RANDOM_SEED);
+	for (int size : options.sizes) {
+		for (double density : options.densities) {
+			char params[64];
+			snprintf(params, sizeof(params), "n=%d d=%g", size, density);
+			vector<int32_t> documents;
+			vector<int32_t> counts;
+			geometric_distribution<int> gaps(density);
+			int32_t document = -1;
+			for (int i = 0; i < size; i++) {
+				document += 1 + gaps(random);
+				documents.push_back(document);
+				counts.push_back(1 + random() % 3);
+			}
+			vector<PostingBlock> blocks;
+			vector<uint32_t> words;
+			PostingList::encode(documents, counts, blocks, words);
+
+			runner.run("PostingCursor::next", params, size, [&]() {
+				int64_t sum = 0;
+				for (PostingCursor cursor(blocks.data(), blocks.data() + blocks.size(), words.data()); !cursor.isDone(); cursor.next()) {
+					sum += cursor.getCount();
+				}
+				sink = sum;
+			});
+			runner.run("PostingCursor::advance", params, size / 16, [&]() {
+				int64_t sum = 0;
+				PostingCursor cursor(blocks.data(), blocks.data() + blocks.size(), words.data());
+				for (int i = 0; i < size && !cursor.isDone(); i += 16) {
+					cursor.advance(documents[i]);
+					sum += cursor.getCount();
+				}
+				sink = sum;
+			});
+		}
+	}
+}
+
+template <typename T>
+vector<T> parseList(const char *value) {
+	vector<T> result;
+	string list(value);
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		if (end == string::npos) end = list.size();
+		if (end > start) result.push_back((T)atof(list.substr(start, end - start).c_str()));
+		start = end + 1;
+	}
+
+	return result;
+}
+
+bool parseOptions(int argc, char **argv, BenchOptions &options) {
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strncmp(arg, "--filter=", 9) == 0) options.filter = arg + 9;
+		else if (strncmp(arg, "--sizes=", 8) == 0) options.sizes = parseList<int>(arg + 8);
+		else if (strncmp(arg, "--densities=", 12) == 0) options.densities = parseList<double>(arg + 12);
+		else if (strncmp(arg, "--documents=", 12) == 0) options.documents = parseList<int>(arg + 12);
+		else if (strncmp(arg, "--rows=", 7) == 0) options.rows = atoi(arg + 7);
+		else if (strncmp(arg, "--min-time=", 11) == 0) options.minTime = atof(arg + 11);
+		else if (strcmp(arg, "--counters") == 0) options.counters = true;
+		else {
+			fprintf(stderr, "Unknown option %s\n", arg);
+			return false;
+		}
+	}
+
+	return options.rows > 1 && options.minTime > 0;
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if (!parseOptions(argc, argv, options)) return 1;
+
+	BenchRunner runner(options);
+	runVectorKernels(runner, options);
+	runMatrixKernels(runner, options);
+	runTextKernels(runner, options);
+	runPostingKernels(runner, options);
+
+	return 0;
+}
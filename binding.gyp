@@ -4,9 +4,29 @@
       "sources": [
         "recommender_node.cpp",
         "src/recommender.cpp",
-        "src/Utils.cpp"
+        "src/Utils.cpp",
+        "src/WorkerPool.cpp",
+        "src/Parallel.cpp",
+        "src/ResultCache.cpp",
+        "src/FileCache.cpp",
+        "src/Stats.cpp",
+        "src/Trace.cpp",
+        "src/Corpus.cpp",
+        "src/RatingModel.cpp",
+        "src/RatingDelta.cpp",
+        "src/Evaluation.cpp",
+        "src/Sharding.cpp",
+        "src/ModelImage.cpp",
+        "src/PostingList.cpp",
+        "src/Arena.cpp",
+        "src/MemoryBudget.cpp"
       ],
       "cflags": ["-Wall", "-std=c++11"],
+      "cflags!": ["-fno-exceptions"],
+      "cflags_cc!": ["-fno-exceptions"],
+      "msvs_settings": {
+        "VCCLCompilerTool": { "ExceptionHandling": 1 }
+      },
       "include_dirs": [
         "<!(node -e \"require('nan')\")"
       ],
@@ -15,6 +35,40 @@
             "xcode_settings": { 
                 "OTHER_CPLUSPLUSFLAGS" : ["-std=c++11","-stdlib=libc++"], 
                 "OTHER_LDFLAGS": ["-stdlib=libc++"], 
+                "GCC_ENABLE_CPP_EXCEPTIONS": "YES", 
+                "MACOSX_DEPLOYMENT_TARGET": "10.7" } 
+            }
+        ] 
+      ] 
+    }, {
+      "target_name": "recommender_bench",
+      "type": "executable",
+      "sources": [
+        "bench/microbench.cpp",
+        "src/recommender.cpp",
+        "src/Utils.cpp",
+        "src/WorkerPool.cpp",
+        "src/Parallel.cpp",
+        "src/ResultCache.cpp",
+        "src/FileCache.cpp",
+        "src/Stats.cpp",
+        "src/Trace.cpp",
+        "src/PostingList.cpp",
+        "src/Arena.cpp",
+        "src/MemoryBudget.cpp"
+      ],
+      "cflags": ["-Wall", "-std=c++11", "-O3"],
+      "cflags!": ["-fno-exceptions"],
+      "cflags_cc!": ["-fno-exceptions"],
+      "msvs_settings": {
+        "VCCLCompilerTool": { "ExceptionHandling": 1 }
+      },
+      "conditions": [ 
+        [ "OS=='mac'", { 
+            "xcode_settings": { 
+                "OTHER_CPLUSPLUSFLAGS" : ["-std=c++11","-stdlib=libc++", "-O3"], 
+                "OTHER_LDFLAGS": ["-stdlib=libc++"], 
+                "GCC_ENABLE_CPP_EXCEPTIONS": "YES", 
                 "MACOSX_DEPLOYMENT_TARGET": "10.7" } 
             }
         ] 
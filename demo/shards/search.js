@@ -0,0 +1,113 @@
+'use strict';
+
+// Searches a corpus which is split over child processes, standing in for
+// shards on other machines. Every child holds the documents of its shard with
+// their global ids. The coordinator merges the stats of all shards, so every
+// shard scores with the idf of the whole corpus, and then merges the best
+// documents of all shards. The results are checked against one corpus in this
+// process.
+//
+//   node shards/search.js [--processes=<n>] [--documents=<n>] [--limit=<n>]
+
+var path = require('path');
+var assert = require('assert');
+var childProcess = require('child_process');
+var recommender = require('recommender');
+var generators = require('../suite/generators');
+
+function parseArgs(argv) {
+    let args = { processes: 4, documents: 20000, limit: 10 };
+    argv.forEach((arg) => {
+        let match = /^--([a-z]+)=(\d+)$/.exec(arg);
+        if (match) args[match[1]] = parseInt(match[2], 10);
+    });
+
+    return args;
+}
+
+// The child side: answers the messages of the coordinator.
+function runShard() {
+    let corpus;
+    process.on('message', (message) => {
+        if (message.type === 'load') {
+            corpus = new recommender.Corpus(message.documents, { ids: message.ids });
+            process.send({ id: message.id, result: corpus.stats() });
+        } else if (message.type === 'search') {
+            corpus.search(message.query, { limit: message.limit, stats: message.stats }, (hits) => {
+                process.send({ id: message.id, result: hits });
+            });
+        } else if (message.type === 'exit') {
+            process.exit(0);
+        }
+    });
+}
+
+// Sends a message to every shard and resolves with all of their answers.
+function scatter(shards, createMessage) {
+    return Promise.all(shards.map((shard, i) => new Promise((resolve) => {
+        let message = createMessage(i);
+        message.id = ++shard.lastId;
+        shard.pending[message.id] = resolve;
+        shard.child.send(message);
+    })));
+}
+
+function mergeStats(statsList) {
+    let merged = { documents: 0, words: 0, documentFrequencies: {} };
+    statsList.forEach((stats) => {
+        merged.documents += stats.documents;
+        merged.words += stats.words;
+        Object.keys(stats.documentFrequencies).forEach((term) => {
+            merged.documentFrequencies[term] = (merged.documentFrequencies[term] || 0) + stats.documentFrequencies[term];
+        });
+    });
+
+    return merged;
+}
+
+function runCoordinator(args) {
+    let corpus = generators.generateCorpus({
+        documents: args.documents, vocabulary: 5000, minWords: 5, maxWords: 40, queries: 20, queryWords: 4
+    });
+    let shards = [];
+    for (let i = 0; i < args.processes; i++) {
+        let child = childProcess.fork(path.join(__dirname, 'search.js'), ['--shard']);
+        let shard = { child: child, lastId: 0, pending: {} };
+        child.on('message', (message) => {
+            let resolve = shard.pending[message.id];
+            delete shard.pending[message.id];
+            resolve(message.result);
+        });
+        shards.push(shard);
+    }
+
+    // Hash partitioning by document id.
+    let parts = shards.map(() => ({ documents: [], ids: [] }));
+    corpus.documents.forEach((document, id) => {
+        parts[id % shards.length].documents.push(document);
+        parts[id % shards.length].ids.push(id);
+    });
+
+    let local = new recommender.Corpus(corpus.documents);
+    let stats;
+    let started = Date.now();
+    return scatter(shards, (i) => ({ type: 'load', documents: parts[i].documents, ids: parts[i].ids }))
+        .then((statsList) => {
+            stats = mergeStats(statsList);
+            console.log('loaded ' + stats.documents + ' documents into ' + shards.length + ' processes in ' + (Date.now() - started) + 'ms');
+            started = Date.now();
+            return corpus.queries.reduce((previous, query) => previous.then(() => {
+                return scatter(shards, () => ({ type: 'search', query: query, limit: args.limit, stats: stats })).then((hitsList) => {
+                    let hits = recommender.mergeSearchResults(hitsList, args.limit);
+                    assert.deepEqual(hits, local.search(query, { limit: args.limit }));
+                });
+            }), Promise.resolve());
+        })
+        .then(() => {
+            console.log(corpus.queries.length + ' queries in ' + (Date.now() - started) + 'ms, same results as one corpus');
+            shards.forEach((shard) => shard.child.send({ type: 'exit' }));
+        });
+}
+
+if (process.argv.indexOf('--shard') !== -1) runShard();
+else runCoordinator(parseArgs(process.argv.slice(2)));
@@ -0,0 +1,136 @@
+'use strict';
+
+// Deterministic synthetic data for the benchmark suite. The same seed always
+// gives the same matrices and corpora, so runs on different machines or
+// commits measure the same work.
+
+function createRandom(seed) {
+    // mulberry32
+    let state = seed >>> 0;
+    return function () {
+        state = (state + 0x6D2B79F5) >>> 0;
+        let t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+}
+
+// Samples ranks 0..size-1 with probability proportional to 1 / (rank + 1)^exponent.
+function createZipf(size, exponent, random) {
+    let cumulative = new Float64Array(size);
+    let sum = 0;
+    for (let i = 0; i < size; i++) {
+        sum += 1 / Math.pow(i + 1, exponent);
+        cumulative[i] = sum;
+    }
+    for (let i = 0; i < size; i++) cumulative[i] /= sum;
+
+    return function () {
+        let value = random();
+        let low = 0;
+        let high = size - 1;
+        while (low < high) {
+            let mid = (low + high) >>> 1;
+            if (cumulative[mid] < value) low = mid + 1;
+            else high = mid;
+        }
+        return low;
+    };
+}
+
+// Users x items matrix in which both the number of ratings per user and the
+// popularity of items follow a power law, as in real rating data. density is
+// the share of rated cells on average. Every user rates at least one item.
+function generateRatings(options) {
+    let users = options.users;
+    let items = options.items;
+    let density = options.density;
+    let exponent = options.exponent || 1;
+    let random = createRandom(options.seed || 1);
+    let pickItem = createZipf(items, exponent, random);
+    // Item ranks are shuffled, so the popular items are not all in the first columns.
+    let itemIds = shuffle(Array.from({ length: items }, (value, i) => i), random);
+
+    let activity = [];
+    let activitySum = 0;
+    for (let i = 0; i < users; i++) {
+        activity.push(1 / Math.pow(i + 1, exponent / 2));
+        activitySum += activity[i];
+    }
+    shuffle(activity, random);
+
+    let ratings = [];
+    for (let i = 0; i < users; i++) {
+        let row = new Array(items).fill(0);
+        let ratingsCount = Math.min(items, Math.max(1, Math.round(density * items * users * activity[i] / activitySum)));
+        let rated = 0;
+        let attempts = 0;
+        while (rated < ratingsCount && attempts < ratingsCount * 10) {
+            let item = itemIds[pickItem()];
+            attempts++;
+            if (row[item] !== 0) continue;
+            row[item] = 1 + Math.floor(random() * 5);
+            rated++;
+        }
+        ratings.push(row);
+    }
+
+    return ratings;
+}
+
+// Documents made of words drawn from a Zipfian vocabulary, as in natural text.
+function generateCorpus(options) {
+    let random = createRandom(options.seed || 1);
+    let vocabulary = generateVocabulary(options.vocabulary, random);
+    let pickWord = createZipf(vocabulary.length, options.exponent || 1, random);
+    let documents = [];
+    for (let i = 0; i < options.documents; i++) {
+        let length = options.minWords + Math.floor(random() * (options.maxWords - options.minWords + 1));
+        documents.push(generateLine(length, vocabulary, pickWord));
+    }
+
+    let queries = [];
+    for (let i = 0; i < options.queries; i++) {
+        queries.push(generateLine(options.queryWords, vocabulary, pickWord));
+    }
+
+    return { documents: documents, queries: queries };
+}
+
+function generateVocabulary(size, random) {
+    const letters = 'abcdefghijklmnopqrstuvwxyz';
+    let words = new Set();
+    while (words.size < size) {
+        let length = 3 + Math.floor(random() * 8);
+        let word = '';
+        for (let i = 0; i < length; i++) word += letters[Math.floor(random() * letters.length)];
+        words.add(word);
+    }
+
+    return Array.from(words);
+}
+
+function generateLine(length, vocabulary, pickWord) {
+    let words = [];
+    for (let i = 0; i < length; i++) words.push(vocabulary[pickWord()]);
+    return words.join(' ');
+}
+
+function shuffle(array, random) {
+    for (let i = array.length - 1; i > 0; i--) {
+        let j = Math.floor(random() * (i + 1));
+        let tmp = array[i];
+        array[i] = array[j];
+        array[j] = tmp;
+    }
+
+    return array;
+}
+
+module.exports = {
+    createRandom: createRandom,
+    createZipf: createZipf,
+    generateRatings: generateRatings,
+    generateCorpus: generateCorpus
+};
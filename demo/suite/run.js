@@ -0,0 +1,196 @@
+'use strict';
+
+// End to end benchmark suite of the public API at production like sizes.
+//
+//   node suite/run.js [--profile=small|medium|large] [--filter=<name>]
+//                     [--concurrency=<n>] [--out=<file>] [--baseline=<file>]
+//                     [--save-baseline] [--threshold=<fraction>]
+//
+// Every scenario runs in a child process of its own, so its peak RSS is not
+// polluted by the others. The results are printed as JSON (or written to
+// --out) and compared with the baseline of the profile, which defaults to
+// suite/baselines/<profile>.json. The exit code is 1 if a metric regressed
+// by more than its threshold.
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var childProcess = require('child_process');
+
+// Allowed relative regression per metric. lowerIsBetter is false for throughput.
+const METRICS = {
+    coldMs: { threshold: 0.25, lowerIsBetter: true },
+    p50Ms: { threshold: 0.15, lowerIsBetter: true },
+    p99Ms: { threshold: 0.25, lowerIsBetter: true },
+    throughput: { threshold: 0.15, lowerIsBetter: false },
+    peakRssMb: { threshold: 0.15, lowerIsBetter: true }
+};
+
+function parseArgs(argv) {
+    let args = { profile: 'medium', concurrency: 16 };
+    argv.forEach((arg) => {
+        let match = /^--([^=]+)(?:=(.*))?$/.exec(arg);
+        if (!match) return;
+        let key = match[1].replace(/-([a-z])/g, (m, letter) => letter.toUpperCase());
+        args[key] = match[2] === undefined ? true : match[2];
+    });
+    args.concurrency = parseInt(args.concurrency, 10);
+    if (args.threshold !== undefined) args.threshold = parseFloat(args.threshold);
+
+    return args;
+}
+
+function percentile(sorted, p) {
+    let index = Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1);
+    return sorted[Math.max(0, index)];
+}
+
+function elapsedMs(start) {
+    return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+function getPeakRssMb() {
+    // maxRSS is in kilobytes.
+    if (process.resourceUsage) return process.resourceUsage().maxRSS / 1024;
+    return process.memoryUsage().rss / (1024 * 1024);
+}
+
+function runThroughput(scenario, state, calls, concurrency, callback) {
+    let started = 0;
+    let completed = 0;
+    let start = process.hrtime.bigint();
+    function next() {
+        if (started >= calls) return;
+        let i = started++;
+        scenario.async(state, i, () => {
+            completed++;
+            if (completed === calls) return callback(calls / (elapsedMs(start) / 1000));
+            next();
+        });
+    }
+    for (let i = 0; i < Math.min(concurrency, calls); i++) next();
+}
+
+function runScenario(name, args) {
+    var recommender = require('recommender');
+    var scenarios = require('./scenarios');
+    let scenario = scenarios.SCENARIOS[name];
+    let profile = scenarios.PROFILES[args.profile];
+    recommender.configure({ cacheSize: 0 });
+
+    let state = scenario.setup(profile);
+    let setupRssMb = process.memoryUsage().rss / (1024 * 1024);
+
+    let start = process.hrtime.bigint();
+    scenario.sync(state, 0);
+    let coldMs = elapsedMs(start);
+
+    for (let i = 0; i < profile.warmup; i++) scenario.sync(state, i + 1);
+
+    let latencies = [];
+    for (let i = 0; i < profile.iterations; i++) {
+        let callStart = process.hrtime.bigint();
+        scenario.sync(state, i);
+        latencies.push(elapsedMs(callStart));
+    }
+    latencies.sort((a, b) => a - b);
+
+    runThroughput(scenario, state, profile.asyncCalls, args.concurrency, (throughput) => {
+        if (state.cleanup) state.cleanup();
+        process.send({
+            coldMs: coldMs,
+            p50Ms: percentile(latencies, 0.5),
+            p99Ms: percentile(latencies, 0.99),
+            throughput: throughput,
+            setupRssMb: setupRssMb,
+            peakRssMb: getPeakRssMb()
+        }, () => process.exit(0));
+    });
+}
+
+function runChild(name, argv) {
+    return new Promise((resolve, reject) => {
+        let result = null;
+        let child = childProcess.fork(__filename, argv.concat(['--child=' + name]), { cwd: path.join(__dirname, '..') });
+        child.on('message', (message) => result = message);
+        child.on('exit', (code) => {
+            if (code !== 0 || !result) return reject(new Error(name + ' exited with code ' + code));
+            resolve(result);
+        });
+    });
+}
+
+function compare(results, baseline, threshold) {
+    let regressions = [];
+    Object.keys(results).forEach((name) => {
+        if (!baseline.results[name]) return;
+        Object.keys(METRICS).forEach((metric) => {
+            let current = results[name][metric];
+            let previous = baseline.results[name][metric];
+            if (!previous) return;
+            let change = (current - previous) / previous;
+            let allowed = threshold !== undefined ? threshold : METRICS[metric].threshold;
+            let regressed = METRICS[metric].lowerIsBetter ? change > allowed : -change > allowed;
+            if (regressed) regressions.push({ scenario: name, metric: metric, baseline: previous, current: current, change: change });
+        });
+    });
+
+    return regressions;
+}
+
+function main() {
+    let args = parseArgs(process.argv.slice(2));
+    if (args.child) return runScenario(args.child, args);
+
+    var scenarios = require('./scenarios');
+    if (!scenarios.PROFILES[args.profile]) {
+        console.error('Unknown profile ' + args.profile);
+        process.exit(2);
+    }
+
+    let names = Object.keys(scenarios.SCENARIOS).filter((name) => !args.filter || name.indexOf(args.filter) !== -1);
+    let childArgv = ['--profile=' + args.profile, '--concurrency=' + args.concurrency];
+    let report = {
+        profile: args.profile,
+        concurrency: args.concurrency,
+        node: process.version,
+        platform: process.platform + '-' + process.arch,
+        cpus: os.cpus().length,
+        date: new Date().toISOString(),
+        results: {}
+    };
+
+    names.reduce((previous, name) => previous.then(() => {
+        console.error('Running ' + name + ' (' + args.profile + ')');
+        return runChild(name, childArgv).then((result) => report.results[name] = result);
+    }), Promise.resolve()).then(() => {
+        let json = JSON.stringify(report, null, 2);
+        if (args.out) fs.writeFileSync(args.out, json);
+        else console.log(json);
+
+        let baselinePath = typeof args.baseline === 'string' ? args.baseline : path.join(__dirname, 'baselines', args.profile + '.json');
+        if (args.saveBaseline) {
+            fs.mkdirSync(path.dirname(baselinePath), { recursive: true });
+            fs.writeFileSync(baselinePath, json);
+            console.error('Saved baseline to ' + baselinePath);
+            return;
+        }
+        if (!fs.existsSync(baselinePath)) {
+            console.error('No baseline at ' + baselinePath + ', run with --save-baseline to create one.');
+            return;
+        }
+
+        let regressions = compare(report.results, JSON.parse(fs.readFileSync(baselinePath)), args.threshold);
+        regressions.forEach((r) => {
+            console.error('REGRESSION ' + r.scenario + ' ' + r.metric + ': ' + r.baseline.toFixed(3) + ' -> ' +
+                r.current.toFixed(3) + ' (' + (r.change * 100).toFixed(1) + '%)');
+        });
+        if (regressions.length) process.exitCode = 1;
+        else console.error('No regressions against ' + baselinePath);
+    }).catch((err) => {
+        console.error(err.message);
+        process.exitCode = 2;
+    });
+}
+
+main();
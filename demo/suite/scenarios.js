@@ -0,0 +1,101 @@
+'use strict';
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var recommender = require('recommender');
+var generators = require('./generators');
+
+// Sizes of the generated data and the number of measured calls per profile.
+const PROFILES = {
+    small: {
+        ratings: { users: 200, items: 100, density: 0.05, seed: 1 },
+        corpus: { documents: 200, minWords: 10, maxWords: 40, queryWords: 5, queries: 50, vocabulary: 2000, seed: 2 },
+        warmup: 10,
+        iterations: 200,
+        asyncCalls: 400
+    },
+    medium: {
+        ratings: { users: 2000, items: 1000, density: 0.02, seed: 1 },
+        corpus: { documents: 2000, minWords: 20, maxWords: 60, queryWords: 5, queries: 50, vocabulary: 20000, seed: 2 },
+        warmup: 5,
+        iterations: 100,
+        asyncCalls: 200
+    },
+    large: {
+        ratings: { users: 10000, items: 2000, density: 0.01, seed: 1 },
+        corpus: { documents: 10000, minWords: 20, maxWords: 80, queryWords: 5, queries: 20, vocabulary: 50000, seed: 2 },
+        warmup: 2,
+        iterations: 30,
+        asyncCalls: 60
+    }
+};
+
+function ratingsSetup(profile) {
+    let ratings = generators.generateRatings(profile.ratings);
+    return { ratings: ratings, users: ratings.length, items: ratings[0].length };
+}
+
+function corpusSetup(profile) {
+    return generators.generateCorpus(profile.corpus);
+}
+
+// The corpus and the queries are written to a temporary directory, since the
+// file variant of tfidf reads both from disk on every call.
+function corpusFilesSetup(profile) {
+    let corpus = generators.generateCorpus(profile.corpus);
+    let dir = fs.mkdtempSync(path.join(os.tmpdir(), 'recommender-suite-'));
+    let documentsPath = path.join(dir, 'documents.txt');
+    fs.writeFileSync(documentsPath, corpus.documents.join('\n'));
+    let queryPaths = corpus.queries.map((query, i) => {
+        let queryPath = path.join(dir, 'query' + i + '.txt');
+        fs.writeFileSync(queryPath, query);
+        return queryPath;
+    });
+
+    return {
+        documentsPath: documentsPath,
+        queryPaths: queryPaths,
+        cleanup: () => fs.rmSync ? fs.rmSync(dir, { recursive: true, force: true }) : null
+    };
+}
+
+// Every scenario spreads its calls over different rows or queries, and the
+// async calls opt out of coalescing, so each call does the full work.
+const SCENARIOS = {
+    'tfidf-arrays': {
+        setup: corpusSetup,
+        sync: (state, i) => recommender.tfidf(state.queries[i % state.queries.length], state.documents),
+        async: (state, i, done) => recommender.tfidf(state.queries[i % state.queries.length], state.documents, { coalesce: false }, done)
+    },
+    'tfidf-files': {
+        setup: corpusFilesSetup,
+        sync: (state, i) => recommender.tfidf(state.queryPaths[i % state.queryPaths.length], state.documentsPath),
+        async: (state, i, done) => recommender.tfidf(state.queryPaths[i % state.queryPaths.length], state.documentsPath, { coalesce: false }, done)
+    },
+    'getRatingPrediction': {
+        setup: ratingsSetup,
+        sync: (state, i) => recommender.getRatingPrediction(state.ratings, i % state.users, (i * 7919) % state.items),
+        async: (state, i, done) => recommender.getRatingPrediction(state.ratings, i % state.users, (i * 7919) % state.items, { coalesce: false }, done)
+    },
+    'getGlobalBaselineRatingPrediction': {
+        setup: ratingsSetup,
+        sync: (state, i) => recommender.getGlobalBaselineRatingPrediction(state.ratings, i % state.users, (i * 7919) % state.items),
+        async: (state, i, done) => recommender.getGlobalBaselineRatingPrediction(state.ratings, i % state.users, (i * 7919) % state.items, { coalesce: false }, done)
+    },
+    'getTopCFRecommendations': {
+        setup: ratingsSetup,
+        sync: (state, i) => recommender.getTopCFRecommendations(state.ratings, i % state.users, { limit: 10 }),
+        async: (state, i, done) => recommender.getTopCFRecommendations(state.ratings, i % state.users, { limit: 10, coalesce: false }, done)
+    },
+    'getGlobalBaselineRecommendations': {
+        setup: ratingsSetup,
+        sync: (state, i) => recommender.getGlobalBaselineRecommendations(state.ratings, i % state.users, { limit: 10 }),
+        async: (state, i, done) => recommender.getGlobalBaselineRecommendations(state.ratings, i % state.users, { limit: 10, coalesce: false }, done)
+    }
+};
+
+module.exports = {
+    PROFILES: PROFILES,
+    SCENARIOS: SCENARIOS
+};
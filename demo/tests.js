@@ -153,6 +153,25 @@ describe('Recommender', () => {
                     });
                 });
             });
+
+            describe('when the same documents file is passed again', () => {
+                it('reads the file once and again when it changes', () => {
+                    let fs = require('fs');
+                    let path = require('os').tmpdir() + '/recommender-documents-' + process.pid + '.txt';
+                    fs.writeFileSync(path, this.documents.join('\n'));
+                    r.resetStats();
+                    expect(r.tfidf(this.queryFilePath, path)).to.eql(this.expectedSortedDocs);
+                    expect(r.tfidf(this.queryFilePath, path)).to.eql(this.expectedSortedDocs);
+                    let counters = r.stats().counters;
+                    expect(counters.fileCacheMisses).to.equal(1);
+                    expect(counters.fileCacheHits).to.equal(1);
+
+                    fs.writeFileSync(path, 'something very different\nget the current date and time in javascript now');
+                    expect(r.tfidf(this.queryFilePath, path)[0]).to.equal('get the current date and time in javascript now');
+                    expect(r.stats().counters.fileCacheMisses).to.equal(2);
+                    fs.unlinkSync(path);
+                });
+            });
         });
 
 
@@ -246,6 +265,39 @@ describe('Recommender', () => {
                 });
             });
         });
+
+        context('when options object is passed', () => {
+            context('sync', () => {
+                it('returns the correct sorted docs', () => {
+                    let sortedDocs = r.tfidf(this.query, this.documents, { filterStopWords: true, timeout: 10000 });
+                    expect(sortedDocs).to.eql(this.expectedSortedDocs);
+                });
+            });
+
+            context('async', () => {
+                it('does not pass a status when the work completes', (done) => {
+                    r.tfidf(this.query, this.documents, { timeout: 10000 }, (sortedDocs, status) => {
+                        expect(sortedDocs).to.eql(this.expectedSortedDocs);
+                        expect(status).to.be.undefined;
+                        done();
+                    });
+                });
+
+                it('passes a timeout status when the deadline has passed', (done) => {
+                    r.tfidf(this.query, this.documents, { timeout: 0 }, (sortedDocs, status) => {
+                        expect(status).to.eql({ cancelled: true, reason: 'timeout' });
+                        done();
+                    });
+                });
+
+                it('passes an abort status when the signal is already aborted', (done) => {
+                    r.tfidf(this.query, this.documents, { signal: { aborted: true } }, (sortedDocs, status) => {
+                        expect(status).to.eql({ cancelled: true, reason: 'abort' });
+                        done();
+                    });
+                });
+            });
+        });
     });
 
 
@@ -282,6 +334,28 @@ describe('Recommender', () => {
                 });
             });
 
+            describe('when storage is passed', () => {
+                ['float32', 'uint8'].forEach((storage) => {
+                    context(storage, () => {
+                        context('sync', () => {
+                            it('returns the same result as double', () => {
+                                let ratingPrediction = r.getRatingPrediction(this.ratings, this.row, this.col, { storage: storage });
+                                expect(ratingPrediction).to.eql(this.expectedRatingPrediction);
+                            });
+                        });
+
+                        context('async', () => {
+                            it('returns the same result as double', (done) => {
+                                r.getRatingPrediction(this.ratings, this.row, this.col, { storage: storage }, (ratingPrediction) => {
+                                    expect(ratingPrediction).to.eql(this.expectedRatingPrediction);
+                                    done();
+                                });
+                            });
+                        });
+                    });
+                });
+            });
+
             describe('sparse matrix', () => {
                 beforeEach(() => {
                     this.sparseMatrix = [
@@ -534,6 +608,28 @@ describe('Recommender', () => {
                 });
             });
             
+            describe('when storage is passed', () => {
+                ['float32', 'uint8'].forEach((storage) => {
+                    context(storage, () => {
+                        context('sync', () => {
+                            it('returns the same result as double', () => {
+                                let ratingPrediction = r.getGlobalBaselineRatingPrediction(this.ratings, this.row, this.col, { storage: storage });
+                                expect(ratingPrediction).to.eql(this.expectedRatingPrediction);
+                            });
+                        });
+
+                        context('async', () => {
+                            it('returns the same result as double', (done) => {
+                                r.getGlobalBaselineRatingPrediction(this.ratings, this.row, this.col, { storage: storage }, (ratingPrediction) => {
+                                    expect(ratingPrediction).to.eql(this.expectedRatingPrediction);
+                                    done();
+                                });
+                            });
+                        });
+                    });
+                });
+            });
+
             describe('sparse matrix', () => {
                 beforeEach(() => {
                     this.sparseMatrix = [
@@ -749,6 +845,298 @@ describe('Recommender', () => {
     });
 
 
+    context('configure', () => {
+        afterEach(() => {
+            r.configure({ threads: 4 });
+        });
+
+        describe('when threads is valid', () => {
+            it('runs async work on the resized pool', (done) => {
+                r.configure({ threads: 1 });
+                r.tfidf('get current date time javascript', ['get the current date', 'what is the time now'], { priority: 'batch' }, (sortedDocs) => {
+                    expect(sortedDocs).to.eql(['get the current date', 'what is the time now']);
+                    done();
+                });
+            });
+        });
+
+        describe('when cacheSize is set', () => {
+            afterEach(() => {
+                r.configure({ cacheSize: 0 });
+            });
+
+            it('returns the same results from the cache', () => {
+                let ratings = generateMatrix(100, 100);
+                r.configure({ cacheSize: 1024 * 1024 });
+                let first = r.getTopCFRecommendations(ratings, 0, { limit: 10 });
+                let second = r.getTopCFRecommendations(ratings, 0, { limit: 10 });
+                expect(second).to.eql(first);
+            });
+
+            it('does not return results of a changed matrix', () => {
+                let ratings = [
+                    [4, 0, 0, 1, 1, 0, 0],
+                    [5, 5, 4, 0, 0, 0, 0],
+                    [0, 0, 0, 2, 4, 5, 0],
+                    [3, 0, 0, 0, 0, 0, 3]
+                ];
+                r.configure({ cacheSize: 1024 * 1024 });
+                let first = r.getTopCFRecommendations(ratings, 0);
+                ratings[1][1] = 1;
+                let second = r.getTopCFRecommendations(ratings, 0);
+                expect(second).to.not.eql(first);
+            });
+        });
+
+        describe('when cacheSize is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ cacheSize: -1 })).to.throw('Invalid cacheSize option passed');
+            });
+        });
+
+        describe('when fileCacheSize is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ fileCacheSize: -1 })).to.throw('Invalid fileCacheSize option passed');
+            });
+        });
+
+        describe('when memoryBudget is set', () => {
+            afterEach(() => {
+                r.configure({ cacheSize: 0, memoryBudget: 0 });
+            });
+
+            it('counts cached results and evicts them to make room for models', () => {
+                let ratings = generateMatrix(100, 100);
+                let first = new r.RatingModel([[1, 2], [3, 4]]);
+                r.configure({ cacheSize: 1024 * 1024 });
+                for (let i = 0; i < 20; i++) r.getTopCFRecommendations(ratings, i);
+                let usage = r.memoryUsage();
+                expect(usage.components.resultCache).to.be.above(0);
+                expect(usage.heapBytes).to.equal(usage.components.models + usage.components.resultCache + usage.components.fileCache);
+
+                r.configure({ memoryBudget: usage.heapBytes + first.memoryUsage().heapBytes - 1 });
+                let second = new r.RatingModel([[1, 2], [3, 4]]);
+                expect(second.memoryUsage().heapBytes).to.equal(first.memoryUsage().heapBytes);
+                expect(r.memoryUsage().components.resultCache).to.be.below(usage.components.resultCache);
+            });
+        });
+
+        describe('when memoryBudget is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ memoryBudget: -1 })).to.throw('Invalid memoryBudget option passed');
+            });
+        });
+
+        describe('when trace is passed', () => {
+            it('writes the spans of calls to the file', () => {
+                let path = require('os').tmpdir() + '/recommender-trace-' + process.pid + '.json';
+                r.configure({ trace: path });
+                r.getTopCFRecommendations(generateMatrix(10, 10), 0);
+                r.configure({ trace: false });
+                let events = JSON.parse(require('fs').readFileSync(path, 'utf8'));
+                require('fs').unlinkSync(path);
+                let names = events.map((event) => event.name);
+                expect(names).to.include.members(['getTopCFRecommendations', 'getNeighbourhood', 'getSimilarities', 'similarity']);
+                expect(events[0]).to.have.all.keys('name', 'cat', 'ph', 'ts', 'dur', 'pid', 'tid');
+            });
+        });
+
+        describe('when trace is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ trace: true })).to.throw('Invalid trace option passed');
+            });
+        });
+
+        describe('when threads is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ threads: 0 })).to.throw('Invalid threads option passed');
+            });
+        });
+
+        describe('when options are not passed', () => {
+            it('throws error', () => {
+                expect(() => r.configure()).to.throw('Invalid options passed');
+            });
+        });
+    });
+
+    context('getAllTopCFRecommendations', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+        });
+
+        context('when correct params are sent', () => {
+            describe('when options are not sent', () => {
+                it('streams the same results as getTopCFRecommendations for all rows', (done) => {
+                    let rows = {};
+                    r.getAllTopCFRecommendations(this.ratings, (chunk) => {
+                        chunk.forEach((row) => rows[row.rowIndex] = row.recommendations);
+                    }, (processed) => {
+                        expect(processed).to.eql(4);
+                        for (let i = 0; i < 4; i++) {
+                            expect(rows[i]).to.eql(r.getTopCFRecommendations(this.ratings, i));
+                        }
+                        done();
+                    });
+                });
+            });
+
+            describe('when rows, limit and chunkSize are sent', () => {
+                it('streams chunks of the given rows', (done) => {
+                    let chunks = [];
+                    r.getAllTopCFRecommendations(this.ratings, { rows: [2, 0, 3], limit: 2, chunkSize: 2 }, (chunk) => {
+                        chunks.push(chunk);
+                    }, (processed) => {
+                        expect(processed).to.eql(3);
+                        expect(chunks.map((chunk) => chunk.map((row) => row.rowIndex))).to.eql([[2, 0], [3]]);
+                        expect(chunks[0][1].recommendations).to.eql(r.getTopCFRecommendations(this.ratings, 0, { limit: 2 }));
+                        done();
+                    });
+                });
+            });
+
+            describe('when storage is sent', () => {
+                it('returns the same result as double', (done) => {
+                    let rows = {};
+                    r.getAllTopCFRecommendations(this.ratings, { storage: 'uint8' }, (chunk) => {
+                        chunk.forEach((row) => rows[row.rowIndex] = row.recommendations);
+                    }, () => {
+                        expect(rows[0]).to.eql(r.getTopCFRecommendations(this.ratings, 0));
+                        done();
+                    });
+                });
+            });
+
+            describe('when minCoRatings is sent', () => {
+                it('returns the same result as getTopCFRecommendations', (done) => {
+                    let rows = {};
+                    r.getAllTopCFRecommendations(this.ratings, { minCoRatings: 2 }, (chunk) => {
+                        chunk.forEach((row) => rows[row.rowIndex] = row.recommendations);
+                    }, () => {
+                        expect(rows[0]).to.eql(r.getTopCFRecommendations(this.ratings, 0, { minCoRatings: 2 }));
+                        done();
+                    });
+                });
+            });
+
+            describe('when timeout is passed', () => {
+                it('passes a timeout status when the deadline has passed', (done) => {
+                    r.getAllTopCFRecommendations(generateMatrix(1000, 1000), { timeout: 0 }, () => {}, (processed, status) => {
+                        expect(processed).to.eql(0);
+                        expect(status).to.eql({ cancelled: true, reason: 'timeout' });
+                        done();
+                    });
+                }).timeout(LONG_TIMEOUT);
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            describe('when ratings are invalid', () => {
+                it('calls back with 0 rows', (done) => {
+                    r.getAllTopCFRecommendations(null, () => {}, (processed) => {
+                        expect(processed).to.eql(0);
+                        done();
+                    });
+                });
+            });
+
+            describe('when rows are invalid', () => {
+                it('throws error', () => {
+                    expect(() => r.getAllTopCFRecommendations(this.ratings, { rows: [4] }, () => {}, () => {})).to.throw('Invalid rows option passed');
+                });
+            });
+
+            describe('when callbacks are not passed', () => {
+                it('throws error', () => {
+                    expect(() => r.getAllTopCFRecommendations(this.ratings, {})).to.throw('Invalid callbacks passed');
+                });
+            });
+        });
+    });
+
+    context('stats', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+            r.resetStats();
+        });
+
+        afterEach(() => {
+            r.configure({ stats: false });
+        });
+
+        describe('when stats are enabled', () => {
+            context('sync', () => {
+                it('records the phases of a call', () => {
+                    r.configure({ stats: true });
+                    r.getTopCFRecommendations(this.ratings, 0);
+                    let stats = r.stats();
+                    expect(stats.enabled).to.eql(true);
+                    expect(stats.phases.marshal.calls).to.be.above(0);
+                    expect(stats.phases.similarity.calls).to.eql(1);
+                    expect(stats.phases.convert.calls).to.eql(1);
+                    expect(stats.phases.similarity.histogram.reduce((a, b) => a + b)).to.eql(1);
+                    expect(stats.counters.bytesCopied).to.be.above(0);
+                });
+
+                it('reuses the scratch memory of the thread', () => {
+                    r.configure({ stats: true });
+                    r.getTopCFRecommendations(this.ratings, 0);
+                    let arenaChunks = r.stats().counters.arenaChunks;
+                    r.getTopCFRecommendations(this.ratings, 1);
+                    expect(r.stats().counters.arenaChunks).to.eql(arenaChunks);
+                });
+            });
+
+            context('async', () => {
+                it('records the queue wait', (done) => {
+                    r.configure({ stats: true });
+                    r.tfidf('get current date time javascript', ['get the current date', 'what is the time now'], () => {
+                        let stats = r.stats();
+                        expect(stats.phases.queueWait.calls).to.eql(1);
+                        expect(stats.phases.execute.calls).to.eql(1);
+                        expect(stats.phases.tokenize.calls).to.eql(1);
+                        done();
+                    });
+                });
+            });
+        });
+
+        describe('when stats are disabled', () => {
+            it('does not record anything', () => {
+                r.getTopCFRecommendations(this.ratings, 0);
+                let stats = r.stats();
+                expect(stats.enabled).to.eql(false);
+                expect(stats.phases.similarity.calls).to.eql(0);
+                expect(stats.counters.bytesCopied).to.eql(0);
+            });
+        });
+
+        describe('when resetStats is called', () => {
+            it('clears the recorded stats', () => {
+                r.configure({ stats: true });
+                r.getTopCFRecommendations(this.ratings, 0);
+                r.resetStats();
+                expect(r.stats().phases.similarity.calls).to.eql(0);
+            });
+        });
+
+        describe('when stats option is invalid', () => {
+            it('throws error', () => {
+                expect(() => r.configure({ stats: 1 })).to.throw('Invalid stats option passed');
+            });
+        });
+    });
+
     context('getTopCFRecommendations', () => {
         beforeEach(() => {
             this.ratings = [
@@ -923,6 +1311,138 @@ describe('Recommender', () => {
                 });
             });
 
+            describe('when timeout is passed', () => {
+                context('sync', () => {
+                    it('returns correct result', () => {
+                        let recommendations = r.getTopCFRecommendations(this.ratings, this.row, { limit: 3, timeout: 10000 });
+                        expect(recommendations).to.eql(this.expectedTopRecommendations.splice(0, 3));
+                    });
+
+                    it('ignores a deadline which has passed and returns the whole result', () => {
+                        let ratings = generateMatrix(100, 100);
+                        expect(r.getTopCFRecommendations(ratings, 0, { timeout: 0 })).to.eql(r.getTopCFRecommendations(ratings, 0));
+                    });
+                });
+
+                context('async', () => {
+                    it('passes a timeout status when the deadline has passed', (done) => {
+                        r.getTopCFRecommendations(generateMatrix(1000, 1000), this.row, { timeout: 0 }, (recommendations, status) => {
+                            expect(recommendations).to.be.an('array');
+                            expect(status).to.eql({ cancelled: true, reason: 'timeout' });
+                            done();
+                        });
+                    }).timeout(LONG_TIMEOUT);
+                });
+            });
+
+            describe('when storage is passed', () => {
+                ['float32', 'uint8'].forEach((storage) => {
+                    context(storage, () => {
+                        context('sync', () => {
+                            it('returns the same result as double', () => {
+                                let recommendations = r.getTopCFRecommendations(this.ratings, this.row, { storage: storage });
+                                expect(recommendations).to.eql(this.expectedTopRecommendations);
+                            });
+                        });
+
+                        context('async', () => {
+                            it('returns the same result as double', (done) => {
+                                r.getTopCFRecommendations(this.ratings, this.row, { storage: storage }, (recommendations) => {
+                                    expect(recommendations).to.eql(this.expectedTopRecommendations);
+                                    done();
+                                });
+                            });
+                        });
+                    });
+                });
+
+                context('when uint8 is used with negative ratings', () => {
+                    it('throws an error', () => {
+                        expect(() => r.getTopCFRecommendations([[-1, 2], [3, 4]], 0, { storage: 'uint8' })).to.throw('Invalid storage option passed');
+                    });
+                });
+
+                context('when storage is unknown', () => {
+                    it('throws an error', () => {
+                        expect(() => r.getTopCFRecommendations(this.ratings, this.row, { storage: 'int64' })).to.throw('Invalid storage option passed');
+                    });
+                });
+            });
+
+            describe('when minCoRatings is passed', () => {
+                context('when it is 1', () => {
+                    it('returns the same result as without it', () => {
+                        let recommendations = r.getTopCFRecommendations(this.ratings, this.row, { minCoRatings: 1 });
+                        expect(recommendations).to.eql(this.expectedTopRecommendations);
+                    });
+                });
+
+                context('when no user rated as many items in common', () => {
+                    context('sync', () => {
+                        it('returns empty array', () => {
+                            let recommendations = r.getTopCFRecommendations(this.ratings, this.row, { minCoRatings: 100 });
+                            expect(recommendations).to.eql([]);
+                        });
+                    });
+
+                    context('async', () => {
+                        it('returns empty array', (done) => {
+                            r.getTopCFRecommendations(this.ratings, this.row, { minCoRatings: 100 }, (recommendations) => {
+                                expect(recommendations).to.eql([]);
+                                done();
+                            });
+                        });
+                    });
+                });
+
+                context('when it is invalid', () => {
+                    it('throws an error', () => {
+                        expect(() => r.getTopCFRecommendations(this.ratings, this.row, { minCoRatings: 0 })).to.throw('Invalid minCoRatings option passed');
+                    });
+                });
+            });
+
+            describe('when identical requests are in flight', () => {
+                context('async', () => {
+                    it('calls every callback with its own copy of the result', (done) => {
+                        let matrix = generateMatrix(300, 300);
+                        let results = [];
+                        let onResult = (recommendations) => {
+                            results.push(recommendations);
+                            if (results.length < 3) return;
+                            expect(results[1]).to.eql(results[0]);
+                            expect(results[2]).to.eql(results[0]);
+                            results[0].pop();
+                            expect(results[1].length).to.eql(results[0].length + 1);
+                            done();
+                        };
+                        for (let i = 0; i < 3; i++) {
+                            r.getTopCFRecommendations(matrix, this.row, { includeRatedItems: true }, onResult);
+                        }
+                    }).timeout(LONG_TIMEOUT);
+                });
+            });
+
+            describe('when signal is passed', () => {
+                context('async', () => {
+                    it('passes an abort status when the signal fires', (done) => {
+                        let listeners = [];
+                        let signal = {
+                            aborted: false,
+                            addEventListener: (type, listener) => listeners.push(listener),
+                            removeEventListener: (type, listener) => listeners.splice(listeners.indexOf(listener), 1)
+                        };
+                        r.getTopCFRecommendations(generateMatrix(1000, 1000), this.row, { signal: signal }, (recommendations, status) => {
+                            expect(status).to.eql({ cancelled: true, reason: 'abort' });
+                            expect(listeners).to.eql([]);
+                            done();
+                        });
+                        signal.aborted = true;
+                        listeners.forEach((listener) => listener());
+                    }).timeout(LONG_TIMEOUT);
+                });
+            });
+
             describe('very large matrix', () => {
                 context('sync', () => {
                     it('returns correct result', () => {
@@ -1024,4 +1544,572 @@ describe('Recommender', () => {
             });
         });
     });
+    context('getHybridRecommendations', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+            this.expectedRecommendations = [
+                { itemId: 1, rating: 4.4907920453550085 },
+                { itemId: 2, rating: 3.5926336362840074 },
+                { itemId: 6, rating: r.getGlobalBaselineRatingPrediction(this.ratings, 0, 6) },
+                { itemId: 5, rating: 0.5092079546449908 }
+            ];
+        });
+
+        const expectRecommendations = (recommendations, expected) => {
+            expect(recommendations.map((recommendation) => recommendation.itemId)).to.eql(expected.map((recommendation) => recommendation.itemId));
+            recommendations.forEach((recommendation, i) => expect(recommendation.rating).to.be.closeTo(expected[i].rating, 1e-9));
+        };
+
+        context('when correct params are sent', () => {
+            context('sync', () => {
+                it('falls back to the global baseline for items the neighbourhood did not rate', () => {
+                    expectRecommendations(r.getHybridRecommendations(this.ratings, 0), this.expectedRecommendations);
+                });
+            });
+
+            context('async', () => {
+                it('falls back to the global baseline for items the neighbourhood did not rate', (done) => {
+                    r.getHybridRecommendations(this.ratings, 0, (recommendations) => {
+                        expectRecommendations(recommendations, this.expectedRecommendations);
+                        done();
+                    });
+                });
+            });
+
+            context('when shrinkage is passed', () => {
+                it('blends the predictions with the global baseline', () => {
+                    expectRecommendations(r.getHybridRecommendations(this.ratings, 0, { shrinkage: 2, limit: 3 }), [
+                        { itemId: 1, rating: 3.9211731060274269 },
+                        { itemId: 2, rating: 2.9551203030037598 },
+                        { itemId: 5, rating: 2.5939784091240878 }
+                    ]);
+                });
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            it('throws for a negative shrinkage', () => {
+                expect(() => r.getHybridRecommendations(this.ratings, 0, { shrinkage: -1 })).to.throw('Invalid shrinkage option passed');
+            });
+        });
+    });
+    context('getGlobalBaselineRecommendations', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+        });
+
+        context('when correct params are sent', () => {
+            context('sync', () => {
+                it('returns the unrated items by their global baseline', () => {
+                    let recommendations = r.getGlobalBaselineRecommendations(this.ratings, 0);
+                    expect(recommendations.map((recommendation) => recommendation.itemId)).to.eql([1, 5, 2, 6]);
+                    recommendations.forEach((recommendation) => {
+                        expect(recommendation.rating).to.equal(r.getGlobalBaselineRatingPrediction(this.ratings, 0, recommendation.itemId));
+                    });
+                });
+
+                it('returns the items with the highest means for a user without ratings', () => {
+                    expect(r.getGlobalBaselineRecommendations(this.ratings.concat([[0, 0, 0, 0, 0, 0, 0]]), 4, { limit: 3 })).to.eql([
+                        { itemId: 1, rating: 5 },
+                        { itemId: 5, rating: 5 },
+                        { itemId: 0, rating: 4 }
+                    ]);
+                });
+            });
+
+            context('async', () => {
+                it('returns the unrated items by their global baseline', (done) => {
+                    r.getGlobalBaselineRecommendations(this.ratings, 0, { limit: 2 }, (recommendations) => {
+                        expect(recommendations).to.eql(r.getGlobalBaselineRecommendations(this.ratings, 0).slice(0, 2));
+                        done();
+                    });
+                });
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            it('returns an empty array for a row outside the matrix', () => {
+                expect(r.getGlobalBaselineRecommendations(this.ratings, 4)).to.eql([]);
+            });
+
+            it('throws error for a negative or NaN limit', () => {
+                expect(() => r.getGlobalBaselineRecommendations(this.ratings, 0, { limit: -5 })).to.throw('Invalid limit option passed');
+                expect(() => r.getGlobalBaselineRecommendations(this.ratings, 0, { limit: NaN })).to.throw('Invalid limit option passed');
+            });
+        });
+    });
+    context('getBinaryRecommendations', () => {
+        beforeEach(() => {
+            this.interactions = [
+                [1, 0, 1, 0],
+                [1, 1, 0, 0],
+                [0, 1, 1, 1]
+            ];
+        });
+
+        context('when correct params are sent', () => {
+            context('sync', () => {
+                it('returns the items by the share of the neighbourhood which has them', () => {
+                    let recommendations = r.getBinaryRecommendations(this.interactions, 0);
+                    expect(recommendations.map((recommendation) => recommendation.itemId)).to.eql([1, 3]);
+                    expect(recommendations[0].rating).to.be.closeTo(1, 1e-12);
+                    expect(recommendations[1].rating).to.be.closeTo((1 / Math.sqrt(6)) / (1 / 2 + 1 / Math.sqrt(6)), 1e-12);
+                });
+
+                it('uses the jaccard similarity when it is passed', () => {
+                    let recommendations = r.getBinaryRecommendations(this.interactions, 0, { similarity: 'jaccard' });
+                    expect(recommendations[1].rating).to.be.closeTo(3 / 7, 1e-12);
+                });
+
+                it('treats every value other than 0 as an interaction', () => {
+                    let ratings = this.interactions.map((row) => row.map((value) => value * 4));
+                    expect(r.getBinaryRecommendations(ratings, 0)).to.eql(r.getBinaryRecommendations(this.interactions, 0));
+                });
+
+                it('leaves out the rows with fewer items in common than minCoRatings', () => {
+                    expect(r.getBinaryRecommendations(this.interactions, 0, { minCoRatings: 2 })).to.eql([]);
+                });
+            });
+
+            context('async', () => {
+                it('returns the same results as sync', (done) => {
+                    r.getBinaryRecommendations(this.interactions, 0, { similarity: 'jaccard', limit: 1 }, (recommendations) => {
+                        expect(recommendations).to.eql(r.getBinaryRecommendations(this.interactions, 0, { similarity: 'jaccard' }).slice(0, 1));
+                        done();
+                    });
+                });
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            it('returns an empty array for a row outside the matrix', () => {
+                expect(r.getBinaryRecommendations(this.interactions, 3)).to.eql([]);
+            });
+
+            it('throws error for an unknown similarity', () => {
+                expect(() => r.getBinaryRecommendations(this.interactions, 0, { similarity: 'pearson' })).to.throw('Invalid similarity option passed');
+            });
+        });
+    });
+    context('evaluate', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+        });
+
+        context('when correct params are sent', () => {
+            context('sync', () => {
+                it('holds out leaveOut ratings of every user with the leaveKOut split', () => {
+                    let result = r.evaluate(this.ratings, { split: 'leaveKOut', seed: 1 });
+                    expect(result.testRatings).to.equal(4);
+                    expect(result.users).to.equal(4);
+                    expect(result.folds).to.equal(1);
+                    expect(result.predictions).to.equal(1);
+                    expect(result.rmse).to.be.closeTo(1, 1e-12);
+                });
+
+                it('tests every rating once with the kFold split', () => {
+                    let result = r.evaluate(this.ratings, { split: 'kFold', folds: 3, seed: 1, predictor: 'globalBaseline' });
+                    expect(result.testRatings).to.equal(11);
+                    expect(result.folds).to.equal(3);
+                    expect(result.predictions).to.equal(6);
+                    expect(result.rmse).to.be.closeTo(1.8051325162880825, 1e-12);
+                    expect(result.mae).to.be.closeTo(1.4285714285714286, 1e-12);
+                });
+
+                it('returns precision and recall of the top CF recommendations', () => {
+                    let result = r.evaluate(this.ratings, { split: 'leaveKOut', seed: 1, predictor: 'topCF', cutoff: 2 });
+                    expect(result.precision).to.be.closeTo(0.25, 1e-12);
+                    expect(result.recall).to.be.closeTo(0.5, 1e-12);
+                    expect(result).to.not.have.property('rmse');
+                });
+            });
+
+            context('async', () => {
+                it('returns the same results as sync', (done) => {
+                    let options = { split: 'kFold', folds: 3, seed: 2, predictor: 'globalBaseline' };
+                    r.evaluate(this.ratings, options, (result) => {
+                        expect(result).to.eql(r.evaluate(this.ratings, options));
+                        done();
+                    });
+                });
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            it('throws error', () => {
+                expect(() => r.evaluate(null)).to.throw('Invalid ratings passed');
+                expect(() => r.evaluate(this.ratings, { split: 'bootstrap' })).to.throw('Invalid split option passed');
+                expect(() => r.evaluate(this.ratings, { split: 'kFold', folds: 1 })).to.throw('Invalid folds option passed');
+            });
+        });
+    });
+    context('Corpus', () => {
+        beforeEach(() => {
+            this.query = 'get current date time javascript';
+            this.documents = [
+                'get the current date and time in javascript',
+                'get the current date and time in python',
+                'something very different',
+                'what is the time now'
+            ];
+            this.expectedIds = [0, 1, 3];
+        });
+
+        context('when correct params are sent', () => {
+            describe('when there is one shard', () => {
+                context('sync', () => {
+                    it('returns the documents in the order of tfidf', () => {
+                        let results = new r.Corpus(this.documents).search(this.query);
+                        expect(results.map((result) => result.id)).to.eql(this.expectedIds);
+                    });
+                });
+
+                context('async', () => {
+                    it('returns the documents in the order of tfidf', (done) => {
+                        new r.Corpus(this.documents).search(this.query, (results) => {
+                            expect(results.map((result) => result.id)).to.eql(this.expectedIds);
+                            done();
+                        });
+                    });
+                });
+            });
+
+            describe('when there are several shards', () => {
+                ['range', 'hash'].forEach((partition) => {
+                    it('returns the same results as one shard with ' + partition + ' partitioning', () => {
+                        let corpus = new r.Corpus(this.documents, { shards: 3, partition: partition });
+                        expect(corpus.search(this.query)).to.eql(new r.Corpus(this.documents).search(this.query));
+                    });
+                });
+            });
+
+            describe('when limit is passed', () => {
+                it('returns the best documents', () => {
+                    let results = new r.Corpus(this.documents, { shards: 2 }).search(this.query, { limit: 2 });
+                    expect(results.map((result) => result.id)).to.eql(this.expectedIds.slice(0, 2));
+                });
+            });
+
+            describe('when the corpus is saved and loaded', () => {
+                it('returns the same results', () => {
+                    let corpus = new r.Corpus(this.documents, { shards: 2, filterStopWords: true });
+                    let path = require('os').tmpdir() + '/recommender-corpus-' + process.pid + '.bin';
+                    corpus.save(path);
+                    let loaded = r.Corpus.load(path);
+                    require('fs').unlinkSync(path);
+                    expect(loaded.search(this.query)).to.eql(corpus.search(this.query));
+                    expect(loaded.stats()).to.eql(corpus.stats());
+                });
+
+                it('returns the same results in a worker thread', (done) => {
+                    let workerThreads;
+                    try {
+                        workerThreads = require('worker_threads');
+                    } catch (e) {
+                        return done();
+                    }
+
+                    let corpus = new r.Corpus(this.documents);
+                    let path = require('os').tmpdir() + '/recommender-corpus-worker-' + process.pid + '.bin';
+                    corpus.save(path);
+                    let worker = new workerThreads.Worker(
+                        'const { parentPort, workerData } = require("worker_threads");' +
+                        'const r = require(workerData.addon);' +
+                        'r.Corpus.load(workerData.path).search(workerData.query, (results) => parentPort.postMessage(results));',
+                        { eval: true, workerData: { addon: require.resolve('recommender'), path: path, query: this.query } }
+                    );
+                    worker.on('message', (results) => {
+                        require('fs').unlinkSync(path);
+                        expect(results).to.eql(corpus.search(this.query));
+                        done();
+                    });
+                });
+            });
+
+            describe('when the corpus is updated', () => {
+                context('sync', () => {
+                    it('searches the new documents', () => {
+                        let corpus = new r.Corpus(this.documents);
+                        expect(corpus.update(this.documents.slice(1), { ids: [1, 2, 3] })).to.equal(true);
+                        expect(corpus.search(this.query).map((result) => result.id)).to.eql([1, 3]);
+                    });
+                });
+
+                context('async', () => {
+                    it('finishes started searches on the old documents', (done) => {
+                        let corpus = new r.Corpus(this.documents);
+                        let expected = corpus.search(this.query);
+                        corpus.search(this.query, (results) => {
+                            expect(results).to.eql(expected);
+                            corpus.update(this.documents.slice(2), (updated) => {
+                                expect(updated).to.equal(true);
+                                expect(corpus.search(this.query).map((result) => result.id)).to.eql([1]);
+                                done();
+                            });
+                        });
+                        corpus.update([]);
+                    });
+                });
+
+                describe('when the file is not a corpus', () => {
+                    it('keeps the old documents', () => {
+                        let corpus = new r.Corpus(this.documents);
+                        expect(corpus.update(require('os').tmpdir() + '/recommender-missing.bin')).to.equal(false);
+                        expect(corpus.search(this.query).map((result) => result.id)).to.eql(this.expectedIds);
+                    });
+                });
+            });
+
+            describe('when scoring is bm25', () => {
+                it('returns the documents in the order of bm25', () => {
+                    let results = new r.Corpus(this.documents, { shards: 2 }).search(this.query, { scoring: 'bm25' });
+                    expect(results.map((result) => result.id)).to.eql(this.expectedIds);
+                });
+
+                it('returns the first of all results when limit is passed', () => {
+                    let corpus = new r.Corpus(this.documents, { shards: 3 });
+                    let results = corpus.search(this.query, { scoring: 'bm25' });
+                    expect(corpus.search(this.query, { scoring: 'bm25', limit: 2 })).to.eql(results.slice(0, 2));
+                });
+            });
+
+            describe('when the corpus is split in parts', () => {
+                it('returns the same results as one corpus', () => {
+                    let first = new r.Corpus(this.documents.slice(0, 2), { ids: [0, 1] });
+                    let second = new r.Corpus(this.documents.slice(2), { ids: [2, 3] });
+                    let stats = { documents: 0, documentFrequencies: {} };
+                    [first.stats(), second.stats()].forEach((partStats) => {
+                        stats.documents += partStats.documents;
+                        Object.keys(partStats.documentFrequencies).forEach((term) => {
+                            stats.documentFrequencies[term] = (stats.documentFrequencies[term] || 0) + partStats.documentFrequencies[term];
+                        });
+                    });
+
+                    let results = r.mergeSearchResults([
+                        first.search(this.query, { stats: stats }),
+                        second.search(this.query, { stats: stats })
+                    ]);
+                    expect(results).to.eql(new r.Corpus(this.documents).search(this.query));
+                });
+            });
+        });
+
+        context('when invalid params are sent', () => {
+            describe('when shards are invalid', () => {
+                it('throws error', () => {
+                    expect(() => new r.Corpus(this.documents, { shards: 0 })).to.throw('Invalid shards option passed');
+                });
+            });
+
+            describe('when partition is invalid', () => {
+                it('throws error', () => {
+                    expect(() => new r.Corpus(this.documents, { partition: 'random' })).to.throw('Invalid partition option passed');
+                });
+            });
+
+            describe('when ids do not match the documents', () => {
+                it('throws error', () => {
+                    expect(() => new r.Corpus(this.documents, { ids: [0] })).to.throw('Invalid ids option passed');
+                });
+            });
+
+            describe('when stats are invalid', () => {
+                it('throws error', () => {
+                    expect(() => new r.Corpus(this.documents).search(this.query, { stats: 1 })).to.throw('Invalid stats option passed');
+                });
+            });
+
+            describe('when scoring is invalid', () => {
+                it('throws error', () => {
+                    expect(() => new r.Corpus(this.documents).search(this.query, { scoring: 'cosine' })).to.throw('Invalid scoring option passed');
+                });
+            });
+
+            describe('when the file is not a corpus', () => {
+                it('throws error', () => {
+                    let path = require('os').tmpdir() + '/recommender-ratings-' + process.pid + '.bin';
+                    new r.RatingModel([[1, 2], [3, 4]]).save(path);
+                    expect(() => r.Corpus.load(path)).to.throw('Invalid model file passed');
+                    require('fs').unlinkSync(path);
+                    expect(() => r.Corpus.load(path)).to.throw('Invalid model file passed');
+                });
+            });
+        });
+    });
+
+    context('RatingModel', () => {
+        beforeEach(() => {
+            this.ratings = [
+                [4, 0, 0, 1, 1, 0, 0],
+                [5, 5, 4, 0, 0, 0, 0],
+                [0, 0, 0, 2, 4, 5, 0],
+                [3, 0, 0, 0, 0, 0, 3]
+            ];
+        });
+
+        context('when there is one shard', () => {
+            context('sync', () => {
+                it('returns the same results as the functions', () => {
+                    let model = new r.RatingModel(this.ratings);
+                    expect(model.getTopCFRecommendations(0)).to.eql(r.getTopCFRecommendations(this.ratings, 0));
+                    expect(model.getRatingPrediction(0, 1)).to.eql(r.getRatingPrediction(this.ratings, 0, 1));
+                    expect(model.getGlobalBaselineRatingPrediction(0, 1)).to.eql(r.getGlobalBaselineRatingPrediction(this.ratings, 0, 1));
+                    let hybrid = r.getHybridRecommendations(this.ratings, 0, { shrinkage: 2 });
+                    model.getHybridRecommendations(0, { shrinkage: 2 }).forEach((recommendation, i) => {
+                        expect(recommendation.itemId).to.equal(hybrid[i].itemId);
+                        expect(recommendation.rating).to.be.closeTo(hybrid[i].rating, 1e-9);
+                    });
+                    expect(model.getGlobalBaselineRecommendations(0)).to.eql(r.getGlobalBaselineRecommendations(this.ratings, 0));
+                });
+
+                it('returns the global baseline recommendations of a user without ratings for an unknown id', () => {
+                    let model = new r.RatingModel(this.ratings, { shards: 2 });
+                    let expected = r.getGlobalBaselineRecommendations(this.ratings.concat([[0, 0, 0, 0, 0, 0, 0]]), 4, { limit: 3 });
+                    expect(model.getGlobalBaselineRecommendations(42, { limit: 3 })).to.eql(expected);
+                });
+            });
+
+            context('async', () => {
+                it('returns the same results as the functions', (done) => {
+                    new r.RatingModel(this.ratings).getTopCFRecommendations(0, { limit: 2 }, (recommendations) => {
+                        expect(recommendations).to.eql(r.getTopCFRecommendations(this.ratings, 0, { limit: 2 }));
+                        done();
+                    });
+                });
+            });
+        });
+
+        context('when there are several shards', () => {
+            ['range', 'hash'].forEach((partition) => {
+                it('returns the same results as the functions with ' + partition + ' partitioning', () => {
+                    let model = new r.RatingModel(this.ratings, { shards: 3, partition: partition });
+                    let expected = r.getTopCFRecommendations(this.ratings, 0);
+                    let recommendations = model.getTopCFRecommendations(0);
+                    expect(recommendations.map((recommendation) => recommendation.itemId)).to.eql(expected.map((recommendation) => recommendation.itemId));
+                    recommendations.forEach((recommendation, i) => expect(recommendation.rating).to.be.closeTo(expected[i].rating, 1e-9));
+                    expect(model.getGlobalBaselineRatingPrediction(0, 1)).to.be.closeTo(r.getGlobalBaselineRatingPrediction(this.ratings, 0, 1), 1e-9);
+                });
+            });
+        });
+
+        context('when the model is saved and loaded', () => {
+            it('returns the same results', () => {
+                let model = new r.RatingModel(this.ratings, { shards: 2, ids: [10, 11, 12, 13] });
+                let path = require('os').tmpdir() + '/recommender-model-' + process.pid + '.bin';
+                model.save(path);
+                let loaded = r.RatingModel.load(path);
+                require('fs').unlinkSync(path);
+                expect(loaded.getTopCFRecommendations(10)).to.eql(model.getTopCFRecommendations(10));
+                expect(loaded.getRatingPrediction(11, 3)).to.eql(model.getRatingPrediction(11, 3));
+                expect(loaded.getGlobalBaselineRatingPrediction(12, 1)).to.eql(model.getGlobalBaselineRatingPrediction(12, 1));
+            });
+        });
+
+        context('when the model is updated', () => {
+            it('returns the results of the new ratings', (done) => {
+                let model = new r.RatingModel(this.ratings);
+                let ratings = this.ratings.slice().reverse();
+                model.update(ratings, (updated) => {
+                    expect(updated).to.equal(true);
+                    expect(model.getTopCFRecommendations(0)).to.eql(r.getTopCFRecommendations(ratings, 0));
+                    done();
+                });
+            });
+        });
+
+        context('when ids are passed', () => {
+            it('takes ids in place of row indexes', () => {
+                let model = new r.RatingModel(this.ratings, { ids: [10, 11, 12, 13] });
+                expect(model.getTopCFRecommendations(10)).to.eql(r.getTopCFRecommendations(this.ratings, 0));
+                expect(model.getTopCFRecommendations(0)).to.eql([]);
+            });
+        });
+
+        context('when ratings are added', () => {
+            beforeEach(() => {
+                this.added = [{ id: 0, itemId: 2, rating: 4 }, { id: 3, itemId: 1, rating: 5 }, { id: 2, itemId: 4, rating: 0 }];
+                this.patched = this.ratings.map((row) => row.slice());
+                this.added.forEach((rating) => this.patched[rating.id][rating.itemId] = rating.rating);
+            });
+
+            it('returns the results of the added ratings before and after they are merged', () => {
+                let model = new r.RatingModel(this.ratings, { shards: 2 });
+                let expectPatched = () => [0, 1, 3].forEach((id) => {
+                    let expected = r.getTopCFRecommendations(this.patched, id);
+                    let recommendations = model.getTopCFRecommendations(id);
+                    expect(recommendations.map((recommendation) => recommendation.itemId)).to.eql(expected.map((recommendation) => recommendation.itemId));
+                    recommendations.forEach((recommendation, i) => expect(recommendation.rating).to.be.closeTo(expected[i].rating, 1e-9));
+                });
+                expect(model.addRatings(this.added)).to.equal(3);
+                expectPatched();
+                expect(model.getRatingPrediction(1, 6)).to.be.closeTo(r.getRatingPrediction(this.patched, 1, 6), 1e-9);
+                expect(model.merge()).to.equal(true);
+                expect(model.merge()).to.equal(false);
+                expectPatched();
+                expect(model.getGlobalBaselineRatingPrediction(0, 1)).to.be.closeTo(r.getGlobalBaselineRatingPrediction(this.patched, 0, 1), 1e-9);
+            });
+
+            it('merges them on the pool once mergeThreshold are pending', (done) => {
+                let model = new r.RatingModel(this.ratings, { mergeThreshold: 1 });
+                expect(model.addRatings(this.added)).to.equal(0);
+                expect(model.getTopCFRecommendations(0)).to.eql(r.getTopCFRecommendations(this.patched, 0));
+                model.getTopCFRecommendations(3, (recommendations) => {
+                    expect(recommendations).to.eql(r.getTopCFRecommendations(this.patched, 3));
+                    done();
+                });
+            });
+
+            it('throws error when the ratings or mergeThreshold are invalid', () => {
+                let model = new r.RatingModel(this.ratings);
+                expect(() => model.addRatings({ id: 0, itemId: 1, rating: 2 })).to.throw('Invalid ratings passed');
+                expect(() => model.addRatings([{ id: -1, itemId: 1, rating: 2 }])).to.throw('Invalid ratings passed');
+                expect(() => new r.RatingModel(this.ratings, { mergeThreshold: 0 })).to.throw('Invalid mergeThreshold option passed');
+            });
+        });
+
+        context('when memoryUsage is called', () => {
+            it('returns the bytes of the components', () => {
+                let usage = new r.RatingModel(this.ratings, { shards: 2 }).memoryUsage();
+                expect(usage.components.matrix).to.equal(4 * 7 * 8);
+                expect(usage.heapBytes).to.be.at.least(usage.components.matrix + usage.components.index);
+                expect(usage.mappedBytes).to.equal(0);
+            });
+        });
+
+        context('when the model does not fit in the memory budget', () => {
+            afterEach(() => {
+                r.configure({ memoryBudget: 0 });
+            });
+
+            it('throws error and leaves the model of an update unchanged', () => {
+                let model = new r.RatingModel(this.ratings);
+                r.configure({ memoryBudget: 1 });
+                let ratings = generateMatrix(100, 100);
+                expect(() => new r.RatingModel(ratings)).to.throw('Model exceeds memory budget');
+                expect(model.update(ratings)).to.equal(false);
+                expect(model.getTopCFRecommendations(0)).to.eql(r.getTopCFRecommendations(this.ratings, 0));
+            });
+        });
+
+        context('when shards are invalid', () => {
+            it('throws error', () => {
+                expect(() => new r.RatingModel(this.ratings, { shards: 'all' })).to.throw('Invalid shards option passed');
+            });
+        });
+    });
 });
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <memory>
+#include <stddef.h>
+
+using namespace std;
+
+// Scratch memory of one thread for the temporaries of a call. Allocation bumps
+// an offset in a chunk, and freeing only takes back the last allocation, so
+// all memory of a call is given back at once when its ArenaScope ends. The
+// chunks stay with the thread and are reused by its next calls, so once the
+// chunks are large enough, calls don't allocate temporaries from the system
+// at all. Allocations made outside of any scope go to the heap.
+class Arena {
+public:
+	// The position to release back to.
+	struct Mark {
+		size_t chunk;
+		size_t offset;
+	};
+
+	// The arena of the calling thread.
+	static Arena &getLocal();
+
+	Arena() : chunk(0), offset(0), depth(0) {};
+
+	void *allocate(size_t size, size_t alignment);
+	void deallocate(void *pointer, size_t size);
+
+	Mark enter();
+	void leave(Mark mark);
+
+	// The bytes of all chunks.
+	size_t getCapacity() const;
+
+private:
+	struct Chunk {
+		unique_ptr<char[]> bytes;
+		size_t size;
+	};
+
+	vector<Chunk> chunks;
+	size_t chunk;
+	size_t offset;
+	int depth;
+
+	bool contains(const void *pointer) const;
+};
+
+// Frees everything allocated from the thread's arena while it is alive.
+// Scratch containers must be declared after the scope they are allocated in.
+class ArenaScope {
+public:
+	ArenaScope() : arena(Arena::getLocal()), mark(arena.enter()) {};
+	~ArenaScope() {
+		this->arena.leave(this->mark);
+	}
+
+private:
+	Arena &arena;
+	Arena::Mark mark;
+
+	ArenaScope(const ArenaScope &);
+	ArenaScope &operator=(const ArenaScope &);
+};
+
+// Allocates from the arena of the thread which allocates.
+template <typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	ArenaAllocator() {};
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &) {};
+
+	T *allocate(size_t count) {
+		return static_cast<T *>(Arena::getLocal().allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *pointer, size_t count) {
+		Arena::getLocal().deallocate(pointer, count * sizeof(T));
+	}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &) {
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &) {
+	return false;
+}
+
+template <typename T>
+using ScratchVector = vector<T, ArenaAllocator<T>>;
+
+#endif
@@ -0,0 +1,159 @@
+#pragma once
+
+#ifndef BINARY_MATRIX_H
+#define BINARY_MATRIX_H
+
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include "Utils.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Similarity of two rows of a binary matrix from the number of items both of
+// them have and the number each of them has. Used as a template parameter, so
+// the kernels which score the rows are compiled once for every measure.
+struct CosineSimilarity {
+	static double get(int common, int countA, int countB) {
+		if (!common) return 0;
+		return common / sqrt((double)countA * countB);
+	}
+
+	static const char *getName() { return "cosine"; }
+};
+
+struct JaccardSimilarity {
+	static double get(int common, int countA, int countB) {
+		if (!common) return 0;
+		return common / (double)(countA + countB - common);
+	}
+
+	static const char *getName() { return "jaccard"; }
+};
+
+// Dense row major 0/1 matrix of interactions, such as views or purchases, with
+// every row stored as a bitset of 64 bit words. Any value other than 0 is an
+// interaction. The items two rows have in common are counted a word at a time,
+// from the population count of the AND of their words.
+class BinaryMatrix {
+public:
+	BinaryMatrix() : rows(0), cols(0), words(0) {};
+
+	BinaryMatrix(int rows, int cols) :
+		bits((size_t)rows * BinaryMatrix::getWordsSize(cols), 0),
+		counts(rows, 0),
+		rows(rows),
+		cols(cols),
+		words(BinaryMatrix::getWordsSize(cols)) {};
+
+	// Rows shorter than the longest one are padded with zeros.
+	static BinaryMatrix fromRows(const vector<vector<double>> &ratings) {
+		int rows = ratings.size();
+		int cols = 0;
+		for (int i = 0; i < rows; i++) {
+			if ((int)ratings[i].size() > cols) cols = ratings[i].size();
+		}
+
+		BinaryMatrix matrix(rows, cols);
+		for (int i = 0; i < rows; i++) {
+			int rowSize = ratings[i].size();
+			for (int j = 0; j < rowSize; j++) {
+				if (ratings[i][j] != 0) matrix.set(i, j);
+			}
+		}
+
+		return matrix;
+	}
+
+	static int getWordsSize(int cols) {
+		return (cols + 63) / 64;
+	}
+
+	// Number of bits set in both a and b.
+	static int countCommon(const uint64_t *a, const uint64_t *b, int words) {
+		// Four counts keep four popcounts in flight instead of waiting on one.
+		int counts[4] = { 0, 0, 0, 0 };
+		int i = 0;
+		for (; i + 4 <= words; i += 4) {
+			counts[0] += BinaryMatrix::popcount(a[i] & b[i]);
+			counts[1] += BinaryMatrix::popcount(a[i + 1] & b[i + 1]);
+			counts[2] += BinaryMatrix::popcount(a[i + 2] & b[i + 2]);
+			counts[3] += BinaryMatrix::popcount(a[i + 3] & b[i + 3]);
+		}
+		for (; i < words; i++) counts[0] += BinaryMatrix::popcount(a[i] & b[i]);
+
+		return counts[0] + counts[1] + counts[2] + counts[3];
+	}
+
+	// Compiles to a single instruction where the target has one, and to a few
+	// shifts and adds elsewhere.
+	static int popcount(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_popcountll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return (int)__popcnt64(word);
+#else
+		word = word - ((word >> 1) & 0x5555555555555555ULL);
+		word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+		word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+		return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+	}
+
+	// Index of the lowest bit set in a word other than 0.
+	static int getLowestBit(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(word);
+#else
+		return BinaryMatrix::popcount((word & (~word + 1)) - 1);
+#endif
+	}
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	int getWords() const { return this->words; }
+	size_t getBytes() const { return this->bits.size() * sizeof(uint64_t) + this->counts.size() * sizeof(int); }
+
+	const uint64_t *getRow(int row) const {
+		return this->bits.data() + (size_t)row * this->words;
+	}
+
+	// Number of items of the row.
+	int getCount(int row) const {
+		return this->counts[row];
+	}
+
+	bool get(int row, int col) const {
+		return (this->getRow(row)[col >> 6] >> (col & 63)) & 1;
+	}
+
+	void set(int row, int col) {
+		uint64_t &word = this->bits[(size_t)row * this->words + (col >> 6)];
+		uint64_t bit = (uint64_t)1 << (col & 63);
+		if (word & bit) return;
+		word |= bit;
+		this->counts[row]++;
+	}
+
+	uint64_t getVersion() const {
+		uint64_t seed = Utils::hashBytes("binary", 6, this->rows);
+		return Utils::hashBytes(this->bits.data(), this->bits.size() * sizeof(uint64_t), seed ^ this->cols);
+	}
+
+	bool equals(const BinaryMatrix &other) const {
+		return this->rows == other.rows && this->cols == other.cols && this->bits == other.bits;
+	}
+
+private:
+	vector<uint64_t> bits;
+	vector<int> counts;
+	int rows;
+	int cols;
+	int words;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+class CancellationToken {
+public:
+	enum State { ACTIVE = 0, ABORTED = 1, TIMED_OUT = 2 };
+
+	CancellationToken() : state(ACTIVE), hasDeadline(false) {};
+
+	void abort() {
+		int expected = ACTIVE;
+		this->state.compare_exchange_strong(expected, ABORTED);
+	}
+
+	void setTimeout(int milliseconds) {
+		if (milliseconds < 0) return;
+		this->deadline = chrono::steady_clock::now() + chrono::milliseconds(milliseconds);
+		this->hasDeadline = true;
+	}
+
+	// Called from the worker thread inside the hot loops, so once the token
+	// is cancelled it does not touch the clock again.
+	bool isCancelled() {
+		if (this->state.load(memory_order_relaxed) != ACTIVE) return true;
+		if (this->hasDeadline && chrono::steady_clock::now() >= this->deadline) {
+			int expected = ACTIVE;
+			this->state.compare_exchange_strong(expected, TIMED_OUT);
+			return true;
+		}
+
+		return false;
+	}
+
+	State getState() const {
+		return (State)this->state.load();
+	}
+
+private:
+	atomic<int> state;
+	bool hasDeadline;
+	chrono::steady_clock::time_point deadline;
+};
+
+#endif
@@ -5,8 +5,36 @@
 
 #include <set>
 #include <string>
+#include <stddef.h>
 
 const static double MAX_NEIGHBOURS = 100;
+const static int CANCELLATION_CHECK_INTERVAL = 64;
+const static int DEFAULT_POOL_SIZE = 4;
+const static int BATCH_STARVATION_LIMIT = 8;
+const static int TOP_CF_BATCH_CHUNK_SIZE = 256;
+const static int TOP_CF_BATCH_TILE_BYTES = 256 * 1024;
+// Without an index, co-ratings are counted only for rows which rated at most
+// one in this many items, above that scoring every row is as cheap.
+const static int CO_RATING_SCAN_MAX_SHARE = 4;
+const static double BM25_K1 = 1.2;
+const static double BM25_B = 0.75;
+// Max scores of BM25 terms are raised by this share, so rounding can't make
+// a document's score exceed the bound it is pruned with.
+const static double BM25_BOUND_SLACK = 1e-9;
+const static int ARENA_CHUNK_BYTES = 64 * 1024;
+// Chunks of a thread's arena past this size are freed when its outermost scope
+// ends, so one large request doesn't hold on to its memory.
+const static int ARENA_RETAINED_BYTES = 8 * 1024 * 1024;
+// Default budget of the parsed document files of tfidf.
+const static size_t FILE_CACHE_BYTES = 64 * 1024 * 1024;
+// Default number of ratings added to a rating model which start a merge.
+const static int DELTA_MERGE_THRESHOLD = 4096;
+// Defaults of the held out share of a random split, the number of folds of a
+// k-fold split and the number of recommendations precision and recall are
+// computed on.
+const static double EVALUATION_TEST_SHARE = 0.2;
+const static int EVALUATION_FOLDS = 5;
+const static int EVALUATION_CUTOFF = 10;
 const std::set<std::string> STOP_WORDS = {
 	"a",
 	"about",
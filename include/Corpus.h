@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+#include "ModelImage.h"
+#include "PostingList.h"
+
+using namespace std;
+
+// Document counts which the idf of a term is computed from, and the number of
+// words of all documents, which the average document length of BM25 is
+// computed from. The stats of all shards of a corpus are merged, so every
+// shard scores with the same idf.
+struct CorpusStats {
+	int documents;
+	double words;
+	map<string, int> documentFrequencies;
+
+	CorpusStats() : documents(0), words(0) {};
+
+	void merge(const CorpusStats &other);
+};
+
+enum CorpusScoring { SCORING_TFIDF, SCORING_BM25 };
+
+// A query term with its weight and the number of documents which contain it.
+// The weight is the tf-idf of the term in the query, or for BM25 its idf times
+// the number of times it appears in the query.
+struct QueryTerm {
+	string term;
+	double weight;
+	int documentFrequency;
+};
+
+// Documents with global ids, tokenized once and kept as an inverted index from
+// every term to the documents which contain it, in compressed posting lists.
+// The index is a section of a model image which is read in place. Scores are
+// the cosine tf-idf similarities which Recommender::recommend computes, or
+// BM25 scores, with the idf taken from the document frequencies passed in,
+// which may be those of a larger corpus.
+class Corpus {
+public:
+	Corpus() :
+		documents(0),
+		words(0),
+		blockOffsets(NULL),
+		documentFrequencies(NULL),
+		blocks(NULL),
+		postingWords(NULL),
+		postingWordsSize(0),
+		maxCounts(NULL),
+		minLengths(NULL),
+		ids(NULL),
+		lengths(NULL) {};
+
+	// Builds the section of the documents with their ids, and adds their
+	// document counts to stats.
+	static vector<char> build(const vector<int> &ids, const vector<const string *> &documents, bool useStopWords, CorpusStats &stats);
+	// Attaches to the section at offset. Returns false if it doesn't fit in
+	// the image.
+	bool read(const ModelImage &image, uint64_t offset);
+
+	int size() const {
+		return this->documents;
+	}
+	CorpusStats getStats() const;
+	// Adds the bytes of the terms, the postings and the documents.
+	void addMemoryUsage(MemoryUsage &usage) const;
+
+	vector<pair<int, double>> search(const vector<QueryTerm> &terms, int documents, int limit) const;
+	vector<pair<int, double>> searchBm25(const vector<QueryTerm> &terms, double averageLength, int limit) const;
+
+	static void sortHits(vector<pair<int, double>> &hits, int limit);
+	static double calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, int documentFrequency, int documents);
+	static double calculateBm25Idf(int documentFrequency, int documents);
+	static double calculateBm25(double weight, int count, int length, double averageLength);
+
+private:
+	PostingCursor getPostings(int termIndex) const {
+		return PostingCursor(this->blocks + this->blockOffsets[termIndex], this->blocks + this->blockOffsets[termIndex + 1], this->postingWords);
+	}
+
+	struct Header {
+		int32_t documents;
+		int32_t reserved;
+		double words;
+		uint64_t terms;
+		uint64_t blockOffsets;
+		uint64_t documentFrequencies;
+		uint64_t blocks;
+		uint64_t postingWords;
+		uint64_t postingWordsSize;
+		uint64_t maxCounts;
+		uint64_t minLengths;
+		uint64_t ids;
+		uint64_t lengths;
+	};
+
+	int documents;
+	double words;
+	StringTable terms;
+	// The index of every term's first block and one past the last.
+	const uint64_t *blockOffsets;
+	const int32_t *documentFrequencies;
+	const PostingBlock *blocks;
+	const uint32_t *postingWords;
+	uint64_t postingWordsSize;
+	// The highest count and the shortest length among the postings of every
+	// term, from which an upper bound of its BM25 score is computed.
+	const int32_t *maxCounts;
+	const int32_t *minLengths;
+	const int32_t *ids;
+	const int32_t *lengths;
+};
+
+#endif
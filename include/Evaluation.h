@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include "recommender.h"
+#include "Constants.h"
+
+using namespace std;
+
+enum EvaluationSplit { SPLIT_RANDOM, SPLIT_LEAVE_K_OUT, SPLIT_K_FOLD };
+enum EvaluationPredictor { PREDICTOR_CF, PREDICTOR_GLOBAL_BASELINE, PREDICTOR_TOP_CF };
+
+// How the ratings are split into training and test ratings, and what is
+// predicted for the test ratings. random holds out testShare of all ratings,
+// leave-k-out holds out leaveOut ratings of every user who has more, and
+// k-fold splits the ratings into folds and tests every fold against the
+// others. The split only depends on the ratings and the seed.
+struct EvaluationOptions {
+	EvaluationSplit split;
+	EvaluationPredictor predictor;
+	double testShare;
+	int leaveOut;
+	int folds;
+	uint64_t seed;
+	// The number of recommendations precision and recall are computed on.
+	int cutoff;
+	// Test ratings below it don't count as relevant for precision and recall.
+	double relevantRating;
+
+	EvaluationOptions() :
+		split(SPLIT_RANDOM),
+		predictor(PREDICTOR_CF),
+		testShare(EVALUATION_TEST_SHARE),
+		leaveOut(1),
+		folds(EVALUATION_FOLDS),
+		seed(0),
+		cutoff(EVALUATION_CUTOFF),
+		relevantRating(0) {};
+};
+
+// Metrics of all folds. rmse and mae are those of the test ratings which the
+// predictor could predict, and precision and recall the means over the users
+// with relevant test ratings. The metrics of the other kind of predictor are
+// NAN.
+struct EvaluationResult {
+	double rmse;
+	double mae;
+	double precision;
+	double recall;
+	int testRatings;
+	int predictions;
+	int users;
+	int folds;
+
+	EvaluationResult() : rmse(NAN), mae(NAN), precision(NAN), recall(NAN), testRatings(0), predictions(0), users(0), folds(0) {};
+};
+
+// Offline evaluation of the predictors of a Recommender on held out ratings.
+// Every fold builds its training matrix, its inverted index and the norms of
+// its rows once, and the state a predictor needs for a user is computed once
+// for all of their test ratings. Similarities are only computed for the rows
+// which rated items in common with the user, from the postings of the user's
+// items. The users of a fold are spread over threads, and their errors are
+// added up in user order, so the results don't depend on the threads.
+class Evaluator {
+public:
+	Evaluator(Recommender &recommender, const EvaluationOptions &options) : recommender(recommender), options(options) {};
+
+	template <typename T> EvaluationResult evaluate(const vector<vector<double>> &ratings, int threads);
+
+private:
+	// The test ratings of a user, as (item, rating).
+	typedef vector<pair<int, double>> UserRatings;
+
+	// Training state of a fold which all of its users share.
+	template <typename T>
+	struct Fold {
+		RatingMatrix<T> train;
+		RatingIndex index;
+		vector<uint64_t> ratedOffsets;
+		vector<int32_t> ratedItemsList;
+		RatedItems ratedItems;
+		// The mean centered norms of the rows.
+		vector<double> norms;
+		vector<double> colMeans;
+		double mean;
+	};
+
+	// Errors and hits of the test ratings of one user.
+	struct UserResult {
+		double squaredError;
+		double absoluteError;
+		int predictions;
+		double precision;
+		double recall;
+		bool relevant;
+
+		UserResult() : squaredError(0), absoluteError(0), predictions(0), precision(0), recall(0), relevant(false) {};
+	};
+
+	Recommender &recommender;
+	EvaluationOptions options;
+
+	vector<int> getFolds(const vector<vector<double>> &ratings, int &folds) const;
+	template <typename T> void buildFold(const vector<vector<double>> &trainRows, int threads, Fold<T> &fold);
+	template <typename T> Recommender::Neighbourhood getNeighbourhood(const Fold<T> &fold, int rowIndex, double normA);
+	template <typename T> void predictRatings(const Fold<T> &fold, int rowIndex, const UserRatings &test, UserResult &result);
+	template <typename T> void predictTopCF(const Fold<T> &fold, int rowIndex, const UserRatings &test, UserResult &result);
+};
+
+#endif
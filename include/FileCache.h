@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The documents of a file, one per line, with their words as tfidf reads them.
+struct ParsedFile {
+	vector<string> lines;
+	vector<vector<string>> words;
+};
+
+// Process wide LRU cache of the document files tfidf is called with, bounded
+// by an estimate of the bytes it holds and, like the ResultCache, counted
+// against the MemoryBudget. Entries are keyed on the path and the
+// stop words setting, and are only returned while the file has the device,
+// inode, size and modification time it had when it was read, so a changed
+// file is read again.
+class FileCache {
+public:
+	static FileCache& getInstance();
+
+	FileCache();
+
+	void setBudget(size_t budget);
+	// The parsed file at path, which is read when it is not cached or has
+	// changed since. Returns NULL if the file can't be read.
+	shared_ptr<const ParsedFile> get(const string &path, bool useStopWords);
+	void clear();
+	void resetCounters();
+
+	size_t getBudget();
+	size_t getBytes();
+	size_t getEntries();
+	size_t getHits();
+	size_t getMisses();
+
+private:
+	struct Entry {
+		string key;
+		string fileKey;
+		shared_ptr<const ParsedFile> file;
+		size_t bytes;
+	};
+
+	mutex lock;
+	list<Entry> entries;
+	unordered_map<string, list<Entry>::iterator> index;
+	size_t budget;
+	size_t bytes;
+	size_t hits;
+	size_t misses;
+
+	void put(const string &key, const string &fileKey, const shared_ptr<const ParsedFile> &file, size_t fileBytes);
+	void evict(size_t budget);
+	size_t shrink(size_t bytes);
+	bool reserve(size_t entryBytes);
+	void removeLast();
+};
+
+#endif
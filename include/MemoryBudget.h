@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+// Process wide budget of the bytes models and caches hold on the heap. A model
+// reserves an estimate of its bytes before it is built and settles on the bytes
+// it holds once it is, so a model which doesn't fit fails before it allocates
+// instead of getting the process killed. Caches reserve every entry they keep,
+// and when a model doesn't fit their oldest entries are evicted to make room
+// for it. Models mapped from files are not counted, since their pages belong
+// to the file and the kernel can drop them. A limit of 0 is no limit.
+class MemoryBudget {
+public:
+	enum Component { MODELS = 0, RESULT_CACHE = 1, FILE_CACHE = 2, COMPONENTS_SIZE = 3 };
+
+	static MemoryBudget& getInstance();
+	static const char *getComponentName(Component component);
+
+	MemoryBudget() : limit(0), bytes(0), componentBytes() {};
+
+	void setLimit(size_t limit);
+	size_t getLimit();
+	size_t getBytes();
+	size_t getBytes(Component component);
+
+	// Reserves the bytes, or returns false if they don't fit in the limit. The
+	// bytes of models are made room for by evicting caches, those of caches
+	// only fit in what is left.
+	bool reserve(size_t bytes, Component component = MODELS);
+	void release(size_t bytes, Component component = MODELS);
+
+	// Adds a function which evicts the oldest entries of a cache until it
+	// released at least the bytes or is empty, and returns the bytes it
+	// released. It is called without the lock of the budget held.
+	void addEvictor(function<size_t(size_t)> evictor);
+
+private:
+	mutex lock;
+	size_t limit;
+	size_t bytes;
+	size_t componentBytes[COMPONENTS_SIZE];
+	vector<function<size_t(size_t)>> evictors;
+
+	bool tryReserve(size_t bytes, Component component);
+	size_t getShortage(size_t bytes);
+	void evict(size_t bytes);
+};
+
+// Bytes of a model reserved in the budget for as long as the model lives.
+class MemoryReservation {
+public:
+	MemoryReservation() : bytes(0) {};
+	MemoryReservation(const MemoryReservation &) = delete;
+	MemoryReservation &operator=(const MemoryReservation &) = delete;
+
+	~MemoryReservation() {
+		MemoryBudget::getInstance().release(this->bytes);
+	}
+
+	// Changes the reservation to the bytes. Shrinking always succeeds, and
+	// growing returns false, keeping the old reservation, if the difference
+	// doesn't fit.
+	bool resize(size_t bytes);
+
+	size_t getBytes() const {
+		return this->bytes;
+	}
+
+private:
+	size_t bytes;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+
+#ifndef MODEL_IMAGE_H
+#define MODEL_IMAGE_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+// Read-only bytes of a model: built in memory, or a file mapped into the
+// address space. A model keeps its arrays in the image and reads them in
+// place, so a model loaded from a file is never copied: every process which
+// maps the same file shares its pages, and every thread of a process shares
+// one mapping. Copies of an image share the bytes.
+class ModelImage {
+public:
+	ModelImage() : data(NULL), size(0), heapBytes(0) {};
+
+	static ModelImage fromBytes(vector<char> &bytes);
+	// Maps the file at path, or returns an empty image when it can't be read.
+	// Opening the same unchanged file again returns the mapping which is
+	// already open.
+	static ModelImage open(const string &path);
+
+	bool write(const string &path) const;
+
+	const char *getData() const {
+		return this->data;
+	}
+	size_t getSize() const {
+		return this->size;
+	}
+	// The bytes the image holds on the heap, which are 0 for a mapped file.
+	size_t getHeapBytes() const {
+		return this->heapBytes;
+	}
+
+	// The count values of type T at offset, or NULL when they don't fit in
+	// the image or are misaligned.
+	template <typename T>
+	const T *get(uint64_t offset, uint64_t count) const {
+		if (offset > this->size || offset % alignof(T) != 0) return NULL;
+		if (count > (this->size - offset) / sizeof(T)) return NULL;
+		return reinterpret_cast<const T *>(this->data + offset);
+	}
+
+private:
+	shared_ptr<const void> owner;
+	const char *data;
+	size_t size;
+	size_t heapBytes;
+};
+
+// The bytes of a model, in total and by component, such as the postings of a
+// corpus. Components count the arrays a model reads, wherever they are, while
+// heapBytes are the bytes the process holds for the model, which it doesn't
+// share with others, and mappedBytes those of a mapped file, which every
+// process that maps it shares and the kernel can drop and read again.
+struct MemoryUsage {
+	size_t heapBytes;
+	size_t mappedBytes;
+	map<string, size_t> components;
+
+	MemoryUsage() : heapBytes(0), mappedBytes(0) {};
+
+	void add(const string &component, size_t bytes) {
+		this->components[component] += bytes;
+	}
+};
+
+// Start of a model file. Files are read in place, so they only load on
+// machines with the byte order they were saved on, and with the version of the
+// layout they were saved with.
+struct ImageHeader {
+	static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+	static const uint32_t CURRENT_VERSION = 4;
+
+	char magic[8];
+	uint32_t byteOrderMark;
+	uint32_t version;
+
+	void init(const char *magic) {
+		memset(this->magic, 0, sizeof(this->magic));
+		memcpy(this->magic, magic, min(strlen(magic), sizeof(this->magic)));
+		this->byteOrderMark = BYTE_ORDER_MARK;
+		this->version = CURRENT_VERSION;
+	}
+
+	bool isValid(const char *magic) const {
+		return strncmp(this->magic, magic, sizeof(this->magic)) == 0 && this->byteOrderMark == BYTE_ORDER_MARK &&
+			this->version == CURRENT_VERSION;
+	}
+};
+
+// Builds an image out of arrays of plain values. Every array starts at a
+// multiple of 8 bytes, so it can be read in place from a mapped file.
+class ImageWriter {
+public:
+	template <typename T>
+	uint64_t add(const T *values, size_t count) {
+		uint64_t offset = this->reserve(count * sizeof(T));
+		if (count) memcpy(this->bytes.data() + offset, values, count * sizeof(T));
+		return offset;
+	}
+
+	template <typename T>
+	uint64_t add(const vector<T> &values) {
+		return this->add(values.data(), values.size());
+	}
+
+	// Appends the bytes of another image, which must have been built with
+	// offsets relative to its start.
+	uint64_t append(const vector<char> &section) {
+		return this->add(section.data(), section.size());
+	}
+
+	uint64_t reserve(size_t size) {
+		uint64_t offset = (this->bytes.size() + 7) & ~(uint64_t)7;
+		this->bytes.resize(offset + size, 0);
+		return offset;
+	}
+
+	template <typename T>
+	T *at(uint64_t offset) {
+		return reinterpret_cast<T *>(this->bytes.data() + offset);
+	}
+
+	vector<char> &getBytes() {
+		return this->bytes;
+	}
+
+private:
+	vector<char> bytes;
+};
+
+// Sorted strings of an image, such as the terms of a corpus, looked up by
+// binary search. Strings are ordered as std::string orders them.
+class StringTable {
+public:
+	StringTable() : size(0), offsets(NULL), chars(NULL) {};
+
+	// Writes the strings, which must be sorted, and returns the offset of the
+	// table.
+	static uint64_t write(ImageWriter &writer, const vector<string> &strings);
+	// Attaches to the table at offset. Returns false if it doesn't fit in the
+	// image.
+	bool read(const ModelImage &image, uint64_t offset);
+
+	int getSize() const {
+		return this->size;
+	}
+	// The bytes of the offsets and characters in the image.
+	size_t getBytes() const {
+		if (!this->offsets) return 0;
+		return (this->size + 1) * sizeof(uint64_t) + this->offsets[this->size];
+	}
+	string get(int index) const {
+		return string(this->chars + this->offsets[index], this->offsets[index + 1] - this->offsets[index]);
+	}
+
+	// The index of the string, or -1 when it is not in the table.
+	int find(const string &value) const;
+
+private:
+	int size;
+	const uint64_t *offsets;
+	const char *chars;
+};
+
+#endif
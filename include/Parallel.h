@@ -0,0 +1,19 @@
+#pragma once
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+using namespace std;
+
+// Calls body(i) for every i in [begin, end) on up to threads threads, the
+// calling one included. The other threads are those of the WorkerPool, so all
+// calls together never use more threads than the pool has, and they keep
+// their arenas warm between calls. Indexes are handed out one at a time, so
+// uneven work per index is balanced. A call made from inside a body runs on
+// its thread only. The first exception a body throws stops handing out
+// indexes and is rethrown here once all calls have returned.
+void parallelFor(int begin, int end, int threads, const function<void(int)> &body);
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace std;
+
+// A block of up to BLOCK_SIZE postings of a term. The documents are stored as
+// the gaps to the previous document minus one, and the counts minus one, each
+// bit packed with the width of its largest value. lastDocument is the skip
+// pointer: a search for a later document steps over the block without
+// decoding it.
+struct PostingBlock {
+	int32_t lastDocument;
+	uint8_t documentBits;
+	uint8_t countBits;
+	uint16_t size;
+	// Offset of the packed documents, followed by the packed counts, in the
+	// words of all blocks.
+	uint64_t offset;
+};
+
+// Delta encoded, bit packed posting lists. A block packs its 128 values in 4
+// interleaved lanes of 32 values, so every step of the decoder shifts 4
+// consecutive words by the same amount, which is one SSE2 or NEON instruction.
+// Machines without them decode the same words one lane at a time.
+class PostingList {
+public:
+	static const int BLOCK_SIZE = 128;
+
+	// Appends the blocks of the postings, whose documents must be ascending,
+	// and their packed values.
+	static void encode(const vector<int32_t> &documents, const vector<int32_t> &counts, vector<PostingBlock> &blocks,
+		vector<uint32_t> &words);
+
+	// The number of words BLOCK_SIZE values of the width take.
+	static int getPackedSize(int bits) {
+		return bits * BLOCK_SIZE / 32;
+	}
+
+	static void pack(const uint32_t *values, int bits, uint32_t *packed);
+	static void unpack(const uint32_t *packed, int bits, uint32_t *values);
+};
+
+// Reads the postings of a term in document order, one block at a time.
+class PostingCursor {
+public:
+	PostingCursor() : begin(NULL), block(NULL), end(NULL), words(NULL), position(0), size(0) {};
+	PostingCursor(const PostingBlock *begin, const PostingBlock *end, const uint32_t *words);
+
+	bool isDone() const {
+		return this->position == this->size;
+	}
+	int32_t getDocument() const {
+		return this->documents[this->position];
+	}
+	int32_t getCount() const {
+		return this->counts[this->position];
+	}
+
+	void next() {
+		if (++this->position == this->size && ++this->block != this->end) this->decode();
+	}
+
+	// Moves to the first posting of target or a later document. Blocks which
+	// end before target are skipped without decoding them.
+	void advance(int32_t target);
+
+private:
+	void decode();
+
+	const PostingBlock *begin;
+	const PostingBlock *block;
+	const PostingBlock *end;
+	const uint32_t *words;
+	int position;
+	int size;
+	int32_t documents[PostingList::BLOCK_SIZE];
+	int32_t counts[PostingList::BLOCK_SIZE];
+};
+
+#endif
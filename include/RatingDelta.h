@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef RATING_DELTA_H
+#define RATING_DELTA_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+// Ratings of rows by id, as item to rating. A rating of 0 removes the rating
+// the row has.
+typedef map<int, map<int, double>> DeltaRows;
+
+// Ratings added to a model since it was built, which queries read alongside
+// the model until they are merged into a new version of it, so a write only
+// touches a small map under a lock. Readers share a copy of the ratings which
+// the first read after a write makes, so reads between writes don't copy.
+//
+// A merge takes the pending ratings, which are still read until it finishes,
+// and are put back under the ones added since if it couldn't publish.
+class RatingDelta {
+public:
+	RatingDelta() : pendingSize(0), mergingSize(0), running(false), generation(0), mergeGeneration(0) {};
+
+	void set(int id, int item, double rating);
+	// Drops all ratings, for a model whose ratings were replaced. A merge which
+	// is running doesn't put its ratings back.
+	void clear();
+	// The merging and pending ratings, the pending ones taking precedence.
+	shared_ptr<const DeltaRows> get();
+
+	// Takes the pending ratings for a merge. Returns false if a merge is
+	// running or nothing is pending.
+	bool startMerge(shared_ptr<const DeltaRows> &rows);
+	void finishMerge(bool merged);
+
+	// The number of pending ratings.
+	size_t size();
+	bool isMerging();
+	size_t getBytes();
+
+private:
+	mutex lock;
+	DeltaRows pending;
+	size_t pendingSize;
+	shared_ptr<const DeltaRows> merging;
+	size_t mergingSize;
+	shared_ptr<const DeltaRows> view;
+	bool running;
+	uint64_t generation;
+	uint64_t mergeGeneration;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef RATING_INDEX_H
+#define RATING_INDEX_H
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include "RatingMatrix.h"
+
+using namespace std;
+
+// Inverted index of a rating matrix: for every item (column) the rows which
+// rated it, in ascending order. Stored as one array of rows with an offset per
+// item, so the postings of an item are contiguous.
+class RatingIndex {
+public:
+	RatingIndex() {};
+
+	template <typename T>
+	static RatingIndex build(const RatingMatrix<T> &ratings) {
+		RatingIndex index;
+		int rows = ratings.getRows();
+		int cols = ratings.getCols();
+		index.offsets.assign(cols + 1, 0);
+		for (int i = 0; i < rows; i++) {
+			const T *row = ratings.getRow(i);
+			for (int j = 0; j < cols; j++) {
+				if (row[j] != 0) index.offsets[j + 1]++;
+			}
+		}
+		for (int j = 0; j < cols; j++) index.offsets[j + 1] += index.offsets[j];
+
+		index.rows.resize(index.offsets[cols]);
+		vector<int> next(index.offsets.begin(), index.offsets.end() - 1);
+		for (int i = 0; i < rows; i++) {
+			const T *row = ratings.getRow(i);
+			for (int j = 0; j < cols; j++) {
+				if (row[j] != 0) index.rows[next[j]++] = i;
+			}
+		}
+
+		return index;
+	}
+
+	int getItems() const {
+		return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+	}
+
+	const int *getRows(int item) const {
+		return this->rows.data() + this->offsets[item];
+	}
+
+	int getRowsSize(int item) const {
+		return this->offsets[item + 1] - this->offsets[item];
+	}
+
+	size_t getBytes() const {
+		return (this->offsets.size() + this->rows.size()) * sizeof(int);
+	}
+
+private:
+	vector<int> offsets;
+	vector<int> rows;
+};
+
+// The items every row of a rating matrix rated, in ascending order, as one
+// array of items with an offset per row, so the ratings of a row can be
+// walked without reading its unrated cells. Points to arrays owned by someone
+// else, such as a model image or the vectors build() fills.
+class RatedItems {
+public:
+	RatedItems() : offsets(NULL), items(NULL) {};
+	RatedItems(const uint64_t *offsets, const int32_t *items) : offsets(offsets), items(items) {};
+
+	template <typename T>
+	static RatedItems build(const RatingMatrix<T> &ratings, vector<uint64_t> &offsets, vector<int32_t> &items) {
+		int rows = ratings.getRows();
+		int cols = ratings.getCols();
+		offsets.assign(1, 0);
+		offsets.reserve(rows + 1);
+		items.clear();
+		for (int i = 0; i < rows; i++) {
+			const T *row = ratings.getRow(i);
+			for (int j = 0; j < cols; j++) {
+				if (row[j] != 0) items.push_back(j);
+			}
+			offsets.push_back(items.size());
+		}
+
+		return RatedItems(offsets.data(), items.data());
+	}
+
+	const int32_t *begin(int row) const {
+		return this->items + this->offsets[row];
+	}
+
+	const int32_t *end(int row) const {
+		return this->items + this->offsets[row + 1];
+	}
+
+private:
+	const uint64_t *offsets;
+	const int32_t *items;
+};
+
+// The items of a rating matrix sorted by their bias, the difference of their
+// mean rating to the mean of all ratings, highest first and items with the
+// same bias by id. The bias of an item nobody rated is 0. Since the bias of a
+// user is the same for every item, the global baseline of a user is highest
+// at one of the two ends of the items and falls towards the other.
+class ItemBiasIndex {
+public:
+	ItemBiasIndex() : mean(NAN) {};
+
+	static ItemBiasIndex build(const double *colMeans, int cols, double mean) {
+		ItemBiasIndex index;
+		index.mean = mean;
+		index.items.reserve(cols);
+		for (int i = 0; i < cols; i++) index.items.push_back(make_pair(i, isnan(colMeans[i]) ? 0 : colMeans[i] - mean));
+		sort(index.items.begin(), index.items.end(), [](const pair<int, double> &a, const pair<int, double> &b) {
+			return a.second > b.second || (a.second == b.second && a.first < b.first);
+		});
+
+		return index;
+	}
+
+	double getMean() const {
+		return this->mean;
+	}
+
+	// The items with their biases, as (item, bias).
+	const vector<pair<int, double>> &getItems() const {
+		return this->items;
+	}
+
+	size_t getBytes() const {
+		return this->items.capacity() * sizeof(pair<int, double>);
+	}
+
+private:
+	double mean;
+	vector<pair<int, double>> items;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#pragma once
+
+#ifndef RATING_MATRIX_H
+#define RATING_MATRIX_H
+
+#include <vector>
+#include <string>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "StorageTraits.h"
+#include "Utils.h"
+
+using namespace std;
+
+// Finds the uint8 step for a set of ratings. Ratings which are all multiples of
+// 1, 1/2 or 1/4 (integer, half or quarter star scales) and fit in 255 steps are
+// stored exactly, since those steps are powers of two. Otherwise the range is
+// split into 255 steps.
+class RatingQuantizer {
+public:
+	RatingQuantizer() : max(0), hasInvalid(false) {
+		for (int i = 0; i < DENOMINATORS_SIZE; i++) this->fits[i] = true;
+	}
+
+	void observe(double value) {
+		if (value == 0) return;
+		if (value < 0 || isnan(value)) this->hasInvalid = true;
+		if (value > this->max) this->max = value;
+		for (int i = 0; i < DENOMINATORS_SIZE; i++) {
+			if (!this->fits[i]) continue;
+			double scaled = value * RatingQuantizer::getDenominator(i);
+			this->fits[i] = scaled == floor(scaled) && scaled <= 255;
+		}
+	}
+
+	bool isValid() const {
+		return !this->hasInvalid;
+	}
+
+	bool isExact() const {
+		for (int i = 0; i < DENOMINATORS_SIZE; i++) {
+			if (this->fits[i]) return true;
+		}
+
+		return this->max == 0;
+	}
+
+	double getScale() const {
+		for (int i = 0; i < DENOMINATORS_SIZE; i++) {
+			if (this->fits[i]) return 1.0 / RatingQuantizer::getDenominator(i);
+		}
+
+		return this->max > 0 ? this->max / 255 : 1;
+	}
+
+private:
+	static const int DENOMINATORS_SIZE = 3;
+
+	double max;
+	bool hasInvalid;
+	bool fits[DENOMINATORS_SIZE];
+
+	static double getDenominator(int index) {
+		static const double denominators[DENOMINATORS_SIZE] = { 1, 2, 4 };
+		return denominators[index];
+	}
+};
+
+// Dense row major ratings stored as T. A value of 0 means not rated, and
+// get() returns the dequantized value as a double. A matrix either owns its
+// values or is a view of values owned by someone else, such as a model image,
+// which must outlive it.
+template <typename T>
+class RatingMatrix {
+public:
+	RatingMatrix() : external(NULL), rows(0), cols(0), scale(1), exact(true) {};
+
+	RatingMatrix(int rows, int cols, double scale = 1, bool exact = true) :
+		values((size_t)rows * cols, 0),
+		external(NULL),
+		rows(rows),
+		cols(cols),
+		scale(scale),
+		exact(exact) {};
+
+	static RatingMatrix<T> view(const T *values, int rows, int cols, double scale = 1, bool exact = true) {
+		RatingMatrix<T> matrix(0, 0, scale, exact);
+		matrix.external = values;
+		matrix.rows = rows;
+		matrix.cols = cols;
+		return matrix;
+	}
+
+	// Rows shorter than the longest one are padded with zeros.
+	static RatingMatrix<T> fromRows(const vector<vector<double>> &ratings) {
+		int rows = ratings.size();
+		int cols = 0;
+		RatingQuantizer quantizer;
+		for (int i = 0; i < rows; i++) {
+			int rowSize = ratings[i].size();
+			if (rowSize > cols) cols = rowSize;
+			for (int j = 0; j < rowSize; j++) quantizer.observe(ratings[i][j]);
+		}
+
+		RatingMatrix<T> matrix = RatingMatrix<T>::create(rows, cols, quantizer);
+		for (int i = 0; i < rows; i++) {
+			int rowSize = ratings[i].size();
+			for (int j = 0; j < rowSize; j++) matrix.set(i, j, ratings[i][j]);
+		}
+
+		return matrix;
+	}
+
+	static RatingMatrix<T> create(int rows, int cols, const RatingQuantizer &quantizer);
+
+	int getRows() const { return this->rows; }
+	int getCols() const { return this->cols; }
+	double getScale() const { return this->scale; }
+	bool isExact() const { return this->exact; }
+	size_t getBytes() const { return (size_t)this->rows * this->cols * sizeof(T); }
+
+	const T *getValues() const {
+		return this->external ? this->external : this->values.data();
+	}
+
+	const T *getRow(int row) const {
+		return this->getValues() + (size_t)row * this->cols;
+	}
+
+	double get(int row, int col) const {
+		return this->getValues()[(size_t)row * this->cols + col] * this->scale;
+	}
+
+	void set(int row, int col, double value);
+
+	double getMean() const {
+		double sum = 0;
+		double counter = 0;
+		const T *values = this->getValues();
+		size_t valuesSize = (size_t)this->rows * this->cols;
+		for (size_t i = 0; i < valuesSize; i++) {
+			if (values[i] == 0) continue;
+			sum += values[i] * this->scale;
+			counter++;
+		}
+
+		return sum / counter;
+	}
+
+	double getRowMean(int row) const {
+		return Utils::getRawMean(this->getRow(row), this->cols, this->scale);
+	}
+
+	double getColMean(int col) const {
+		double sum = 0;
+		double counter = 0;
+		const T *values = this->getValues();
+		for (int i = 0; i < this->rows; i++) {
+			T value = values[(size_t)i * this->cols + col];
+			if (value == 0) continue;
+			sum += value * this->scale;
+			counter++;
+		}
+
+		return sum / counter;
+	}
+
+	uint64_t getVersion() const {
+		const char *storageName = StorageTraits<T>::getName();
+		uint64_t seed = Utils::hashBytes(storageName, strlen(storageName), this->rows);
+		seed = Utils::hashBytes(&this->scale, sizeof(double), seed ^ this->cols);
+		return Utils::hashBytes(this->getValues(), this->getBytes(), seed);
+	}
+
+	bool equals(const RatingMatrix<T> &other) const {
+		return this->rows == other.rows && this->cols == other.cols && this->scale == other.scale &&
+			memcmp(this->getValues(), other.getValues(), this->getBytes()) == 0;
+	}
+
+private:
+	vector<T> values;
+	const T *external;
+	int rows;
+	int cols;
+	double scale;
+	bool exact;
+};
+
+template <typename T>
+RatingMatrix<T> RatingMatrix<T>::create(int rows, int cols, const RatingQuantizer &quantizer) {
+	return RatingMatrix<T>(rows, cols);
+}
+
+template <>
+inline RatingMatrix<uint8_t> RatingMatrix<uint8_t>::create(int rows, int cols, const RatingQuantizer &quantizer) {
+	return RatingMatrix<uint8_t>(rows, cols, quantizer.getScale(), quantizer.isExact());
+}
+
+template <typename T>
+void RatingMatrix<T>::set(int row, int col, double value) {
+	T stored = (T)value;
+	if (stored != value) this->exact = false;
+	this->values[(size_t)row * this->cols + col] = stored;
+}
+
+template <>
+inline void RatingMatrix<uint8_t>::set(int row, int col, double value) {
+	long step = lround(value / this->scale);
+	if (step < 1 && value > 0) step = 1;
+	if (step > 255) step = 255;
+	if (step < 0) step = 0;
+	this->values[(size_t)row * this->cols + col] = (uint8_t)step;
+}
+
+#endif
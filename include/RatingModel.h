@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef RATING_MODEL_H
+#define RATING_MODEL_H
+
+#include <vector>
+#include <map>
+#include <math.h>
+#include <stdint.h>
+#include "ModelImage.h"
+#include "RatingMatrix.h"
+#include "RatingIndex.h"
+#include "RatingDelta.h"
+#include "recommender.h"
+
+using namespace std;
+
+// Sums and counts of the ratings, overall and per item, which the means of the
+// global baseline are computed from. The stats of all shards of a rating table
+// are merged, so every shard sees the same means.
+struct RatingStats {
+	double sum;
+	double count;
+	vector<double> colSums;
+	vector<double> colCounts;
+
+	RatingStats() : sum(0), count(0) {};
+
+	void add(const double *row, int cols);
+	void merge(const RatingStats &other);
+
+	double getMean() const {
+		return this->sum / this->count;
+	}
+
+	double getColMean(int col) const {
+		if (col >= (int)this->colSums.size()) return NAN;
+		return this->colSums[col] / this->colCounts[col];
+	}
+};
+
+// Rows of a rating table with their global ids, such as the users of one
+// shard, kept as a section of a model image which is read in place. The sums
+// of a neighbourhood are computed over these rows for a row which may be in
+// another shard, so the sums of all shards can be added up.
+class RatingModel {
+public:
+	RatingModel() : sum(0), count(0), colSums(NULL), colCounts(NULL), rowIds(NULL), ratedItemsSize(0) {};
+
+	// Builds the section of the rows with their ids. Rows shorter than cols
+	// are padded with zeros.
+	static vector<char> build(const vector<const vector<double> *> &rows, const vector<int> &ids, int cols);
+	// Attaches to the section at offset. Returns false if it doesn't fit in
+	// the image.
+	bool read(const ModelImage &image, uint64_t offset);
+
+	int size() const {
+		return this->ratings.getRows();
+	}
+	int getCols() const {
+		return this->ratings.getCols();
+	}
+	uint64_t getRatedSize() const {
+		return this->ratedItemsSize;
+	}
+	RatingStats getStats() const;
+	// Adds the bytes of the ratings, the row index, which includes the rated
+	// items of every row, and the stats.
+	void addMemoryUsage(MemoryUsage &usage) const;
+
+	// The row with the id, or NULL when it is not in this model.
+	const double *getRow(int id) const;
+	// Appends the rows, padded to cols, with the ratings of the delta for
+	// their ids applied, and their ids.
+	void copyRows(const DeltaRows &delta, int cols, vector<vector<double>> &rows, vector<int> &ids) const;
+	int getTopCFSums(Recommender &recommender, const double *row, int id, vector<double> &ratingsSums, double &similaritiesSum,
+		double *ratersCounts = NULL) const;
+	int getRatingPredictionSums(Recommender &recommender, const double *row, int id, int colIndex, double &ratingsSum, double &similaritiesSum) const;
+
+private:
+	struct RowId {
+		int32_t id;
+		int32_t row;
+	};
+
+	struct Header {
+		int32_t rows;
+		int32_t cols;
+		double sum;
+		double count;
+		uint64_t values;
+		uint64_t colSums;
+		uint64_t colCounts;
+		uint64_t rowIds;
+		uint64_t ratedOffsets;
+		uint64_t ratedItems;
+	};
+
+	RatingMatrix<double> ratings;
+	double sum;
+	double count;
+	const double *colSums;
+	const double *colCounts;
+	// Sorted by id.
+	const RowId *rowIds;
+	RatedItems ratedItems;
+	uint64_t ratedItemsSize;
+
+	int getRowIndex(int id) const;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Process wide LRU cache of ranked results, bounded by an estimate of the bytes
+// it holds rather than by the number of entries. Its entries also count against
+// the MemoryBudget, which evicts them to make room for models. Keys contain the
+// version of the model a result was computed from, so results of an old version
+// are never returned and simply age out.
+class ResultCache {
+public:
+	static ResultCache& getInstance();
+
+	ResultCache();
+
+	void setBudget(size_t budget);
+	bool isEnabled();
+	bool get(const string &key, vector<pair<int, double>> &result);
+	void put(const string &key, const vector<pair<int, double>> &result);
+	void clear();
+	void resetCounters();
+
+	size_t getBudget();
+	size_t getBytes();
+	size_t getEntries();
+	size_t getHits();
+	size_t getMisses();
+
+private:
+	struct Entry {
+		string key;
+		vector<pair<int, double>> result;
+		size_t bytes;
+	};
+
+	mutex lock;
+	list<Entry> entries;
+	unordered_map<string, list<Entry>::iterator> index;
+	size_t budget;
+	size_t bytes;
+	size_t hits;
+	size_t misses;
+
+	void evict(size_t budget);
+	size_t shrink(size_t bytes);
+	bool reserve(size_t entryBytes);
+	void removeLast();
+};
+
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef SHARDING_H
+#define SHARDING_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "ModelImage.h"
+#include "MemoryBudget.h"
+#include "Corpus.h"
+#include "RatingModel.h"
+#include "recommender.h"
+
+using namespace std;
+
+// How ids are spread over shards: in contiguous ranges in the order they are
+// given, or by a hash of the id.
+enum ShardPartition { PARTITION_RANGE, PARTITION_HASH };
+
+int getShardIndex(int id, int position, int size, int shards, ShardPartition partition);
+
+// A corpus split into shards which are searched in parallel, by the calling
+// thread and helpers on the WorkerPool, so queries never start threads of
+// their own. Every shard scores with the idf of the whole corpus and returns
+// its best documents, which are merged into the best of all. A process may
+// hold part of a larger corpus, with the ids of its documents in it: the stats
+// of all processes are merged and passed to search, and the hits of all
+// processes merged with mergeHits.
+//
+// The whole corpus is one model image, which can be saved to a file and
+// loaded by mapping the file, so processes which load the same file share it.
+// A corpus which doesn't fit in the MemoryBudget is left invalid.
+class ShardedCorpus {
+public:
+	ShardedCorpus(const vector<string> &documents, const vector<int> &ids, int shards, ShardPartition partition, bool useStopWords);
+	// Loads a corpus from an image. Check isValid() before using it.
+	explicit ShardedCorpus(const ModelImage &image);
+
+	bool isValid() const {
+		return !this->shards.empty();
+	}
+	bool save(const string &path) const {
+		return this->image.write(path);
+	}
+	int getShardsSize() const {
+		return this->shards.size();
+	}
+	CorpusStats getStats() const;
+	MemoryUsage getMemoryUsage() const;
+
+	vector<pair<int, double>> search(const string &query, int limit, int threads, const CorpusStats *stats = NULL,
+		CorpusScoring scoring = SCORING_TFIDF) const;
+
+	static vector<pair<int, double>> mergeHits(const vector<vector<pair<int, double>>> &hits, int limit);
+
+private:
+	struct Header {
+		ImageHeader image;
+		int32_t shards;
+		int32_t documents;
+		int32_t useStopWords;
+		int32_t reserved;
+		double words;
+		uint64_t terms;
+		uint64_t documentFrequencies;
+		uint64_t shardOffsets;
+	};
+
+	ModelImage image;
+	MemoryReservation reservation;
+	vector<Corpus> shards;
+	int documents;
+	double words;
+	bool useStopWords;
+	StringTable terms;
+	const int32_t *documentFrequencies;
+
+	void read();
+	void reserve();
+	int getDocumentFrequency(const string &term, const CorpusStats *stats) const;
+};
+
+// A rating table whose rows are split into shards. The neighbourhood sums of a
+// row are computed by all shards in parallel and added up in shard order, and
+// the global baseline uses the merged stats of all shards. With one shard the
+// results are the same as those of Recommender, with more they can differ in
+// the last digits, since the sums are added in another order.
+//
+// Like ShardedCorpus, the whole table is one model image which can be saved to
+// a file and loaded by mapping the file, and it is left invalid if it doesn't
+// fit in the MemoryBudget.
+//
+// The queries take the ratings of a RatingDelta which were added since the
+// model was built. The rows of their ids replace those of the model, and the
+// means of the global baseline stay those of the model until the ratings are
+// merged into a new one.
+class ShardedRatingModel {
+public:
+	ShardedRatingModel(const vector<vector<double>> &rows, const vector<int> &ids, int shards, ShardPartition partition);
+	// Loads a rating table from an image. Check isValid() before using it.
+	explicit ShardedRatingModel(const ModelImage &image);
+	// Builds the model with the ratings of the delta merged in.
+	ShardedRatingModel(const ShardedRatingModel &model, const DeltaRows &delta);
+
+	bool isValid() const {
+		return !this->shards.empty();
+	}
+	bool save(const string &path) const {
+		return this->image.write(path);
+	}
+	int getShardsSize() const {
+		return this->shards.size();
+	}
+	int getCols() const {
+		return this->cols;
+	}
+	const RatingStats &getStats() const {
+		return this->stats;
+	}
+	MemoryUsage getMemoryUsage() const;
+
+	const double *getRow(int id) const;
+	vector<pair<int, double>> getTopCFRecommendations(const Recommender &recommender, int id, int limit, int includeRatedItems, int threads,
+		const DeltaRows *delta = NULL) const;
+	vector<pair<int, double>> getHybridRecommendations(const Recommender &recommender, int id, int limit, int includeRatedItems, int shrinkage,
+		int threads, const DeltaRows *delta = NULL) const;
+	double getRatingPrediction(const Recommender &recommender, int id, int colIndex, int threads, const DeltaRows *delta = NULL) const;
+	double getGlobalBaselineRatingPrediction(int id, int colIndex, const DeltaRows *delta = NULL) const;
+	// The items with the highest global baseline for the id, which gets those
+	// of a user without ratings when it is not in the model.
+	vector<pair<int, double>> getGlobalBaselineRecommendations(int id, int limit, int includeRatedItems, const DeltaRows *delta = NULL) const;
+
+private:
+	struct Header {
+		ImageHeader image;
+		int32_t shards;
+		int32_t cols;
+		uint64_t shardOffsets;
+	};
+
+	ModelImage image;
+	MemoryReservation reservation;
+	vector<RatingModel> shards;
+	RatingStats stats;
+	ItemBiasIndex itemBiases;
+	int cols;
+
+	void build(const vector<vector<const vector<double> *>> &shardRows, const vector<vector<int>> &shardIds, int cols);
+	void read();
+	void reserve();
+	bool getRow(int id, const DeltaRows *delta, vector<double> &row) const;
+	void getDeltaRows(const DeltaRows &delta, int id, RatingMatrix<double> &oldRows, RatingMatrix<double> &newRows) const;
+	int getTopCFSums(const Recommender &recommender, const double *row, int id, int threads, vector<double> &ratingsSums, double &similaritiesSum,
+		vector<double> *ratersCounts, const DeltaRows *delta) const;
+};
+
+#endif
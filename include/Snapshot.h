@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+using namespace std;
+
+// The current version of an immutable value, such as a model, which many
+// threads read while it is replaced as a whole. A reader takes the current
+// version and keeps it for as long as it needs, so publishing a new version
+// never waits for readers, and an old version is freed when its last reader
+// is done with it.
+//
+// Updates reserve a version number before they start building, and a value is
+// only published if no later update has been published already, so a slow
+// update can't replace the result of a newer one.
+template <typename T>
+class Snapshot {
+public:
+	explicit Snapshot(shared_ptr<const T> value) : value(value), version(1), nextVersion(2) {};
+
+	shared_ptr<const T> get() const {
+		lock_guard<mutex> guard(this->lock);
+		return this->value;
+	}
+
+	uint64_t getVersion() const {
+		lock_guard<mutex> guard(this->lock);
+		return this->version;
+	}
+
+	uint64_t reserve() {
+		lock_guard<mutex> guard(this->lock);
+		return this->nextVersion++;
+	}
+
+	// Returns false if a later version was published already.
+	bool publish(shared_ptr<const T> value, uint64_t version) {
+		// The old value is released after the lock, in case this was its
+		// last reference.
+		shared_ptr<const T> old = value;
+		{
+			lock_guard<mutex> guard(this->lock);
+			if (version < this->version) return false;
+			this->value.swap(old);
+			this->version = version;
+		}
+
+		return true;
+	}
+
+private:
+	mutable mutex lock;
+	shared_ptr<const T> value;
+	uint64_t version;
+	uint64_t nextVersion;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <stdint.h>
+#include "Trace.h"
+
+using namespace std;
+
+// Process wide timings per phase of a call and event counters. Recording is
+// off by default. While it is off a timer costs one relaxed atomic load, and
+// while it is on every record is a few relaxed atomic adds, so worker threads
+// never contend on a lock.
+class Stats {
+public:
+	enum Phase {
+		MARSHAL,
+		TOKENIZE,
+		TFIDF,
+		SIMILARITY,
+		SORT,
+		PREDICT,
+		CONVERT,
+		QUEUE_WAIT,
+		EXECUTE,
+		PHASES_SIZE
+	};
+
+	enum Counter {
+		BYTES_COPIED,
+		COALESCED,
+		CANCELLED,
+		ARENA_CHUNKS,
+		COUNTERS_SIZE
+	};
+
+	// Buckets have upper bounds of 1us, 4us, 16us ... 4s, and the last one
+	// holds everything slower.
+	static const int HISTOGRAM_SIZE = 13;
+
+	static Stats& getInstance();
+
+	Stats();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const {
+		return this->enabled.load(memory_order_relaxed);
+	}
+
+	void record(Phase phase, uint64_t nanoseconds);
+	void add(Counter counter, uint64_t value = 1);
+	void reset();
+
+	uint64_t getCalls(Phase phase) const;
+	uint64_t getTotalNanoseconds(Phase phase) const;
+	uint64_t getBucket(Phase phase, int bucket) const;
+	uint64_t getCounter(Counter counter) const;
+
+	static const char *getPhaseName(Phase phase);
+	static const char *getCounterName(Counter counter);
+	static uint64_t getBucketBound(int bucket);
+
+private:
+	atomic<bool> enabled;
+	atomic<uint64_t> calls[PHASES_SIZE];
+	atomic<uint64_t> totalNanoseconds[PHASES_SIZE];
+	atomic<uint64_t> histogram[PHASES_SIZE][HISTOGRAM_SIZE];
+	atomic<uint64_t> counters[COUNTERS_SIZE];
+};
+
+// Records the time from construction to destruction under a phase, and traces
+// it as a span named after the phase.
+class StatsTimer {
+public:
+	explicit StatsTimer(Stats::Phase phase) :
+		phase(phase),
+		enabled(Stats::getInstance().isEnabled()),
+		traced(Trace::getInstance().isEnabled()),
+		start(this->enabled || this->traced ? Trace::now() : 0) {}
+
+	~StatsTimer() {
+		if (!this->enabled && !this->traced) return;
+		uint64_t end = Trace::now();
+		if (this->enabled) Stats::getInstance().record(this->phase, end - this->start);
+		if (this->traced) Trace::getInstance().record(Stats::getPhaseName(this->phase), "phase", this->start, end);
+	}
+
+private:
+	Stats::Phase phase;
+	bool enabled;
+	bool traced;
+	uint64_t start;
+};
+
+#endif
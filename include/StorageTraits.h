@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef STORAGE_TRAITS_H
+#define STORAGE_TRAITS_H
+
+#include <limits.h>
+#include <stdint.h>
+
+// Per value type settings of the rating store and the similarity kernels.
+// Dot products are summed in blocks of BLOCK_SIZE in the narrow BlockAccumulator
+// type, so float and uint8 storage keep their SIMD lane width, and the blocks
+// are added up in Accumulator. Double storage uses a single block, which keeps
+// its results identical to a plain running sum.
+template <typename T> struct StorageTraits;
+
+template <> struct StorageTraits<double> {
+	typedef double BlockAccumulator;
+	typedef double Accumulator;
+	static const int BLOCK_SIZE = INT_MAX;
+	static const char *getName() { return "double"; }
+};
+
+template <> struct StorageTraits<float> {
+	typedef float BlockAccumulator;
+	typedef double Accumulator;
+	static const int BLOCK_SIZE = 256;
+	static const char *getName() { return "float32"; }
+};
+
+template <> struct StorageTraits<uint8_t> {
+	typedef uint32_t BlockAccumulator;
+	typedef uint64_t Accumulator;
+	static const int BLOCK_SIZE = 4096;
+	static const char *getName() { return "uint8"; }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+
+// Static probes for perf and bpftrace, built in wherever the systemtap headers
+// are installed. A probe is a nop until a tracer attaches to it, so they are
+// always compiled in, and RECOMMENDER_NO_USDT leaves them out.
+#if !defined(RECOMMENDER_NO_USDT) && defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RECOMMENDER_USDT 1
+#endif
+#endif
+
+#ifdef RECOMMENDER_USDT
+#define TRACE_PROBE(probe, name) DTRACE_PROBE1(recommender, probe, name)
+#else
+#define TRACE_PROBE(probe, name)
+#endif
+
+using namespace std;
+
+// Process wide trace of the spans of calls, written as Chrome trace_event JSON
+// which chrome://tracing and Perfetto open. Tracing is off by default, and while
+// it is off a span costs one relaxed atomic load. While it is on, spans are
+// buffered under a lock and written out in batches, so only the thread which
+// fills a batch waits for the file.
+class Trace {
+public:
+	static Trace& getInstance();
+
+	Trace();
+	// A trace which is still running when the process exits is stopped then.
+	~Trace() {
+		this->stop();
+	}
+
+	// Starts writing spans to the file at path, replacing it and any trace
+	// which is already running. Returns false if the file can't be created.
+	bool start(const string &path);
+	// Writes the buffered spans and closes the file. Returns false if they
+	// couldn't be written.
+	bool stop();
+
+	bool isEnabled() const {
+		return this->enabled.load(memory_order_relaxed);
+	}
+
+	// Adds a span of the category which started and ended at the times of
+	// now(). Spans which end after the trace stopped are dropped.
+	void record(const char *name, const char *category, uint64_t start, uint64_t end);
+
+	// Nanoseconds of a steady clock.
+	static uint64_t now();
+
+private:
+	struct Event {
+		const char *name;
+		const char *category;
+		uint64_t start;
+		uint64_t end;
+		int thread;
+	};
+
+	atomic<bool> enabled;
+	mutex lock;
+	FILE *file;
+	vector<Event> events;
+	uint64_t origin;
+	bool written;
+
+	bool flush();
+};
+
+// Traces the time from construction to destruction as a span, and fires the
+// span__start and span__done probes with its name.
+class TraceSpan {
+public:
+	explicit TraceSpan(const char *name, const char *category = "call") :
+		name(name),
+		category(category),
+		enabled(Trace::getInstance().isEnabled()),
+		start(this->enabled ? Trace::now() : 0) {
+		TRACE_PROBE(span__start, name);
+	}
+
+	~TraceSpan() {
+		TRACE_PROBE(span__done, this->name);
+		if (this->enabled) Trace::getInstance().record(this->name, this->category, this->start, Trace::now());
+	}
+
+private:
+	const char *name;
+	const char *category;
+	bool enabled;
+	uint64_t start;
+};
+
+#endif
@@ -5,14 +5,19 @@
 
 #pragma once
 #include <vector>
+#include <string>
+#include <stdint.h>
 #include "Utils.h"
 
 using namespace std;
 
 class Utils {
 public:
-	static double calculateDotProduct(const vector<double> &a, const vector<double> &b);
-	static double normalizeVector(const vector<double> &a);
+	template <typename Allocator> static double calculateDotProduct(const vector<double, Allocator> &a, const vector<double, Allocator> &b);
+	template <typename T> static double calculateDotProduct(const T *a, const T *b, int size);
+	template <typename T> static double getRawMean(const T *a, int size, double scale);
+	template <typename T> static double getCenteredNorm(const T *a, int size, double scale);
+	template <typename Allocator> static double normalizeVector(const vector<double, Allocator> &a);
 	static double calculateCosineSimilarity(const double &dotProduct, const double &normA, const double &normB);
 	static void subtractRawMeanFromVector(vector<double> &a);
 	static vector<double> getSubtractRawMeanFromVector(vector<double> &a);
@@ -20,6 +25,10 @@ public:
 	static double getMean(const vector<vector<double>> &ratings);
 	static double getRowMean(const vector<double> &userRatings);
 	static double getColMean(const vector<vector<double>> &ratings, int colIndex);
+	static uint64_t hashStrings(const vector<string> &strings, uint64_t seed = 0);
+	static uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+	static vector<string> splitLineToWords(const string &line, bool useStopWords);
+	static bool getFileKey(const string &path, string &key, size_t &size);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of threads that runs recommender jobs, so they do not compete with
+// fs, dns and crypto work in the libuv threadpool.
+class WorkerPool {
+public:
+	enum Priority { INTERACTIVE = 0, BATCH = 1 };
+
+	static WorkerPool& getInstance();
+
+	explicit WorkerPool(int size);
+	~WorkerPool();
+
+	void submit(function<void()> task, Priority priority);
+	// Queues a part of a job which is already running, such as the helper of a
+	// parallelFor. Those are taken before any job, so running jobs finish first.
+	void help(function<void()> task);
+	void resize(int size);
+	int size();
+	int pending();
+
+private:
+	mutex lock;
+	condition_variable available;
+	deque<function<void()>> queues[2];
+	deque<function<void()>> helpers;
+	vector<thread> threads;
+	// Threads which left after a shrink, joined by the next resize.
+	vector<thread> retired;
+	int activeThreads;
+	int threadsToRetire;
+	int consecutiveInteractive;
+	bool stopping;
+
+	void run();
+	void retire(thread::id id);
+	void joinRetired();
+	bool takeTask(function<void()> &task);
+};
+
+#endif
@@ -6,39 +6,106 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <memory>
+#include <functional>
+#include "CancellationToken.h"
+#include "RatingMatrix.h"
+#include "RatingIndex.h"
+#include "BinaryMatrix.h"
+#include "FileCache.h"
+#include "Arena.h"
 
 using namespace std;
 
 class Recommender {
+	friend class RecommenderBench;
+	friend class Evaluator;
+
 public:
 	vector<string> rawDocuments;
 	vector<string> document;
 	vector<vector<string>> documents;
+	// The documents file of tfidf, which is read instead of documents and
+	// rawDocuments when it is set.
+	shared_ptr<const ParsedFile> documentsFile;
 	map<string, double> weights;
+	shared_ptr<CancellationToken> cancellationToken;
+	// Rows which rated fewer items in common with the target row are not
+	// scored and count as neighbours with a similarity of 0.
+	int minCoRatings;
+
+	// Top CF recommendations of several rows, as (rowIndex, recommendations).
+	typedef vector<pair<int, vector<pair<int, double>>>> TopCFChunk;
+	// Similarities of other rows to a row, as (rowIndex, similarity). They are
+	// temporaries of a call and live in the arena of its thread.
+	typedef ScratchVector<pair<int, double>> Neighbourhood;
 
-	Recommender() {};
+	Recommender() : minCoRatings(1) {};
 
 	map<string, double> tfidf(string documentFilePath, string documentsFilePat, bool useStopWords);
 	map<string, double> tfidf(string query, vector<string> documents, bool useStopWords);
-	vector<double> recommend(map<string, double> weights);
-	vector<string> getSortedDocuments(vector<double> similarities);
+	vector<double> recommend(const map<string, double> &weights);
+	vector<string> getSortedDocuments(const vector<double> &similarities);
+	vector<int> getSortedDocumentIndexes(const vector<double> &similarities);
+	vector<string> recommendDocuments(string query, vector<string> documents, bool useStopWords);
 	double getRatingPrediction(vector<vector<double>> &ratings, int rowIndex, int colIndex);
 	double getGlobalBaselineRatingPrediction(vector<vector<double>> &ratings, int rowIndex, int colIndex);
 	vector<pair<int, double>> getTopCFRecommendations(vector<vector<double>> &ratings, int rowIndex, int limit, int includeRatedItems);
+	template <typename T> double getRatingPrediction(const RatingMatrix<T> &ratings, int rowIndex, int colIndex);
+	template <typename T> double getGlobalBaselineRatingPrediction(const RatingMatrix<T> &ratings, int rowIndex, int colIndex);
+	template <typename T> vector<pair<int, double>> getTopCFRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems);
+	template <typename T> vector<pair<int, double>> getHybridRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems,
+		int shrinkage);
+	template <typename T> vector<pair<int, double>> getGlobalBaselineRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit,
+		int includeRatedItems);
+	// Top recommendations from 0/1 interactions, with the similarity of the
+	// rows given by the policy S, CosineSimilarity or JaccardSimilarity.
+	template <typename S> vector<pair<int, double>> getBinaryRecommendations(const BinaryMatrix &interactions, int rowIndex, int limit,
+		int includeRatedItems);
+	template <typename T> int getAllTopCFRecommendations(const RatingMatrix<T> &ratings, const vector<int> &rowIndexes, int limit, int includeRatedItems,
+		int chunkSize, int threads, const function<void(const TopCFChunk &)> &onChunk);
+	template <typename T> int getRatingPredictionSums(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex,
+		double &ratingsSum, double &similaritiesSum);
+	template <typename T> int getTopCFSums(const RatingMatrix<T> &ratings, const T *row, int rowIndex, vector<double> &ratingsSums, double &similaritiesSum,
+		double *ratersCounts = NULL, const RatedItems *ratedItems = NULL);
+	template <typename T> vector<pair<int, double>> rankTopCF(const T *row, int cols, double scale, const double *ratingsSums, double similaritiesSum,
+		int limit, int includeRatedItems);
+	template <typename T> vector<pair<int, double>> rankHybrid(const T *row, int cols, double scale, const double *ratingsSums, const double *ratersCounts,
+		double similaritiesSum, double mean, const double *colMeans, int limit, int includeRatedItems, int shrinkage);
+	template <typename T> vector<pair<int, double>> rankGlobalBaseline(const T *row, int cols, double scale, const ItemBiasIndex &index, int limit,
+		int includeRatedItems);
 private:
 	bool useStopWords;
+
+	bool isCancelled() const;
+	void sortDocumentIndexes(const vector<double> &similarities, ScratchVector<int> &used);
+	template <typename T> vector<pair<int, double>> computeTopCFRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems);
+	template <typename T> vector<pair<int, double>> computeHybridRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit,
+		int includeRatedItems, int shrinkage);
+	template <typename T> vector<pair<int, double>> computeGlobalBaselineRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit,
+		int includeRatedItems);
+	template <typename S> vector<pair<int, double>> computeBinaryRecommendations(const BinaryMatrix &interactions, int rowIndex, int limit,
+		int includeRatedItems);
+	template <typename S> Neighbourhood getBinarySimilarities(const BinaryMatrix &interactions, int rowIndex);
+	template <typename T> double getColMeans(const RatingMatrix<T> &ratings, double *colMeans);
+	template <typename T> vector<pair<int, double>> predictTopCF(const RatingMatrix<T> &ratings, int rowIndex, const Neighbourhood &neighbourhood, int limit, int includeRatedItems,
+		const RatedItems *ratedItems = NULL);
+	template <typename T> void addNeighbourhoodSums(const RatingMatrix<T> &ratings, const Neighbourhood &neighbourhood,
+		double *ratingsSums, double &similaritiesSum, double *ratersCounts = NULL, const RatedItems *ratedItems = NULL);
+	vector<pair<int, double>> sortRecommendations(Neighbourhood &recommendations, int limit);
 	vector<vector<string>> vocabulary;
 
 	vector<string> readDocument(string documentFilePath);
-	vector<vector<string>> getVocabulary(string documentsFilePath);
+	const vector<vector<string>> &getDocuments() const;
+	const vector<string> &getRawDocuments() const;
 	vector<string> splitLineToWords(const string &line);
-	int getNumberOfTimesTermAppears(const string& term, vector<string> document) const;
-	int getNumberOfDocumentsWithTerm(string& termt) const;
-	double calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, string currentTerm) const;
-	vector<pair<int, double>> getNeighbourhood(int index, int colIndex, vector<vector<double>> &ratings, vector<vector<double>> originalRatings);
-	vector<pair<int, double>> getNeighbourhood(int index, vector<vector<double>> &ratings, vector<vector<double>> originalRatings);
-	vector<pair<int, double>> getSimilarities(vector<vector<double>> &ratings, double normA, int index, int colIndex, vector<vector<double>> originalRatings);
-	vector<pair<int, double>> getSimilarities(vector<vector<double>> &ratings, double normA, int index, vector<vector<double>> originalRatings);
+	int getNumberOfTimesTermAppears(const string& term, const vector<string> &document) const;
+	int getNumberOfDocumentsWithTerm(const string& term) const;
+	double calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, const string &currentTerm) const;
+	template <typename T> Neighbourhood getNeighbourhood(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, double normA);
+	template <typename T> Neighbourhood getSimilarities(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, double normA);
+	void sortNeighbourhood(Neighbourhood &similarities) const;
+	template <typename T> bool getCoRatingCounts(const RatingMatrix<T> &ratings, const T *row, const RatingIndex *index, int *counts) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,24 +1,60 @@
 #include <nan.h>
+#include <memory>
+#include <climits>
 #include "include/recommender.h"
+#include "include/CancellationToken.h"
+#include "include/WorkerPool.h"
+#include "include/ResultCache.h"
+#include "include/FileCache.h"
+#include "include/RatingMatrix.h"
+#include "include/BinaryMatrix.h"
+#include "include/Evaluation.h"
+#include "include/Stats.h"
+#include "include/Trace.h"
+#include "include/Sharding.h"
+#include "include/Snapshot.h"
+#include "include/RatingDelta.h"
+#include "include/MemoryBudget.h"
+#include "src/workers/RecommenderWorker.h"
+#include "src/workers/ExternalMemory.h"
+#include "src/workers/PoolQueue.h"
 #include "src/workers/CollaborativeFilteringWorker.cpp"
 #include "src/workers/GlobalBaselineWorker.cpp"
 #include "src/workers/TopCFRecommendationsWorker.cpp"
+#include "src/workers/HybridRecommendationsWorker.cpp"
+#include "src/workers/GlobalBaselineRecommendationsWorker.cpp"
+#include "src/workers/BinaryRecommendationsWorker.cpp"
+#include "src/workers/EvaluationWorker.cpp"
 #include "src/workers/TfIdfFilesWorker.cpp"
 #include "src/workers/TfIdfArraysWorker.cpp"
+#include "src/workers/TopCFBatchWorker.cpp"
+#include "src/workers/CorpusSearchWorker.cpp"
+#include "src/workers/RatingModelWorker.cpp"
+#include "src/workers/ModelUpdateWorker.cpp"
+#include "src/workers/ModelMergeWorker.cpp"
 
 using namespace Nan;
 using namespace v8;
 
 const int DEFAULT_TOP_CF_RECS_COUNT = 100;
+const int LIMIT_INVALID = -2;
 
-string getStringParameter(int index, NAN_METHOD_ARGS_TYPE info) {
-	v8::String::Utf8Value stringParam(info[index]->ToString());
+enum RatingStorage { STORAGE_DOUBLE, STORAGE_FLOAT32, STORAGE_UINT8, STORAGE_INVALID };
+enum BinarySimilarity { SIMILARITY_COSINE, SIMILARITY_JACCARD };
+
+string getStringValue(Local<Value> value) {
+	v8::String::Utf8Value stringParam(value->ToString());
 	string parsedString(*stringParam);
 
 	return parsedString;
 }
 
+string getStringParameter(int index, NAN_METHOD_ARGS_TYPE info) {
+	return getStringValue(info[index]);
+}
+
 Local<Array> convertArrayToV8Array(vector<string> arr, int length) {
+	StatsTimer timer(Stats::CONVERT);
 	Local<Array> result = New<v8::Array>(length);
 
 	for (int i = 0; i < length; i++) {
@@ -29,16 +65,20 @@ Local<Array> convertArrayToV8Array(vector<string> arr, int length) {
 }
 
 vector<string> castV8ArrayToArray(int index, NAN_METHOD_ARGS_TYPE info) {
+	StatsTimer timer(Stats::MARSHAL);
 	vector<string> documents;
+	size_t bytes = 0;
 	Local<Array> inputDocuments = Local<Array>::Cast(info[index]);
 
 	for (unsigned i = 0; i < inputDocuments->Length(); i++) {
 		if (Nan::Has(inputDocuments, i).FromJust()) {
 			v8::String::Utf8Value doc(Nan::Get(inputDocuments, i).ToLocalChecked()->ToString());
 			string document(*doc);
+			bytes += document.size();
 			documents.push_back(document);
 		}
 	}
+	Stats::getInstance().add(Stats::BYTES_COPIED, bytes);
 
 	return documents;
 }
@@ -56,7 +96,9 @@ void callCallbackWithEmptyArray(int index, NAN_METHOD_ARGS_TYPE info) {
 }
 
 vector<vector<double>> getMatrixParameter(int index, NAN_METHOD_ARGS_TYPE info) {
+	StatsTimer timer(Stats::MARSHAL);
 	vector<vector<double>> matrix;
+	size_t bytes = 0;
 	Local<Array> array = Local<Array>::Cast(info[index]);
 
 	for (unsigned i = 0; i < array->Length(); i++) {
@@ -69,15 +111,30 @@ vector<vector<double>> getMatrixParameter(int index, NAN_METHOD_ARGS_TYPE info)
 					row.push_back(value);
 				}
 			}
+			bytes += row.size() * sizeof(double);
 			matrix.push_back(row);
 		}
 	}
+	Stats::getInstance().add(Stats::BYTES_COPIED, bytes);
 
 	return matrix;
 }
 
 map<string, int> getOptionsObjectParameter(int index, NAN_METHOD_ARGS_TYPE info) {
 	map<string, int> opts;
+	if (!info[index]->IsObject() || info[index]->IsFunction()) {
+		opts["limit"] = -1;
+		opts["includeRatedItems"] = -1;
+		opts["timeout"] = -1;
+		opts["chunkSize"] = -1;
+		opts["minCoRatings"] = 1;
+		opts["storage"] = STORAGE_DOUBLE;
+		opts["scoring"] = SCORING_TFIDF;
+		opts["shrinkage"] = 0;
+		opts["similarity"] = SIMILARITY_COSINE;
+		return opts;
+	}
+
 	Local<Object> obj = Local<Object>::Cast(info[index]);
 	Local<Array> propertyNames = obj->GetOwnPropertyNames();
 	for (int i = 0; i < propertyNames->Length(); ++i) {
@@ -86,21 +143,144 @@ map<string, int> getOptionsObjectParameter(int index, NAN_METHOD_ARGS_TYPE info)
 		string key(*keyParam);
 		Local<Value> value = obj->Get(keyObj);
 
-		if (key == "limit") {
-			opts["limit"] = value->NumberValue();
+		if (key == "limit" && !value->IsUndefined()) {
+			// -1 means no limit, other negative numbers and NaN are invalid.
+			double limit = value->NumberValue();
+			opts["limit"] = limit == -1 || (limit >= 0 && limit <= INT_MAX) ? (int)limit : LIMIT_INVALID;
 		}
 		else if (key == "includeRatedItems") {
 			opts["includeRatedItems"] = value->BooleanValue();
 		}
+		else if (key == "timeout" && value->IsNumber()) {
+			opts["timeout"] = value->NumberValue();
+		}
+		else if (key == "chunkSize" && value->IsNumber()) {
+			opts["chunkSize"] = value->NumberValue();
+		}
+		else if (key == "minCoRatings") {
+			opts["minCoRatings"] = value->IsNumber() && value->NumberValue() >= 1 ? value->NumberValue() : -1;
+		}
+		else if (key == "storage") {
+			string storage = getStringValue(value);
+			if (storage == "double") opts["storage"] = STORAGE_DOUBLE;
+			else if (storage == "float32") opts["storage"] = STORAGE_FLOAT32;
+			else if (storage == "uint8") opts["storage"] = STORAGE_UINT8;
+			else opts["storage"] = STORAGE_INVALID;
+		}
+		else if (key == "scoring") {
+			string scoring = getStringValue(value);
+			if (scoring == "tfidf") opts["scoring"] = SCORING_TFIDF;
+			else if (scoring == "bm25") opts["scoring"] = SCORING_BM25;
+			else opts["scoring"] = -1;
+		}
+		else if (key == "shrinkage") {
+			opts["shrinkage"] = value->IsNumber() && value->NumberValue() >= 0 ? value->NumberValue() : -1;
+		}
+		else if (key == "similarity") {
+			string similarity = getStringValue(value);
+			if (similarity == "cosine") opts["similarity"] = SIMILARITY_COSINE;
+			else if (similarity == "jaccard") opts["similarity"] = SIMILARITY_JACCARD;
+			else opts["similarity"] = -1;
+		}
 	}
 
 	if (opts.find("limit") == opts.end()) opts["limit"] = -1;
 	if (opts.find("includeRatedItems") == opts.end()) opts["includeRatedItems"] = -1;
 	else opts["includeRatedItems"] = 1;
+	if (opts.find("timeout") == opts.end()) opts["timeout"] = -1;
+	if (opts.find("chunkSize") == opts.end()) opts["chunkSize"] = -1;
+	if (opts.find("minCoRatings") == opts.end()) opts["minCoRatings"] = 1;
+	if (opts.find("storage") == opts.end()) opts["storage"] = STORAGE_DOUBLE;
+	if (opts.find("scoring") == opts.end()) opts["scoring"] = SCORING_TFIDF;
+	if (opts.find("shrinkage") == opts.end()) opts["shrinkage"] = 0;
+	if (opts.find("similarity") == opts.end()) opts["similarity"] = SIMILARITY_COSINE;
 
 	return opts;
 }
 
+// uint8 storage has no room for negative ratings.
+bool isValidRatingStorage(int storage, const vector<vector<double>> &ratings) {
+	if (storage == STORAGE_INVALID) return false;
+	if (storage != STORAGE_UINT8) return true;
+
+	RatingQuantizer quantizer;
+	int ratingsSize = ratings.size();
+	for (int i = 0; i < ratingsSize; i++) {
+		int rowSize = ratings[i].size();
+		for (int j = 0; j < rowSize; j++) quantizer.observe(ratings[i][j]);
+	}
+
+	return quantizer.isValid();
+}
+
+map<string, int> getTfIdfOptionsParameter(int index, NAN_METHOD_ARGS_TYPE info) {
+	map<string, int> opts;
+	opts["filterStopWords"] = 0;
+	opts["timeout"] = -1;
+	if (info[index]->IsBoolean()) {
+		opts["filterStopWords"] = info[index]->BooleanValue();
+		return opts;
+	}
+	if (!info[index]->IsObject() || info[index]->IsFunction()) return opts;
+
+	Local<Object> obj = Local<Object>::Cast(info[index]);
+	Local<Value> filterStopWords = obj->Get(Nan::New<String>("filterStopWords").ToLocalChecked());
+	if (filterStopWords->IsBoolean()) opts["filterStopWords"] = filterStopWords->BooleanValue();
+	Local<Value> timeout = obj->Get(Nan::New<String>("timeout").ToLocalChecked());
+	if (timeout->IsNumber()) opts["timeout"] = timeout->NumberValue();
+
+	return opts;
+}
+
+// Only async calls can report that they were cut short, through the status
+// argument of their callback, so sync calls ignore the timeout and always
+// return the whole result.
+void setCancellationTimeout(Recommender &r, int timeout, NAN_METHOD_ARGS_TYPE info) {
+	if (timeout < 0) return;
+	bool async = false;
+	for (int i = 0; i < info.Length(); i++) async = async || info[i]->IsFunction();
+	if (!async) return;
+	r.cancellationToken = make_shared<CancellationToken>();
+	r.cancellationToken->setTimeout(timeout);
+}
+
+// Requests with an abort signal are never coalesced, since aborting one must
+// not cancel the others. The timeout is part of the key, and the earlier
+// request's deadline is never later than that of an identical later one.
+void queueRecommenderWorker(RecommenderWorker *worker, int optionsIndex, NAN_METHOD_ARGS_TYPE info) {
+	WorkerPool::Priority priority = WorkerPool::INTERACTIVE;
+	bool coalesce = true;
+	string timeout = "-1";
+	if (optionsIndex >= 0 && info[optionsIndex]->IsObject() && !info[optionsIndex]->IsFunction()) {
+		Local<Object> obj = Local<Object>::Cast(info[optionsIndex]);
+		Local<Value> signal = obj->Get(Nan::New<String>("signal").ToLocalChecked());
+		if (signal->IsObject()) {
+			worker->AttachAbortSignal(signal.As<Object>());
+			coalesce = false;
+		}
+
+		Local<Value> priorityValue = obj->Get(Nan::New<String>("priority").ToLocalChecked());
+		if (priorityValue->IsString() && getStringValue(priorityValue) == "batch") priority = WorkerPool::BATCH;
+
+		Local<Value> coalesceValue = obj->Get(Nan::New<String>("coalesce").ToLocalChecked());
+		if (coalesceValue->IsBoolean() && !coalesceValue->BooleanValue()) coalesce = false;
+
+		Local<Value> timeoutValue = obj->Get(Nan::New<String>("timeout").ToLocalChecked());
+		if (timeoutValue->IsNumber()) timeout = to_string(timeoutValue->IntegerValue());
+	}
+
+	if (coalesce) {
+		string key = worker->GetCoalescingKey();
+		if (!key.empty() && worker->JoinInFlight(key + "|" + timeout)) {
+			Stats::getInstance().add(Stats::COALESCED);
+			delete worker;
+			return;
+		}
+	}
+
+	PoolQueue::Queue(worker, priority);
+}
+
 bool isOutsideMatrix(vector<vector<double>> matrix, int rowIndex, int colIndex) {
 	return rowIndex < 0 || rowIndex >= (int)matrix.size() ||
 		colIndex < 0 || (matrix.size() > 0 && colIndex >= (int)matrix[0].size());
@@ -113,14 +293,14 @@ void tfidfFilePaths(Recommender r, NAN_METHOD_ARGS_TYPE info, bool useStopWords)
 	if (info[2]->IsFunction()) {
 		// Async
 		Callback *callback = new Callback(info[2].As<Function>());
-		AsyncQueueWorker(
-			new TfIdfFilesWorker(callback, r, documentFilePath, documentsFilePath, useStopWords)
+		queueRecommenderWorker(
+			new TfIdfFilesWorker(callback, r, documentFilePath, documentsFilePath, useStopWords), -1, info
 		);
 	} else if (info[3]->IsFunction()) {
 		// Async
 		Callback *callback = new Callback(info[3].As<Function>());
-		AsyncQueueWorker(new TfIdfFilesWorker(
-			callback, r, documentFilePath, documentsFilePath, useStopWords)
+		queueRecommenderWorker(new TfIdfFilesWorker(
+			callback, r, documentFilePath, documentsFilePath, useStopWords), 2, info
 		);
 	} else {
 		// Sync
@@ -140,16 +320,14 @@ void tfidfArrays(Recommender r, NAN_METHOD_ARGS_TYPE info, bool useStopWords) {
 	if (info[2]->IsFunction()) {
 		// Async
 		Callback *callback = new Callback(info[2].As<Function>());
-		AsyncQueueWorker(new TfIdfArraysWorker(callback, r, query, documents, useStopWords));
+		queueRecommenderWorker(new TfIdfArraysWorker(callback, r, query, documents, useStopWords), -1, info);
 	} else if (info[3]->IsFunction()) {
 		// Async
 		Callback *callback = new Callback(info[3].As<Function>());
-		AsyncQueueWorker(new TfIdfArraysWorker(callback, r, query, documents, useStopWords));
+		queueRecommenderWorker(new TfIdfArraysWorker(callback, r, query, documents, useStopWords), 2, info);
 	} else {
 		// Sync
-		r.tfidf(query, documents, useStopWords);
-		vector<double> recs = r.recommend(r.weights);
-		vector<string> sortedDocuments = r.getSortedDocuments(recs);
+		vector<string> sortedDocuments = r.recommendDocuments(query, documents, useStopWords);
 		Local<Array> result = convertArrayToV8Array(sortedDocuments, sortedDocuments.size());
 
 		info.GetReturnValue().Set(result);
@@ -157,6 +335,7 @@ void tfidfArrays(Recommender r, NAN_METHOD_ARGS_TYPE info, bool useStopWords) {
 }
 
 Local<Array> convertVectorOfPairsToV8Array(vector<pair<int, double>>& recommendations) {
+	StatsTimer timer(Stats::CONVERT);
 	Local<Array> result = New<v8::Array>();
 
 	for (unsigned i = 0; i < recommendations.size(); i++) {
@@ -176,10 +355,9 @@ NAN_METHOD(TfIdf) {
 	Recommender r;
 	if (!info[0]->IsString() || info[0]->ToString().IsEmpty()) Nan::ThrowError("Invalid query passed");
 
-	bool useStopWords = false;
-	if (info[2]->IsBoolean() && info[2]->BooleanValue()) {
-		useStopWords = info[2]->BooleanValue();
-	}
+	map<string, int> opts = getTfIdfOptionsParameter(2, info);
+	bool useStopWords = opts["filterStopWords"];
+	setCancellationTimeout(r, opts["timeout"], info);
 
 	if (info[1]->IsString()) {
 		tfidfFilePaths(r, info, useStopWords);
@@ -190,10 +368,114 @@ NAN_METHOD(TfIdf) {
 	}
 }
 
+template <typename T>
+RatingMatrix<T> getRatingMatrix(const vector<vector<double>> &rows) {
+	StatsTimer timer(Stats::MARSHAL);
+	RatingMatrix<T> ratings = RatingMatrix<T>::fromRows(rows);
+	Stats::getInstance().add(Stats::BYTES_COPIED, ratings.getBytes());
+
+	return ratings;
+}
+
+template <typename T>
+void ratingPrediction(Recommender r, vector<vector<double>> &rows, int rowIndex, int colIndex, int callbackIndex, NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(new CollaborativeFilteringWorker<T>(callback, r, ratings, rowIndex, colIndex), callbackIndex - 1, info);
+	} else {
+		// Sync
+		double predictedRating = r.getRatingPrediction(ratings, rowIndex, colIndex);
+		Local<Number> result = Nan::New(predictedRating);
+
+		info.GetReturnValue().Set(result);
+	}
+}
+
+template <typename T>
+void globalBaselineRatingPrediction(Recommender r, vector<vector<double>> &rows, int rowIndex, int colIndex, int callbackIndex, NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(new GlobalBaselineWorker<T>(callback, r, ratings, rowIndex, colIndex), callbackIndex - 1, info);
+	} else {
+		// Sync
+		double predictedRating = r.getGlobalBaselineRatingPrediction(ratings, rowIndex, colIndex);
+		Local<Number> result = Nan::New(predictedRating);
+
+		info.GetReturnValue().Set(result);
+	}
+}
+
+template <typename T>
+void topCFRecommendations(Recommender r, vector<vector<double>> &rows, int rowIndex, map<string, int> opts, int callbackIndex, NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(
+			new TopCFRecommendationsWorker<T>(callback, r, ratings, rowIndex, opts["limit"], opts["includeRatedItems"]), callbackIndex - 1, info
+		);
+	} else {
+		// Sync
+		vector<pair<int, double>> recommendations = r.getTopCFRecommendations(ratings, rowIndex, opts["limit"], opts["includeRatedItems"]);
+		Local<Array> result = convertVectorOfPairsToV8Array(recommendations);
+
+		info.GetReturnValue().Set(result);
+	}
+}
+
+template <typename T>
+void hybridRecommendations(Recommender r, vector<vector<double>> &rows, int rowIndex, map<string, int> opts, int callbackIndex, NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(
+			new HybridRecommendationsWorker<T>(callback, r, ratings, rowIndex, opts["limit"], opts["includeRatedItems"], opts["shrinkage"]),
+			callbackIndex - 1, info
+		);
+	} else {
+		// Sync
+		vector<pair<int, double>> recommendations = r.getHybridRecommendations(ratings, rowIndex, opts["limit"], opts["includeRatedItems"],
+			opts["shrinkage"]);
+		info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+	}
+}
+
+template <typename T>
+void globalBaselineRecommendations(Recommender r, vector<vector<double>> &rows, int rowIndex, map<string, int> opts, int callbackIndex,
+	NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(
+			new GlobalBaselineRecommendationsWorker<T>(callback, r, ratings, rowIndex, opts["limit"], opts["includeRatedItems"]),
+			callbackIndex - 1, info
+		);
+	} else {
+		// Sync
+		vector<pair<int, double>> recommendations = r.getGlobalBaselineRecommendations(ratings, rowIndex, opts["limit"], opts["includeRatedItems"]);
+		info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+	}
+}
+
+// Instantiates function for the value type selected by the storage option.
+#define DISPATCH_RATING_STORAGE(storage, function, ...) \
+	switch (storage) { \
+		case STORAGE_FLOAT32: function<float>(__VA_ARGS__); break; \
+		case STORAGE_UINT8: function<uint8_t>(__VA_ARGS__); break; \
+		default: function<double>(__VA_ARGS__); \
+	}
+
 NAN_METHOD(GetRatingPrediction) {
 	Recommender r;
 	if (!info[0]->IsArray() || !info[1]->IsNumber() || !info[2]->IsNumber()) {
 		if (info[3]->IsFunction()) return callCallbackWithInt(3, info, 0);
+		else if (info[4]->IsFunction()) return callCallbackWithInt(4, info, 0);
 		else return info.GetReturnValue().Set(0);
 	}
 
@@ -203,20 +485,18 @@ NAN_METHOD(GetRatingPrediction) {
 	
 	if (isOutsideMatrix(ratings, rowIndex, colIndex)) {
 		if (info[3]->IsFunction()) return callCallbackWithInt(3, info, 0);
+		else if (info[4]->IsFunction()) return callCallbackWithInt(4, info, 0);
 		else return info.GetReturnValue().Set(0);
 	}
 
-	if (info[3]->IsFunction()) {
-		// Async
-		Callback *callback = new Callback(info[3].As<Function>());
-		AsyncQueueWorker(new CollaborativeFilteringWorker(callback, r, ratings, rowIndex, colIndex));
-	} else {
-		// Sync
-		double predictedRating = r.getRatingPrediction(ratings, rowIndex, colIndex);
-		Local<Number> result = Nan::New(predictedRating);
+	map<string, int> opts = getOptionsObjectParameter(3, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	r.minCoRatings = opts["minCoRatings"];
 
-		info.GetReturnValue().Set(result);
-	}
+	int callbackIndex = info[3]->IsFunction() ? 3 : info[4]->IsFunction() ? 4 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], ratingPrediction, r, ratings, rowIndex, colIndex, callbackIndex, info);
 }
 
 NAN_METHOD(GetGlobalBaselineRatingPrediction) {
@@ -224,6 +504,7 @@ NAN_METHOD(GetGlobalBaselineRatingPrediction) {
 
 	if (!info[0]->IsArray() || !info[1]->IsNumber() || !info[2]->IsNumber()) {
 		if (info[3]->IsFunction()) return callCallbackWithInt(3, info, 0);
+		else if (info[4]->IsFunction()) return callCallbackWithInt(4, info, 0);
 		else return info.GetReturnValue().Set(0);
 	}
 
@@ -233,20 +514,16 @@ NAN_METHOD(GetGlobalBaselineRatingPrediction) {
 
 	if (isOutsideMatrix(ratings, rowIndex, colIndex)) {
 		if (info[3]->IsFunction()) return callCallbackWithInt(3, info, 0);
+		else if (info[4]->IsFunction()) return callCallbackWithInt(4, info, 0);
 		else return info.GetReturnValue().Set(0);
 	}
 
-	if (info[3]->IsFunction()) {
-		// Async
-		Callback *callback = new Callback(info[3].As<Function>());
-		AsyncQueueWorker(new GlobalBaselineWorker(callback, r, ratings, rowIndex, colIndex));
-	} else {
-		// Sync
-		double predictedRating = r.getGlobalBaselineRatingPrediction(ratings, rowIndex, colIndex);
-		Local<Number> result = Nan::New(predictedRating);
+	map<string, int> opts = getOptionsObjectParameter(3, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
 
-		info.GetReturnValue().Set(result);
-	}
+	int callbackIndex = info[3]->IsFunction() ? 3 : info[4]->IsFunction() ? 4 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], globalBaselineRatingPrediction, r, ratings, rowIndex, colIndex, callbackIndex, info);
 }
 
 NAN_METHOD(GetTopCFRecommendations) {
@@ -267,28 +544,979 @@ NAN_METHOD(GetTopCFRecommendations) {
 		else return info.GetReturnValue().Set(New<v8::Array>());
 	}
 
-	if (info[2]->IsFunction()) {
+	map<string, int> opts = getOptionsObjectParameter(2, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	r.minCoRatings = opts["minCoRatings"];
+
+	int callbackIndex = info[2]->IsFunction() ? 2 : info[3]->IsFunction() ? 3 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], topCFRecommendations, r, ratings, rowIndex, opts, callbackIndex, info);
+}
+
+// Same arguments and results as getTopCFRecommendations. Items the
+// neighbourhood can't predict get their global baseline instead of being left
+// out, and with shrinkage the two are blended.
+NAN_METHOD(GetHybridRecommendations) {
+	Recommender r;
+	int rowIndex = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+	vector<vector<double>> ratings;
+	if (info[0]->IsArray()) ratings = getMatrixParameter(0, info);
+	if (rowIndex < 0 || rowIndex >= (int)ratings.size()) {
+		if (info[2]->IsFunction()) return callCallbackWithEmptyArray(2, info);
+		else if (info[3]->IsFunction()) return callCallbackWithEmptyArray(3, info);
+		else return info.GetReturnValue().Set(New<v8::Array>());
+	}
+
+	map<string, int> opts = getOptionsObjectParameter(2, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	if (opts["shrinkage"] == -1) return Nan::ThrowError("Invalid shrinkage option passed");
+	r.minCoRatings = opts["minCoRatings"];
+
+	int callbackIndex = info[2]->IsFunction() ? 2 : info[3]->IsFunction() ? 3 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], hybridRecommendations, r, ratings, rowIndex, opts, callbackIndex, info);
+}
+
+// Same arguments and results as getTopCFRecommendations, ranked by the
+// global baseline of every item instead of the neighbourhood.
+NAN_METHOD(GetGlobalBaselineRecommendations) {
+	Recommender r;
+	int rowIndex = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+	vector<vector<double>> ratings;
+	if (info[0]->IsArray()) ratings = getMatrixParameter(0, info);
+	if (rowIndex < 0 || rowIndex >= (int)ratings.size()) {
+		if (info[2]->IsFunction()) return callCallbackWithEmptyArray(2, info);
+		else if (info[3]->IsFunction()) return callCallbackWithEmptyArray(3, info);
+		else return info.GetReturnValue().Set(New<v8::Array>());
+	}
+
+	map<string, int> opts = getOptionsObjectParameter(2, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+
+	int callbackIndex = info[2]->IsFunction() ? 2 : info[3]->IsFunction() ? 3 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], globalBaselineRecommendations, r, ratings, rowIndex, opts, callbackIndex, info);
+}
+
+template <typename S>
+void binaryRecommendations(Recommender r, vector<vector<double>> &rows, int rowIndex, map<string, int> opts, int callbackIndex,
+	NAN_METHOD_ARGS_TYPE info) {
+	BinaryMatrix interactions;
+	{
+		StatsTimer timer(Stats::MARSHAL);
+		interactions = BinaryMatrix::fromRows(rows);
+		Stats::getInstance().add(Stats::BYTES_COPIED, interactions.getBytes());
+	}
+	if (callbackIndex != -1) {
 		// Async
-		Callback *callback = new Callback(info[2].As<Function>());
-		AsyncQueueWorker(new TopCFRecommendationsWorker(callback, r, ratings, rowIndex, -1, -1));
-	} else if (info[3]->IsFunction()) {
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		queueRecommenderWorker(
+			new BinaryRecommendationsWorker<S>(callback, r, interactions, rowIndex, opts["limit"], opts["includeRatedItems"]),
+			callbackIndex - 1, info
+		);
+	} else {
+		// Sync
+		vector<pair<int, double>> recommendations = r.getBinaryRecommendations<S>(interactions, rowIndex, opts["limit"], opts["includeRatedItems"]);
+		info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+	}
+}
+
+// Same arguments and results as getTopCFRecommendations, for 0/1 interactions
+// such as views or purchases, which are kept as bitsets. Every value other
+// than 0 counts as an interaction, and the rating of a recommendation is the
+// similarity weighted share of the neighbourhood which has the item.
+NAN_METHOD(GetBinaryRecommendations) {
+	Recommender r;
+	int rowIndex = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+	vector<vector<double>> interactions;
+	if (info[0]->IsArray()) interactions = getMatrixParameter(0, info);
+	if (rowIndex < 0 || rowIndex >= (int)interactions.size()) {
+		if (info[2]->IsFunction()) return callCallbackWithEmptyArray(2, info);
+		else if (info[3]->IsFunction()) return callCallbackWithEmptyArray(3, info);
+		else return info.GetReturnValue().Set(New<v8::Array>());
+	}
+
+	map<string, int> opts = getOptionsObjectParameter(2, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	if (opts["similarity"] == -1) return Nan::ThrowError("Invalid similarity option passed");
+	r.minCoRatings = opts["minCoRatings"];
+
+	int callbackIndex = info[2]->IsFunction() ? 2 : info[3]->IsFunction() ? 3 : -1;
+	if (opts["similarity"] == SIMILARITY_JACCARD) binaryRecommendations<JaccardSimilarity>(r, interactions, rowIndex, opts, callbackIndex, info);
+	else binaryRecommendations<CosineSimilarity>(r, interactions, rowIndex, opts, callbackIndex, info);
+}
+
+template <typename T>
+void evaluation(Recommender r, vector<vector<double>> &ratings, const EvaluationOptions &options, int callbackIndex, NAN_METHOD_ARGS_TYPE info) {
+	int threads = WorkerPool::getInstance().size();
+	if (callbackIndex != -1) {
 		// Async
-		map<string, int> opts = getOptionsObjectParameter(2, info);
-		Callback *callback = new Callback(info[3].As<Function>());
-		AsyncQueueWorker(new TopCFRecommendationsWorker(callback, r, ratings, rowIndex, opts["limit"], opts["includeRatedItems"]));
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		PoolQueue::Queue(new EvaluationWorker<T>(callback, r, ratings, options, threads), WorkerPool::BATCH);
+	} else {
+		// Sync
+		Evaluator evaluator(r, options);
+		EvaluationResult result = evaluator.evaluate<T>(ratings, threads);
+		info.GetReturnValue().Set(convertEvaluationResultToV8Object(result, options.predictor));
+	}
+}
+
+template <typename T>
+void allTopCFRecommendations(Recommender r, vector<vector<double>> &rows, vector<int> rowIndexes, map<string, int> opts,
+	WorkerPool::Priority priority, int onChunkIndex, NAN_METHOD_ARGS_TYPE info) {
+	RatingMatrix<T> ratings = getRatingMatrix<T>(rows);
+	Callback *chunkCallback = new Callback(info[onChunkIndex].As<Function>());
+	Callback *callback = new Callback(info[onChunkIndex + 1].As<Function>());
+	PoolQueue::Queue(new TopCFBatchWorker<T>(callback, chunkCallback, r, ratings, rowIndexes, opts["limit"], opts["includeRatedItems"],
+		opts["chunkSize"], WorkerPool::getInstance().size()), priority);
+}
+
+NAN_METHOD(GetAllTopCFRecommendations) {
+	Recommender r;
+	int onChunkIndex = info[1]->IsFunction() ? 1 : 2;
+	if (!info[onChunkIndex]->IsFunction() || !info[onChunkIndex + 1]->IsFunction()) return Nan::ThrowError("Invalid callbacks passed");
+	if (!info[0]->IsArray()) return callCallbackWithInt(onChunkIndex + 1, info, 0);
+
+	vector<vector<double>> ratings = getMatrixParameter(0, info);
+	map<string, int> opts = getOptionsObjectParameter(1, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	r.minCoRatings = opts["minCoRatings"];
+
+	vector<int> rowIndexes;
+	bool hasRows = false;
+	WorkerPool::Priority priority = WorkerPool::BATCH;
+	if (onChunkIndex == 2 && info[1]->IsObject()) {
+		Local<Object> obj = Local<Object>::Cast(info[1]);
+		Local<Value> rows = obj->Get(Nan::New<String>("rows").ToLocalChecked());
+		if (!rows->IsUndefined()) {
+			if (!rows->IsArray()) return Nan::ThrowError("Invalid rows option passed");
+			Local<Array> rowsArray = Local<Array>::Cast(rows);
+			for (unsigned i = 0; i < rowsArray->Length(); i++) {
+				Local<Value> row = Nan::Get(rowsArray, i).ToLocalChecked();
+				if (!row->IsNumber() || row->IntegerValue() < 0 || row->IntegerValue() >= (int)ratings.size()) {
+					return Nan::ThrowError("Invalid rows option passed");
+				}
+				rowIndexes.push_back(row->IntegerValue());
+			}
+			hasRows = true;
+		}
+
+		Local<Value> priorityValue = obj->Get(Nan::New<String>("priority").ToLocalChecked());
+		if (priorityValue->IsString() && getStringValue(priorityValue) == "interactive") priority = WorkerPool::INTERACTIVE;
+	}
+	if (!hasRows) {
+		for (int i = 0; i < (int)ratings.size(); i++) rowIndexes.push_back(i);
+	}
+
+	DISPATCH_RATING_STORAGE(opts["storage"], allTopCFRecommendations, r, ratings, rowIndexes, opts, priority, onChunkIndex, info);
+}
+
+// Reads the split, predictor, testShare, leaveOut, folds, seed, cutoff and
+// relevantRating options of evaluate. Returns the name of the first invalid
+// option, or an empty string.
+string getEvaluationOptions(int index, NAN_METHOD_ARGS_TYPE info, EvaluationOptions &options) {
+	if (!info[index]->IsObject() || info[index]->IsFunction()) return "";
+
+	Local<Object> obj = Local<Object>::Cast(info[index]);
+	Local<Value> splitValue = obj->Get(Nan::New<String>("split").ToLocalChecked());
+	if (!splitValue->IsUndefined()) {
+		string split = getStringValue(splitValue);
+		if (split == "random") options.split = SPLIT_RANDOM;
+		else if (split == "leaveKOut") options.split = SPLIT_LEAVE_K_OUT;
+		else if (split == "kFold") options.split = SPLIT_K_FOLD;
+		else return "split";
+	}
+
+	Local<Value> predictorValue = obj->Get(Nan::New<String>("predictor").ToLocalChecked());
+	if (!predictorValue->IsUndefined()) {
+		string predictor = getStringValue(predictorValue);
+		if (predictor == "cf") options.predictor = PREDICTOR_CF;
+		else if (predictor == "globalBaseline") options.predictor = PREDICTOR_GLOBAL_BASELINE;
+		else if (predictor == "topCF") options.predictor = PREDICTOR_TOP_CF;
+		else return "predictor";
+	}
+
+	Local<Value> testShareValue = obj->Get(Nan::New<String>("testShare").ToLocalChecked());
+	if (!testShareValue->IsUndefined()) {
+		if (!testShareValue->IsNumber() || !(testShareValue->NumberValue() >= 0 && testShareValue->NumberValue() <= 1)) return "testShare";
+		options.testShare = testShareValue->NumberValue();
+	}
+
+	Local<Value> leaveOutValue = obj->Get(Nan::New<String>("leaveOut").ToLocalChecked());
+	if (!leaveOutValue->IsUndefined()) {
+		if (!leaveOutValue->IsNumber() || leaveOutValue->IntegerValue() < 1) return "leaveOut";
+		options.leaveOut = leaveOutValue->IntegerValue();
+	}
+
+	Local<Value> foldsValue = obj->Get(Nan::New<String>("folds").ToLocalChecked());
+	if (!foldsValue->IsUndefined()) {
+		if (!foldsValue->IsNumber() || foldsValue->IntegerValue() < 2) return "folds";
+		options.folds = foldsValue->IntegerValue();
+	}
+
+	Local<Value> seedValue = obj->Get(Nan::New<String>("seed").ToLocalChecked());
+	if (!seedValue->IsUndefined()) {
+		if (!seedValue->IsNumber() || seedValue->IntegerValue() < 0) return "seed";
+		options.seed = seedValue->IntegerValue();
+	}
+
+	Local<Value> cutoffValue = obj->Get(Nan::New<String>("cutoff").ToLocalChecked());
+	if (!cutoffValue->IsUndefined()) {
+		if (!cutoffValue->IsNumber() || cutoffValue->IntegerValue() < 1) return "cutoff";
+		options.cutoff = cutoffValue->IntegerValue();
+	}
+
+	Local<Value> relevantRatingValue = obj->Get(Nan::New<String>("relevantRating").ToLocalChecked());
+	if (!relevantRatingValue->IsUndefined()) {
+		if (!relevantRatingValue->IsNumber() || isnan(relevantRatingValue->NumberValue())) return "relevantRating";
+		options.relevantRating = relevantRatingValue->NumberValue();
+	}
+
+	return "";
+}
+
+// Evaluates a predictor on ratings held out of the ratings, with the split and
+// predictor of the options, and returns or calls back with its metrics. The
+// storage, minCoRatings and timeout options apply to the predictor. Async
+// evaluations run with batch priority.
+NAN_METHOD(Evaluate) {
+	Recommender r;
+	if (!info[0]->IsArray()) return Nan::ThrowError("Invalid ratings passed");
+
+	vector<vector<double>> ratings = getMatrixParameter(0, info);
+	map<string, int> opts = getOptionsObjectParameter(1, info);
+	setCancellationTimeout(r, opts["timeout"], info);
+	if (!isValidRatingStorage(opts["storage"], ratings)) return Nan::ThrowError("Invalid storage option passed");
+	if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+	r.minCoRatings = opts["minCoRatings"];
+
+	EvaluationOptions options;
+	string invalidOption = getEvaluationOptions(1, info, options);
+	if (!invalidOption.empty()) return Nan::ThrowError(("Invalid " + invalidOption + " option passed").c_str());
+
+	int callbackIndex = info[1]->IsFunction() ? 1 : info[2]->IsFunction() ? 2 : -1;
+	DISPATCH_RATING_STORAGE(opts["storage"], evaluation, r, ratings, options, callbackIndex, info);
+}
+
+// Reads the shards, partition and ids options of the Corpus and RatingModel
+// constructors. Returns the name of the first invalid option, or an empty
+// string.
+string getShardingOptions(int index, NAN_METHOD_ARGS_TYPE info, int size, int &shards, ShardPartition &partition, vector<int> &ids) {
+	shards = 1;
+	partition = PARTITION_RANGE;
+	if (!info[index]->IsObject()) return "";
+
+	Local<Object> obj = Local<Object>::Cast(info[index]);
+	Local<Value> shardsValue = obj->Get(Nan::New<String>("shards").ToLocalChecked());
+	if (!shardsValue->IsUndefined()) {
+		if (!shardsValue->IsNumber() || shardsValue->IntegerValue() < 1) return "shards";
+		shards = shardsValue->IntegerValue();
+	}
+
+	Local<Value> partitionValue = obj->Get(Nan::New<String>("partition").ToLocalChecked());
+	if (!partitionValue->IsUndefined()) {
+		string partitionName = getStringValue(partitionValue);
+		if (partitionName == "range") partition = PARTITION_RANGE;
+		else if (partitionName == "hash") partition = PARTITION_HASH;
+		else return "partition";
+	}
+
+	Local<Value> idsValue = obj->Get(Nan::New<String>("ids").ToLocalChecked());
+	if (!idsValue->IsUndefined()) {
+		if (!idsValue->IsArray()) return "ids";
+		Local<Array> idsArray = Local<Array>::Cast(idsValue);
+		if ((int)idsArray->Length() != size) return "ids";
+		for (unsigned i = 0; i < idsArray->Length(); i++) {
+			Local<Value> id = Nan::Get(idsArray, i).ToLocalChecked();
+			if (!id->IsNumber() || id->IntegerValue() < 0) return "ids";
+			ids.push_back(id->IntegerValue());
+		}
+	}
+
+	return "";
+}
+
+Local<Object> convertCorpusStatsToV8Object(const CorpusStats &stats) {
+	StatsTimer timer(Stats::CONVERT);
+	Local<Object> result = Nan::New<Object>();
+	Local<Object> documentFrequencies = Nan::New<Object>();
+	for (auto const &entry : stats.documentFrequencies) {
+		Nan::Set(documentFrequencies, Nan::New<String>(entry.first).ToLocalChecked(), Nan::New<Number>(entry.second));
+	}
+	Nan::Set(result, Nan::New<String>("documents").ToLocalChecked(), Nan::New<Number>(stats.documents));
+	Nan::Set(result, Nan::New<String>("words").ToLocalChecked(), Nan::New<Number>(stats.words));
+	Nan::Set(result, Nan::New<String>("documentFrequencies").ToLocalChecked(), documentFrequencies);
+
+	return result;
+}
+
+// The inverse of convertCorpusStatsToV8Object. Returns false if value is not
+// a stats object. words is only needed by BM25, so stats without it are valid.
+bool castV8ObjectToCorpusStats(Local<Value> value, CorpusStats &stats) {
+	StatsTimer timer(Stats::MARSHAL);
+	if (!value->IsObject()) return false;
+	Local<Object> obj = Local<Object>::Cast(value);
+	Local<Value> documents = obj->Get(Nan::New<String>("documents").ToLocalChecked());
+	Local<Value> documentFrequencies = obj->Get(Nan::New<String>("documentFrequencies").ToLocalChecked());
+	Local<Value> words = obj->Get(Nan::New<String>("words").ToLocalChecked());
+	if (!documents->IsNumber() || !documentFrequencies->IsObject()) return false;
+	if (!words->IsUndefined() && !words->IsNumber()) return false;
+
+	stats.documents = documents->IntegerValue();
+	stats.words = words->IsNumber() ? words->NumberValue() : 0;
+	Local<Object> frequencies = Local<Object>::Cast(documentFrequencies);
+	Local<Array> terms = frequencies->GetOwnPropertyNames();
+	for (unsigned i = 0; i < terms->Length(); i++) {
+		Local<Value> term = terms->Get(i);
+		Local<Value> frequency = frequencies->Get(term);
+		if (!frequency->IsNumber()) return false;
+		stats.documentFrequencies[getStringValue(term)] = frequency->IntegerValue();
+	}
+
+	return true;
+}
+
+// Parses a list of search results of the shape returned by Corpus#search.
+bool castV8ArrayToHits(Local<Value> value, vector<pair<int, double>> &hits) {
+	if (!value->IsArray()) return false;
+	Local<Array> array = Local<Array>::Cast(value);
+	Local<String> idProp = Nan::New<String>("id").ToLocalChecked();
+	Local<String> scoreProp = Nan::New<String>("score").ToLocalChecked();
+	for (unsigned i = 0; i < array->Length(); i++) {
+		Local<Value> hit = Nan::Get(array, i).ToLocalChecked();
+		if (!hit->IsObject()) return false;
+		Local<Value> id = Nan::Get(hit.As<Object>(), idProp).ToLocalChecked();
+		Local<Value> score = Nan::Get(hit.As<Object>(), scoreProp).ToLocalChecked();
+		if (!id->IsNumber() || !score->IsNumber()) return false;
+		hits.push_back(make_pair((int)id->IntegerValue(), score->NumberValue()));
+	}
+
+	return true;
+}
+
+Local<Array> convertHitsToV8Array(const vector<pair<int, double>> &hits) {
+	StatsTimer timer(Stats::CONVERT);
+	Local<Array> result = New<v8::Array>(hits.size());
+	Local<String> idProp = Nan::New<String>("id").ToLocalChecked();
+	Local<String> scoreProp = Nan::New<String>("score").ToLocalChecked();
+	for (unsigned i = 0; i < hits.size(); i++) {
+		Local<Object> obj = Nan::New<Object>();
+		Nan::Set(obj, idProp, Nan::New<Number>(hits[i].first));
+		Nan::Set(obj, scoreProp, Nan::New<Number>(hits[i].second));
+		Nan::Set(result, i, obj);
+	}
+
+	return result;
+}
+
+Local<Object> convertMemoryUsageToV8Object(const MemoryUsage &usage) {
+	Local<Object> result = Nan::New<Object>();
+	Local<Object> components = Nan::New<Object>();
+	for (auto const &entry : usage.components) {
+		Nan::Set(components, Nan::New<String>(entry.first).ToLocalChecked(), Nan::New<Number>(entry.second));
+	}
+	Nan::Set(result, Nan::New<String>("heapBytes").ToLocalChecked(), Nan::New<Number>(usage.heapBytes));
+	Nan::Set(result, Nan::New<String>("mappedBytes").ToLocalChecked(), Nan::New<Number>(usage.mappedBytes));
+	Nan::Set(result, Nan::New<String>("components").ToLocalChecked(), components);
+
+	return result;
+}
+
+// Builds a new version of a model and publishes it, now or, with a callback
+// after the options, on the pool. Returns or calls back with true if it was
+// published, and false if the model file was invalid, the model didn't fit in
+// the memory budget or a later update was published first. The holder is
+// kept alive until onPublished has run.
+template <typename Model>
+void runModelUpdate(shared_ptr<Snapshot<Model>> snapshot, function<shared_ptr<const Model>()> build, function<void()> onPublished,
+	NAN_METHOD_ARGS_TYPE info) {
+	int callbackIndex = info[1]->IsFunction() ? 1 : info[2]->IsFunction() ? 2 : -1;
+	Recommender r;
+	setCancellationTimeout(r, getOptionsObjectParameter(1, info)["timeout"], info);
+	if (callbackIndex != -1) {
+		// Async
+		Callback *callback = new Callback(info[callbackIndex].As<Function>());
+		ModelUpdateWorker<Model> *worker = new ModelUpdateWorker<Model>(callback, r, snapshot, build, onPublished);
+		worker->SaveToPersistent("holder", info.Holder());
+		queueRecommenderWorker(worker, callbackIndex - 1, info);
 	} else {
 		// Sync
-		vector<pair<int, double>> recommendations;
-		if (info[2]->IsObject()) {
-			map<string, int> opts = getOptionsObjectParameter(2, info);
-			recommendations = r.getTopCFRecommendations(ratings, rowIndex, opts["limit"], opts["includeRatedItems"]);
+		uint64_t version = snapshot->reserve();
+		shared_ptr<const Model> model = build();
+		bool published = model->isValid() && snapshot->publish(model, version);
+		if (published) onPublished();
+		info.GetReturnValue().Set(Nan::New<Boolean>(published));
+	}
+}
+
+// A sharded corpus which is built once and searched many times. The native
+// corpus is shared with the workers of searches still in flight, and a corpus
+// loaded from a file with every other one loaded from the same file.
+class CorpusObject : public ObjectWrap {
+public:
+	static void Init(Local<Object> target) {
+		Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(CorpusObject::New);
+		tpl->SetClassName(Nan::New<String>("Corpus").ToLocalChecked());
+		tpl->InstanceTemplate()->SetInternalFieldCount(1);
+		Nan::SetPrototypeMethod(tpl, "search", CorpusObject::Search);
+		Nan::SetPrototypeMethod(tpl, "stats", CorpusObject::GetStats);
+		Nan::SetPrototypeMethod(tpl, "save", CorpusObject::Save);
+		Nan::SetPrototypeMethod(tpl, "update", CorpusObject::Update);
+		Nan::SetPrototypeMethod(tpl, "memoryUsage", CorpusObject::GetMemoryUsage);
+		Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
+		Nan::Set(constructor, Nan::New<String>("load").ToLocalChecked(),
+			Nan::GetFunction(Nan::New<FunctionTemplate>(CorpusObject::Load, constructor)).ToLocalChecked());
+		Nan::Set(target, Nan::New<String>("Corpus").ToLocalChecked(), constructor);
+	}
+
+private:
+	typedef function<shared_ptr<const ShardedCorpus>()> Build;
+
+	shared_ptr<Snapshot<ShardedCorpus>> corpus;
+	ExternalMemory external;
+
+	explicit CorpusObject(shared_ptr<const ShardedCorpus> corpus) : corpus(make_shared<Snapshot<ShardedCorpus>>(corpus)) {
+		this->ReportMemory();
+	}
+
+	// Reports the heap bytes of the current corpus to V8. An older version
+	// which searches still hold is no longer counted.
+	void ReportMemory() {
+		this->external.set(this->corpus->get()->getMemoryUsage().heapBytes);
+	}
+
+	// Parses the documents and options of the constructor into a function
+	// which builds the corpus. Returns the error message if they are invalid.
+	static string ParseBuild(NAN_METHOD_ARGS_TYPE info, Build &build) {
+		if (!info[0]->IsArray()) return "Invalid documents passed";
+
+		shared_ptr<vector<string>> documents = make_shared<vector<string>>(castV8ArrayToArray(0, info));
+		int shards;
+		ShardPartition partition;
+		vector<int> ids;
+		string invalidOption = getShardingOptions(1, info, documents->size(), shards, partition, ids);
+		if (!invalidOption.empty()) return "Invalid " + invalidOption + " option passed";
+		bool useStopWords = getTfIdfOptionsParameter(1, info)["filterStopWords"];
+
+		build = [documents, ids, shards, partition, useStopWords]() {
+			return make_shared<const ShardedCorpus>(*documents, ids, shards, partition, useStopWords);
+		};
+		return "";
+	}
+
+	static NAN_METHOD(New) {
+		if (!info.IsConstructCall()) return Nan::ThrowError("Corpus must be called with new");
+		// Corpus.load passes the corpus it loaded.
+		if (info[0]->IsExternal()) {
+			CorpusObject *object = new CorpusObject(*static_cast<shared_ptr<const ShardedCorpus> *>(info[0].As<External>()->Value()));
+			object->Wrap(info.This());
+			return info.GetReturnValue().Set(info.This());
+		}
+
+		Build build;
+		string error = CorpusObject::ParseBuild(info, build);
+		if (!error.empty()) return Nan::ThrowError(error.c_str());
+
+		shared_ptr<const ShardedCorpus> corpus = build();
+		if (!corpus->isValid()) return Nan::ThrowError("Model exceeds memory budget");
+		CorpusObject *object = new CorpusObject(corpus);
+		object->Wrap(info.This());
+		info.GetReturnValue().Set(info.This());
+	}
+
+	static NAN_METHOD(Search) {
+		shared_ptr<const ShardedCorpus> corpus = ObjectWrap::Unwrap<CorpusObject>(info.Holder())->corpus->get();
+		Recommender r;
+		string query = info[0]->IsString() ? getStringParameter(0, info) : "";
+		map<string, int> opts = getOptionsObjectParameter(1, info);
+		setCancellationTimeout(r, opts["timeout"], info);
+		if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+		if (opts["scoring"] == -1) return Nan::ThrowError("Invalid scoring option passed");
+		CorpusScoring scoring = (CorpusScoring)opts["scoring"];
+
+		shared_ptr<CorpusStats> stats;
+		if (info[1]->IsObject() && !info[1]->IsFunction()) {
+			Local<Value> statsValue = Local<Object>::Cast(info[1])->Get(Nan::New<String>("stats").ToLocalChecked());
+			if (!statsValue->IsUndefined()) {
+				stats = make_shared<CorpusStats>();
+				if (!castV8ObjectToCorpusStats(statsValue, *stats)) return Nan::ThrowError("Invalid stats option passed");
+			}
+		}
+
+		int threads = WorkerPool::getInstance().size();
+		int callbackIndex = info[1]->IsFunction() ? 1 : info[2]->IsFunction() ? 2 : -1;
+		if (callbackIndex != -1) {
+			// Async
+			Callback *callback = new Callback(info[callbackIndex].As<Function>());
+			queueRecommenderWorker(new CorpusSearchWorker(callback, r, corpus, query, opts["limit"], stats, scoring, threads), callbackIndex - 1, info);
 		} else {
-			recommendations = r.getTopCFRecommendations(ratings, rowIndex, -1, -1);
+			// Sync
+			vector<pair<int, double>> hits = corpus->search(query, opts["limit"], threads, stats.get(), scoring);
+			info.GetReturnValue().Set(convertHitsToV8Array(hits));
+		}
+	}
+
+	static NAN_METHOD(GetStats) {
+		CorpusObject *object = ObjectWrap::Unwrap<CorpusObject>(info.Holder());
+		info.GetReturnValue().Set(convertCorpusStatsToV8Object(object->corpus->get()->getStats()));
+	}
+
+	static NAN_METHOD(Save) {
+		CorpusObject *object = ObjectWrap::Unwrap<CorpusObject>(info.Holder());
+		if (!info[0]->IsString()) return Nan::ThrowError("Invalid path passed");
+		if (!object->corpus->get()->save(getStringParameter(0, info))) return Nan::ThrowError("Could not write model file");
+	}
+
+	static NAN_METHOD(GetMemoryUsage) {
+		CorpusObject *object = ObjectWrap::Unwrap<CorpusObject>(info.Holder());
+		info.GetReturnValue().Set(convertMemoryUsageToV8Object(object->corpus->get()->getMemoryUsage()));
+	}
+
+	// Replaces the corpus with one built from other documents, or with the
+	// corpus in a file written by save. Searches which have started finish on
+	// the corpus they started on.
+	static NAN_METHOD(Update) {
+		CorpusObject *object = ObjectWrap::Unwrap<CorpusObject>(info.Holder());
+		Build build;
+		if (info[0]->IsString()) {
+			string path = getStringParameter(0, info);
+			build = [path]() { return make_shared<const ShardedCorpus>(ModelImage::open(path)); };
+		} else {
+			string error = CorpusObject::ParseBuild(info, build);
+			if (!error.empty()) return Nan::ThrowError(error.c_str());
+		}
+
+		runModelUpdate(object->corpus, build, [object]() { object->ReportMemory(); }, info);
+	}
+
+	// Maps a file written by save. It is read in place, so all processes and
+	// worker threads which load the same file share its memory.
+	static NAN_METHOD(Load) {
+		if (!info[0]->IsString()) return Nan::ThrowError("Invalid path passed");
+		shared_ptr<const ShardedCorpus> corpus = make_shared<const ShardedCorpus>(ModelImage::open(getStringParameter(0, info)));
+		if (!corpus->isValid()) return Nan::ThrowError("Invalid model file passed");
+
+		Local<Value> argv[] = { Nan::New<External>(&corpus) };
+		info.GetReturnValue().Set(Nan::NewInstance(info.Data().As<Function>(), 1, argv).ToLocalChecked());
+	}
+};
+
+// A sharded rating table which is built once and queried many times. The
+// native model is shared with the workers of queries still in flight, and a
+// model loaded from a file with every other one loaded from the same file.
+class RatingModelObject : public ObjectWrap {
+public:
+	static void Init(Local<Object> target) {
+		Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(RatingModelObject::New);
+		tpl->SetClassName(Nan::New<String>("RatingModel").ToLocalChecked());
+		tpl->InstanceTemplate()->SetInternalFieldCount(1);
+		Nan::SetPrototypeMethod(tpl, "getRatingPrediction", RatingModelObject::GetRatingPrediction);
+		Nan::SetPrototypeMethod(tpl, "getGlobalBaselineRatingPrediction", RatingModelObject::GetGlobalBaselineRatingPrediction);
+		Nan::SetPrototypeMethod(tpl, "getTopCFRecommendations", RatingModelObject::GetTopCFRecommendations);
+		Nan::SetPrototypeMethod(tpl, "getHybridRecommendations", RatingModelObject::GetHybridRecommendations);
+		Nan::SetPrototypeMethod(tpl, "getGlobalBaselineRecommendations", RatingModelObject::GetGlobalBaselineRecommendations);
+		Nan::SetPrototypeMethod(tpl, "save", RatingModelObject::Save);
+		Nan::SetPrototypeMethod(tpl, "update", RatingModelObject::Update);
+		Nan::SetPrototypeMethod(tpl, "addRatings", RatingModelObject::AddRatings);
+		Nan::SetPrototypeMethod(tpl, "merge", RatingModelObject::Merge);
+		Nan::SetPrototypeMethod(tpl, "memoryUsage", RatingModelObject::GetMemoryUsage);
+		Local<Function> constructor = Nan::GetFunction(tpl).ToLocalChecked();
+		Nan::Set(constructor, Nan::New<String>("load").ToLocalChecked(),
+			Nan::GetFunction(Nan::New<FunctionTemplate>(RatingModelObject::Load, constructor)).ToLocalChecked());
+		Nan::Set(target, Nan::New<String>("RatingModel").ToLocalChecked(), constructor);
+	}
+
+private:
+	typedef function<shared_ptr<const ShardedRatingModel>()> Build;
+
+	shared_ptr<Snapshot<ShardedRatingModel>> model;
+	// Ratings added since the model was built, which a merge on the pool
+	// folds into a new version once mergeThreshold of them are pending.
+	shared_ptr<RatingDelta> delta;
+	int mergeThreshold;
+	ExternalMemory external;
+
+	RatingModelObject(shared_ptr<const ShardedRatingModel> model, int mergeThreshold) :
+		model(make_shared<Snapshot<ShardedRatingModel>>(model)),
+		delta(make_shared<RatingDelta>()),
+		mergeThreshold(mergeThreshold) {
+		this->ReportMemory();
+	}
+
+	void ReportMemory() {
+		this->external.set(this->model->get()->getMemoryUsage().heapBytes);
+	}
+
+	// Parses the ratings and options of the constructor into a function which
+	// builds the model. Returns the error message if they are invalid.
+	static string ParseBuild(NAN_METHOD_ARGS_TYPE info, Build &build) {
+		if (!info[0]->IsArray()) return "Invalid ratings passed";
+
+		shared_ptr<vector<vector<double>>> ratings = make_shared<vector<vector<double>>>(getMatrixParameter(0, info));
+		int shards;
+		ShardPartition partition;
+		vector<int> ids;
+		string invalidOption = getShardingOptions(1, info, ratings->size(), shards, partition, ids);
+		if (!invalidOption.empty()) return "Invalid " + invalidOption + " option passed";
+
+		build = [ratings, ids, shards, partition]() {
+			return make_shared<const ShardedRatingModel>(*ratings, ids, shards, partition);
+		};
+		return "";
+	}
+
+	static NAN_METHOD(New) {
+		if (!info.IsConstructCall()) return Nan::ThrowError("RatingModel must be called with new");
+		// RatingModel.load passes the model it loaded.
+		if (info[0]->IsExternal()) {
+			RatingModelObject *object = new RatingModelObject(*static_cast<shared_ptr<const ShardedRatingModel> *>(info[0].As<External>()->Value()),
+				DELTA_MERGE_THRESHOLD);
+			object->Wrap(info.This());
+			return info.GetReturnValue().Set(info.This());
+		}
+
+		Build build;
+		string error = RatingModelObject::ParseBuild(info, build);
+		if (!error.empty()) return Nan::ThrowError(error.c_str());
+		int mergeThreshold = DELTA_MERGE_THRESHOLD;
+		if (info[1]->IsObject()) {
+			Local<Value> mergeThresholdValue = Nan::Get(info[1].As<Object>(), Nan::New<String>("mergeThreshold").ToLocalChecked()).ToLocalChecked();
+			if (!mergeThresholdValue->IsUndefined()) {
+				if (!mergeThresholdValue->IsNumber() || mergeThresholdValue->IntegerValue() < 1) {
+					return Nan::ThrowError("Invalid mergeThreshold option passed");
+				}
+				mergeThreshold = mergeThresholdValue->IntegerValue();
+			}
+		}
+
+		shared_ptr<const ShardedRatingModel> model = build();
+		if (!model->isValid()) return Nan::ThrowError("Model exceeds memory budget");
+		RatingModelObject *object = new RatingModelObject(model, mergeThreshold);
+		object->Wrap(info.This());
+		info.GetReturnValue().Set(info.This());
+	}
+
+	// Parses the options at optionsIndex and runs the method now or, with a
+	// callback after them, on the pool. The delta is taken before the model,
+	// so ratings a merge has published are still read from one of them.
+	static void Run(NAN_METHOD_ARGS_TYPE info, RatingModelWorker::Method method, int rowIndex, int colIndex, int optionsIndex) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		shared_ptr<const DeltaRows> delta = object->delta->get();
+		shared_ptr<const ShardedRatingModel> model = object->model->get();
+		Recommender r;
+		map<string, int> opts = getOptionsObjectParameter(optionsIndex, info);
+		setCancellationTimeout(r, opts["timeout"], info);
+		if (opts["limit"] == LIMIT_INVALID) return Nan::ThrowError("Invalid limit option passed");
+		if (opts["minCoRatings"] == -1) return Nan::ThrowError("Invalid minCoRatings option passed");
+		if (opts["shrinkage"] == -1) return Nan::ThrowError("Invalid shrinkage option passed");
+		r.minCoRatings = opts["minCoRatings"];
+
+		int threads = WorkerPool::getInstance().size();
+		int callbackIndex = info[optionsIndex]->IsFunction() ? optionsIndex : info[optionsIndex + 1]->IsFunction() ? optionsIndex + 1 : -1;
+		if (callbackIndex != -1) {
+			// Async
+			Callback *callback = new Callback(info[callbackIndex].As<Function>());
+			queueRecommenderWorker(new RatingModelWorker(callback, r, model, delta, method, rowIndex, colIndex, opts["limit"],
+				opts["includeRatedItems"], opts["shrinkage"], threads), callbackIndex - 1, info);
+		} else if (method == RatingModelWorker::TOP_CF) {
+			// Sync
+			vector<pair<int, double>> recommendations = model->getTopCFRecommendations(r, rowIndex, opts["limit"], opts["includeRatedItems"],
+				threads, delta.get());
+			info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+		} else if (method == RatingModelWorker::HYBRID) {
+			vector<pair<int, double>> recommendations = model->getHybridRecommendations(r, rowIndex, opts["limit"], opts["includeRatedItems"],
+				opts["shrinkage"], threads, delta.get());
+			info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+		} else if (method == RatingModelWorker::BASELINE_TOP) {
+			vector<pair<int, double>> recommendations = model->getGlobalBaselineRecommendations(rowIndex, opts["limit"], opts["includeRatedItems"],
+				delta.get());
+			info.GetReturnValue().Set(convertVectorOfPairsToV8Array(recommendations));
+		} else if (method == RatingModelWorker::PREDICTION) {
+			info.GetReturnValue().Set(Nan::New(model->getRatingPrediction(r, rowIndex, colIndex, threads, delta.get())));
+		} else {
+			info.GetReturnValue().Set(Nan::New(model->getGlobalBaselineRatingPrediction(rowIndex, colIndex, delta.get())));
 		}
-		Local<Array> result = convertVectorOfPairsToV8Array(recommendations);
-		
-		info.GetReturnValue().Set(result);
 	}
+
+	static NAN_METHOD(GetRatingPrediction) {
+		int rowIndex = info[0]->IsNumber() ? info[0]->IntegerValue() : -1;
+		int colIndex = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+		RatingModelObject::Run(info, RatingModelWorker::PREDICTION, rowIndex, colIndex, 2);
+	}
+
+	static NAN_METHOD(GetGlobalBaselineRatingPrediction) {
+		int rowIndex = info[0]->IsNumber() ? info[0]->IntegerValue() : -1;
+		int colIndex = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+		RatingModelObject::Run(info, RatingModelWorker::BASELINE, rowIndex, colIndex, 2);
+	}
+
+	static NAN_METHOD(GetTopCFRecommendations) {
+		int rowIndex = info[0]->IsNumber() ? info[0]->IntegerValue() : -1;
+		RatingModelObject::Run(info, RatingModelWorker::TOP_CF, rowIndex, -1, 1);
+	}
+
+	static NAN_METHOD(GetHybridRecommendations) {
+		int rowIndex = info[0]->IsNumber() ? info[0]->IntegerValue() : -1;
+		RatingModelObject::Run(info, RatingModelWorker::HYBRID, rowIndex, -1, 1);
+	}
+
+	static NAN_METHOD(GetGlobalBaselineRecommendations) {
+		int rowIndex = info[0]->IsNumber() ? info[0]->IntegerValue() : -1;
+		RatingModelObject::Run(info, RatingModelWorker::BASELINE_TOP, rowIndex, -1, 1);
+	}
+
+	static NAN_METHOD(Save) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		if (!info[0]->IsString()) return Nan::ThrowError("Invalid path passed");
+		if (!object->model->get()->save(getStringParameter(0, info))) return Nan::ThrowError("Could not write model file");
+	}
+
+	static NAN_METHOD(GetMemoryUsage) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		MemoryUsage usage = object->model->get()->getMemoryUsage();
+		size_t deltaBytes = object->delta->getBytes();
+		usage.heapBytes += deltaBytes;
+		usage.add("delta", deltaBytes);
+		info.GetReturnValue().Set(convertMemoryUsageToV8Object(usage));
+	}
+
+	// Adds ratings, as {id, itemId, rating}, which queries read right away. A
+	// rating of 0 removes one. Once mergeThreshold ratings are pending they
+	// are merged into a new version of the model on the pool. Returns the
+	// number of pending ratings.
+	static NAN_METHOD(AddRatings) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		if (!info[0]->IsArray()) return Nan::ThrowError("Invalid ratings passed");
+
+		Local<Array> ratings = info[0].As<Array>();
+		Local<String> idProp = Nan::New<String>("id").ToLocalChecked();
+		Local<String> itemIdProp = Nan::New<String>("itemId").ToLocalChecked();
+		Local<String> ratingProp = Nan::New<String>("rating").ToLocalChecked();
+		vector<pair<pair<int, int>, double>> cells;
+		for (unsigned i = 0; i < ratings->Length(); i++) {
+			Local<Value> value = Nan::Get(ratings, i).ToLocalChecked();
+			if (!value->IsObject()) return Nan::ThrowError("Invalid ratings passed");
+			Local<Object> cell = value.As<Object>();
+			Local<Value> id = Nan::Get(cell, idProp).ToLocalChecked();
+			Local<Value> itemId = Nan::Get(cell, itemIdProp).ToLocalChecked();
+			Local<Value> rating = Nan::Get(cell, ratingProp).ToLocalChecked();
+			if (!id->IsNumber() || id->IntegerValue() < 0 || !itemId->IsNumber() || itemId->IntegerValue() < 0 || !rating->IsNumber() ||
+				!isfinite(rating->NumberValue())) {
+				return Nan::ThrowError("Invalid ratings passed");
+			}
+			cells.push_back(make_pair(make_pair(id->IntegerValue(), itemId->IntegerValue()), rating->NumberValue()));
+		}
+		for (const pair<pair<int, int>, double> &cell : cells) object->delta->set(cell.first.first, cell.first.second, cell.second);
+
+		size_t pending = object->delta->size();
+		if ((int)pending >= object->mergeThreshold) RatingModelObject::QueueMerge(object, NULL, info);
+		info.GetReturnValue().Set(Nan::New<Number>(object->delta->size()));
+	}
+
+	// Merges the pending ratings now or, with a callback, on the pool. Returns
+	// or calls back with true if a new version was published, and false if no
+	// ratings were pending, a merge was running, the model didn't fit in the
+	// memory budget or an update made later was applied first.
+	static NAN_METHOD(Merge) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		if (info[0]->IsFunction()) return RatingModelObject::QueueMerge(object, new Callback(info[0].As<Function>()), info);
+
+		shared_ptr<const DeltaRows> rows;
+		if (!object->delta->startMerge(rows)) return info.GetReturnValue().Set(Nan::False());
+		uint64_t version = object->model->reserve();
+		shared_ptr<const ShardedRatingModel> model = make_shared<const ShardedRatingModel>(*object->model->get(), *rows);
+		bool published = model->isValid() && object->model->publish(model, version);
+		object->delta->finishMerge(published);
+		if (published) object->ReportMemory();
+		info.GetReturnValue().Set(Nan::New<Boolean>(published));
+	}
+
+	// Starts a merge on the pool, which calls back with false right away when
+	// there is nothing to merge or a merge is running.
+	static void QueueMerge(RatingModelObject *object, Callback *callback, NAN_METHOD_ARGS_TYPE info) {
+		shared_ptr<const DeltaRows> rows;
+		if (!object->delta->startMerge(rows)) {
+			if (!callback) return;
+			Local<Value> argv[] = { Nan::False() };
+			callback->Call(1, argv);
+			delete callback;
+			return;
+		}
+
+		ModelMergeWorker *worker = new ModelMergeWorker(callback, object->model, object->delta, rows, [object]() { object->ReportMemory(); });
+		worker->SaveToPersistent("holder", info.Holder());
+		PoolQueue::Queue(worker, WorkerPool::BATCH);
+	}
+
+	// Replaces the model as Corpus#update replaces a corpus. The ratings which
+	// were added but not merged yet are dropped with the old ratings.
+	static NAN_METHOD(Update) {
+		RatingModelObject *object = ObjectWrap::Unwrap<RatingModelObject>(info.Holder());
+		Build build;
+		if (info[0]->IsString()) {
+			string path = getStringParameter(0, info);
+			build = [path]() { return make_shared<const ShardedRatingModel>(ModelImage::open(path)); };
+		} else {
+			string error = RatingModelObject::ParseBuild(info, build);
+			if (!error.empty()) return Nan::ThrowError(error.c_str());
+		}
+
+		object->delta->clear();
+		runModelUpdate(object->model, build, [object]() { object->ReportMemory(); }, info);
+	}
+
+	// Maps a file written by save, as Corpus.load does.
+	static NAN_METHOD(Load) {
+		if (!info[0]->IsString()) return Nan::ThrowError("Invalid path passed");
+		shared_ptr<const ShardedRatingModel> model = make_shared<const ShardedRatingModel>(ModelImage::open(getStringParameter(0, info)));
+		if (!model->isValid()) return Nan::ThrowError("Invalid model file passed");
+
+		Local<Value> argv[] = { Nan::New<External>(&model) };
+		info.GetReturnValue().Set(Nan::NewInstance(info.Data().As<Function>(), 1, argv).ToLocalChecked());
+	}
+};
+
+// Merges the search results of corpora which are parts of a larger one, such
+// as the corpora of several processes searched with the same stats.
+NAN_METHOD(MergeSearchResults) {
+	if (!info[0]->IsArray()) return Nan::ThrowError("Invalid results passed");
+	Local<Array> lists = Local<Array>::Cast(info[0]);
+	vector<vector<pair<int, double>>> hits(lists->Length());
+	for (unsigned i = 0; i < lists->Length(); i++) {
+		if (!castV8ArrayToHits(Nan::Get(lists, i).ToLocalChecked(), hits[i])) return Nan::ThrowError("Invalid results passed");
+	}
+	int limit = info[1]->IsNumber() ? info[1]->IntegerValue() : -1;
+
+	info.GetReturnValue().Set(convertHitsToV8Array(ShardedCorpus::mergeHits(hits, limit)));
+}
+
+NAN_METHOD(Configure) {
+	if (!info[0]->IsObject()) return Nan::ThrowError("Invalid options passed");
+
+	Local<Object> obj = Local<Object>::Cast(info[0]);
+	Local<Value> threads = obj->Get(Nan::New<String>("threads").ToLocalChecked());
+	if (!threads->IsUndefined()) {
+		if (!threads->IsNumber() || threads->IntegerValue() < 1) return Nan::ThrowError("Invalid threads option passed");
+		WorkerPool::getInstance().resize(threads->IntegerValue());
+	}
+
+	Local<Value> cacheSize = obj->Get(Nan::New<String>("cacheSize").ToLocalChecked());
+	if (!cacheSize->IsUndefined()) {
+		if (!cacheSize->IsNumber() || cacheSize->NumberValue() < 0) return Nan::ThrowError("Invalid cacheSize option passed");
+		ResultCache::getInstance().setBudget(cacheSize->NumberValue());
+	}
+
+	Local<Value> fileCacheSize = obj->Get(Nan::New<String>("fileCacheSize").ToLocalChecked());
+	if (!fileCacheSize->IsUndefined()) {
+		if (!fileCacheSize->IsNumber() || fileCacheSize->NumberValue() < 0) return Nan::ThrowError("Invalid fileCacheSize option passed");
+		FileCache::getInstance().setBudget(fileCacheSize->NumberValue());
+	}
+
+	Local<Value> memoryBudget = obj->Get(Nan::New<String>("memoryBudget").ToLocalChecked());
+	if (!memoryBudget->IsUndefined()) {
+		if (!memoryBudget->IsNumber() || memoryBudget->NumberValue() < 0) return Nan::ThrowError("Invalid memoryBudget option passed");
+		MemoryBudget::getInstance().setLimit(memoryBudget->NumberValue());
+	}
+
+	Local<Value> stats = obj->Get(Nan::New<String>("stats").ToLocalChecked());
+	if (!stats->IsUndefined()) {
+		if (!stats->IsBoolean()) return Nan::ThrowError("Invalid stats option passed");
+		Stats::getInstance().setEnabled(stats->BooleanValue());
+	}
+
+	Local<Value> trace = obj->Get(Nan::New<String>("trace").ToLocalChecked());
+	if (!trace->IsUndefined()) {
+		if (trace->IsString()) {
+			if (!Trace::getInstance().start(getStringValue(trace))) return Nan::ThrowError("Could not write trace file");
+		} else if (trace->IsBoolean() && !trace->BooleanValue()) {
+			if (!Trace::getInstance().stop()) return Nan::ThrowError("Could not write trace file");
+		} else {
+			return Nan::ThrowError("Invalid trace option passed");
+		}
+	}
+}
+
+NAN_METHOD(GetStats) {
+	Stats &stats = Stats::getInstance();
+	Local<Object> result = Nan::New<Object>();
+	Nan::Set(result, Nan::New<String>("enabled").ToLocalChecked(), Nan::New<Boolean>(stats.isEnabled()));
+
+	Local<Array> bounds = New<v8::Array>(Stats::HISTOGRAM_SIZE - 1);
+	for (int i = 0; i < Stats::HISTOGRAM_SIZE - 1; i++) {
+		Nan::Set(bounds, i, Nan::New<Number>(Stats::getBucketBound(i)));
+	}
+	Nan::Set(result, Nan::New<String>("histogramBoundsNs").ToLocalChecked(), bounds);
+
+	Local<Object> phases = Nan::New<Object>();
+	for (int i = 0; i < Stats::PHASES_SIZE; i++) {
+		Stats::Phase phase = (Stats::Phase)i;
+		Local<Object> phaseStats = Nan::New<Object>();
+		Nan::Set(phaseStats, Nan::New<String>("calls").ToLocalChecked(), Nan::New<Number>(stats.getCalls(phase)));
+		Nan::Set(phaseStats, Nan::New<String>("totalNs").ToLocalChecked(), Nan::New<Number>(stats.getTotalNanoseconds(phase)));
+		Local<Array> histogram = New<v8::Array>(Stats::HISTOGRAM_SIZE);
+		for (int j = 0; j < Stats::HISTOGRAM_SIZE; j++) {
+			Nan::Set(histogram, j, Nan::New<Number>(stats.getBucket(phase, j)));
+		}
+		Nan::Set(phaseStats, Nan::New<String>("histogram").ToLocalChecked(), histogram);
+		Nan::Set(phases, Nan::New<String>(Stats::getPhaseName(phase)).ToLocalChecked(), phaseStats);
+	}
+	Nan::Set(result, Nan::New<String>("phases").ToLocalChecked(), phases);
+
+	Local<Object> counters = Nan::New<Object>();
+	for (int i = 0; i < Stats::COUNTERS_SIZE; i++) {
+		Stats::Counter counter = (Stats::Counter)i;
+		Nan::Set(counters, Nan::New<String>(Stats::getCounterName(counter)).ToLocalChecked(), Nan::New<Number>(stats.getCounter(counter)));
+	}
+	ResultCache &cache = ResultCache::getInstance();
+	Nan::Set(counters, Nan::New<String>("cacheHits").ToLocalChecked(), Nan::New<Number>(cache.getHits()));
+	Nan::Set(counters, Nan::New<String>("cacheMisses").ToLocalChecked(), Nan::New<Number>(cache.getMisses()));
+	Nan::Set(counters, Nan::New<String>("cacheEntries").ToLocalChecked(), Nan::New<Number>(cache.getEntries()));
+	Nan::Set(counters, Nan::New<String>("cacheBytes").ToLocalChecked(), Nan::New<Number>(cache.getBytes()));
+	FileCache &fileCache = FileCache::getInstance();
+	Nan::Set(counters, Nan::New<String>("fileCacheHits").ToLocalChecked(), Nan::New<Number>(fileCache.getHits()));
+	Nan::Set(counters, Nan::New<String>("fileCacheMisses").ToLocalChecked(), Nan::New<Number>(fileCache.getMisses()));
+	Nan::Set(counters, Nan::New<String>("fileCacheEntries").ToLocalChecked(), Nan::New<Number>(fileCache.getEntries()));
+	Nan::Set(counters, Nan::New<String>("fileCacheBytes").ToLocalChecked(), Nan::New<Number>(fileCache.getBytes()));
+	Nan::Set(counters, Nan::New<String>("modelBytes").ToLocalChecked(),
+		Nan::New<Number>(MemoryBudget::getInstance().getBytes(MemoryBudget::MODELS)));
+	Nan::Set(counters, Nan::New<String>("queuePending").ToLocalChecked(), Nan::New<Number>(WorkerPool::getInstance().pending()));
+	Nan::Set(result, Nan::New<String>("counters").ToLocalChecked(), counters);
+
+	info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(ResetStats) {
+	Stats::getInstance().reset();
+	ResultCache::getInstance().resetCounters();
+	FileCache::getInstance().resetCounters();
+}
+
+// The bytes all models and caches of the process hold on the heap, which are
+// those counted against the memoryBudget.
+NAN_METHOD(GetMemoryUsage) {
+	MemoryBudget &budget = MemoryBudget::getInstance();
+	Local<Object> result = Nan::New<Object>();
+	Local<Object> components = Nan::New<Object>();
+	for (int i = 0; i < MemoryBudget::COMPONENTS_SIZE; i++) {
+		MemoryBudget::Component component = (MemoryBudget::Component)i;
+		Nan::Set(components, Nan::New<String>(MemoryBudget::getComponentName(component)).ToLocalChecked(),
+			Nan::New<Number>(budget.getBytes(component)));
+	}
+	Nan::Set(result, Nan::New<String>("heapBytes").ToLocalChecked(), Nan::New<Number>(budget.getBytes()));
+	Nan::Set(result, Nan::New<String>("memoryBudget").ToLocalChecked(), Nan::New<Number>(budget.getLimit()));
+	Nan::Set(result, Nan::New<String>("components").ToLocalChecked(), components);
+
+	info.GetReturnValue().Set(result);
 }
 
 NAN_MODULE_INIT(Init) {
@@ -300,6 +1528,28 @@ NAN_MODULE_INIT(Init) {
 		GetFunction(New<FunctionTemplate>(GetGlobalBaselineRatingPrediction)).ToLocalChecked());
 	Nan::Set(target, New<String>("getTopCFRecommendations").ToLocalChecked(),
 		GetFunction(New<FunctionTemplate>(GetTopCFRecommendations)).ToLocalChecked());
+	Nan::Set(target, New<String>("getHybridRecommendations").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetHybridRecommendations)).ToLocalChecked());
+	Nan::Set(target, New<String>("getGlobalBaselineRecommendations").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetGlobalBaselineRecommendations)).ToLocalChecked());
+	Nan::Set(target, New<String>("getBinaryRecommendations").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetBinaryRecommendations)).ToLocalChecked());
+	Nan::Set(target, New<String>("evaluate").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(Evaluate)).ToLocalChecked());
+	Nan::Set(target, New<String>("getAllTopCFRecommendations").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetAllTopCFRecommendations)).ToLocalChecked());
+	Nan::Set(target, New<String>("configure").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(Configure)).ToLocalChecked());
+	Nan::Set(target, New<String>("stats").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetStats)).ToLocalChecked());
+	Nan::Set(target, New<String>("resetStats").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(ResetStats)).ToLocalChecked());
+	Nan::Set(target, New<String>("memoryUsage").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(GetMemoryUsage)).ToLocalChecked());
+	Nan::Set(target, New<String>("mergeSearchResults").ToLocalChecked(),
+		GetFunction(New<FunctionTemplate>(MergeSearchResults)).ToLocalChecked());
+	CorpusObject::Init(target);
+	RatingModelObject::Init(target);
 }
 
-NODE_MODULE(recommender_addon, Init)
\ No newline at end of file
+NAN_MODULE_WORKER_ENABLED(recommender_addon, Init)
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdint.h>
+#include "../include/Arena.h"
+#include "../include/Constants.h"
+#include "../include/Stats.h"
+
+using namespace std;
+
+Arena &Arena::getLocal() {
+	static thread_local Arena arena;
+	return arena;
+}
+
+// Chunks which are too small for the allocation are skipped. They are used
+// again once the scope which skipped them ends. Without a scope nothing would
+// ever take the memory back, so it comes from the heap instead.
+void *Arena::allocate(size_t size, size_t alignment) {
+	if (this->depth == 0) return ::operator new(size);
+
+	for (; this->chunk < this->chunks.size(); this->chunk++, this->offset = 0) {
+		uintptr_t base = (uintptr_t)this->chunks[this->chunk].bytes.get();
+		size_t start = ((base + this->offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+		if (start + size <= this->chunks[this->chunk].size) {
+			this->offset = start + size;
+			return this->chunks[this->chunk].bytes.get() + start;
+		}
+	}
+
+	Chunk chunk;
+	chunk.size = max((size_t)ARENA_CHUNK_BYTES, size + alignment);
+	chunk.bytes.reset(new char[chunk.size]);
+	Stats::getInstance().add(Stats::ARENA_CHUNKS);
+	this->chunks.push_back(move(chunk));
+	this->chunk = this->chunks.size() - 1;
+	this->offset = 0;
+
+	return this->allocate(size, alignment);
+}
+
+// Only the last allocation is taken back, which lets a vector which grows
+// reuse its old storage. Memory which isn't in any chunk came from the heap.
+void Arena::deallocate(void *pointer, size_t size) {
+	if (this->chunk < this->chunks.size()) {
+		char *bytes = this->chunks[this->chunk].bytes.get();
+		if ((char *)pointer + size == bytes + this->offset && (char *)pointer >= bytes) {
+			this->offset -= size;
+			return;
+		}
+	}
+	if (!this->contains(pointer)) ::operator delete(pointer);
+}
+
+bool Arena::contains(const void *pointer) const {
+	for (const Chunk &chunk : this->chunks) {
+		const char *bytes = chunk.bytes.get();
+		if ((const char *)pointer >= bytes && (const char *)pointer < bytes + chunk.size) return true;
+	}
+
+	return false;
+}
+
+Arena::Mark Arena::enter() {
+	this->depth++;
+	Mark mark = { this->chunk, this->offset };
+	return mark;
+}
+
+void Arena::leave(Mark mark) {
+	this->chunk = mark.chunk;
+	this->offset = mark.offset;
+	if (--this->depth > 0) return;
+
+	size_t retained = 0;
+	size_t chunksSize = 0;
+	while (chunksSize < this->chunks.size() && retained + this->chunks[chunksSize].size <= ARENA_RETAINED_BYTES) {
+		retained += this->chunks[chunksSize++].size;
+	}
+	// The chunk of the mark is kept when memory from before the scope is
+	// still in it.
+	size_t used = this->offset ? this->chunk + 1 : this->chunk;
+	if (chunksSize < this->chunks.size()) this->chunks.resize(max(chunksSize, used));
+}
+
+size_t Arena::getCapacity() const {
+	size_t capacity = 0;
+	for (const Chunk &chunk : this->chunks) capacity += chunk.size;
+
+	return capacity;
+}
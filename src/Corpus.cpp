@@ -0,0 +1,346 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <math.h>
+#include "../include/Corpus.h"
+#include "../include/Utils.h"
+#include "../include/Stats.h"
+#include "../include/Constants.h"
+
+using namespace std;
+
+void CorpusStats::merge(const CorpusStats &other) {
+	this->documents += other.documents;
+	this->words += other.words;
+	for (auto const &entry : other.documentFrequencies) {
+		this->documentFrequencies[entry.first] += entry.second;
+	}
+}
+
+// Layout, with offsets relative to the header: the header, the terms, the
+// index of every term's first block and one past the last, the document
+// frequency of every term, the blocks of all terms in term order and their
+// packed words, the highest count and shortest length of every term's
+// postings, and the id and length of every document.
+vector<char> Corpus::build(const vector<int> &ids, const vector<const string *> &documents, bool useStopWords, CorpusStats &stats) {
+	struct TermPostings {
+		vector<int32_t> documents;
+		vector<int32_t> counts;
+	};
+
+	int documentsSize = documents.size();
+	map<string, TermPostings> postings;
+	vector<int32_t> lengths(documentsSize);
+	for (int i = 0; i < documentsSize; i++) {
+		vector<string> words;
+		{
+			StatsTimer timer(Stats::TOKENIZE);
+			words = Utils::splitLineToWords(*documents[i], useStopWords);
+		}
+
+		map<string, int> counts;
+		for (const string &word : words) counts[word]++;
+		for (auto const &entry : counts) {
+			TermPostings &termPostings = postings[entry.first];
+			termPostings.documents.push_back(i);
+			termPostings.counts.push_back(entry.second);
+			stats.documentFrequencies[entry.first]++;
+		}
+		lengths[i] = words.size();
+		stats.words += words.size();
+	}
+	stats.documents += documentsSize;
+
+	vector<string> terms;
+	vector<uint64_t> blockOffsets(1, 0);
+	vector<int32_t> documentFrequencies;
+	vector<PostingBlock> blocks;
+	vector<uint32_t> postingWords;
+	vector<int32_t> maxCounts;
+	vector<int32_t> minLengths;
+	double words = 0;
+	for (int i = 0; i < documentsSize; i++) words += lengths[i];
+	for (auto const &entry : postings) {
+		const TermPostings &termPostings = entry.second;
+		terms.push_back(entry.first);
+		PostingList::encode(termPostings.documents, termPostings.counts, blocks, postingWords);
+		blockOffsets.push_back(blocks.size());
+		documentFrequencies.push_back(termPostings.documents.size());
+
+		int32_t maxCount = 0;
+		int32_t minLength = INT32_MAX;
+		int postingsSize = termPostings.documents.size();
+		for (int i = 0; i < postingsSize; i++) {
+			maxCount = max(maxCount, termPostings.counts[i]);
+			minLength = min(minLength, lengths[termPostings.documents[i]]);
+		}
+		maxCounts.push_back(maxCount);
+		minLengths.push_back(minLength);
+	}
+	vector<int32_t> flatIds(ids.begin(), ids.end());
+
+	ImageWriter writer;
+	uint64_t header = writer.reserve(sizeof(Header));
+	uint64_t termsOffset = StringTable::write(writer, terms);
+	uint64_t blockOffsetsOffset = writer.add(blockOffsets);
+	uint64_t documentFrequenciesOffset = writer.add(documentFrequencies);
+	uint64_t blocksOffset = writer.add(blocks);
+	uint64_t postingWordsOffset = writer.add(postingWords);
+	uint64_t maxCountsOffset = writer.add(maxCounts);
+	uint64_t minLengthsOffset = writer.add(minLengths);
+	uint64_t idsOffset = writer.add(flatIds);
+	uint64_t lengthsOffset = writer.add(lengths);
+
+	Header *section = writer.at<Header>(header);
+	section->documents = documentsSize;
+	section->words = words;
+	section->terms = termsOffset - header;
+	section->blockOffsets = blockOffsetsOffset - header;
+	section->documentFrequencies = documentFrequenciesOffset - header;
+	section->blocks = blocksOffset - header;
+	section->postingWords = postingWordsOffset - header;
+	section->postingWordsSize = postingWords.size();
+	section->maxCounts = maxCountsOffset - header;
+	section->minLengths = minLengthsOffset - header;
+	section->ids = idsOffset - header;
+	section->lengths = lengthsOffset - header;
+
+	return writer.getBytes();
+}
+
+bool Corpus::read(const ModelImage &image, uint64_t offset) {
+	const Header *header = image.get<Header>(offset, 1);
+	if (!header || header->documents < 0) return false;
+	if (!this->terms.read(image, offset + header->terms)) return false;
+
+	int termsSize = this->terms.getSize();
+	this->blockOffsets = image.get<uint64_t>(offset + header->blockOffsets, termsSize + 1);
+	if (!this->blockOffsets) return false;
+	this->documentFrequencies = image.get<int32_t>(offset + header->documentFrequencies, termsSize);
+	this->blocks = image.get<PostingBlock>(offset + header->blocks, this->blockOffsets[termsSize]);
+	this->postingWords = image.get<uint32_t>(offset + header->postingWords, header->postingWordsSize);
+	if (!this->blocks || !this->postingWords) return false;
+	// The blocks are decoded without checks, so their words must be in the
+	// image.
+	for (uint64_t i = 0; i < this->blockOffsets[termsSize]; i++) {
+		const PostingBlock &block = this->blocks[i];
+		if (block.documentBits > 32 || block.countBits > 32 || block.size > PostingList::BLOCK_SIZE) return false;
+		uint64_t packedSize = PostingList::getPackedSize(block.documentBits) + PostingList::getPackedSize(block.countBits);
+		if (block.offset > header->postingWordsSize || packedSize > header->postingWordsSize - block.offset) return false;
+	}
+	this->maxCounts = image.get<int32_t>(offset + header->maxCounts, termsSize);
+	this->minLengths = image.get<int32_t>(offset + header->minLengths, termsSize);
+	this->ids = image.get<int32_t>(offset + header->ids, header->documents);
+	this->lengths = image.get<int32_t>(offset + header->lengths, header->documents);
+	this->postingWordsSize = header->postingWordsSize;
+	this->documents = header->documents;
+	this->words = header->words;
+
+	return this->documentFrequencies && this->maxCounts && this->minLengths && this->ids && this->lengths;
+}
+
+// The skip pointers, document frequencies and score bounds of the terms are
+// counted with the postings, since they are only read to walk them.
+void Corpus::addMemoryUsage(MemoryUsage &usage) const {
+	size_t termsSize = this->terms.getSize();
+	usage.add("terms", this->terms.getBytes());
+	usage.add("postings", (termsSize + 1) * sizeof(uint64_t) + termsSize * 3 * sizeof(int32_t) +
+		this->blockOffsets[termsSize] * sizeof(PostingBlock) + this->postingWordsSize * sizeof(uint32_t));
+	usage.add("documents", (size_t)this->documents * 2 * sizeof(int32_t));
+}
+
+CorpusStats Corpus::getStats() const {
+	CorpusStats stats;
+	stats.documents = this->documents;
+	stats.words = this->words;
+	int termsSize = this->terms.getSize();
+	for (int i = 0; i < termsSize; i++) {
+		stats.documentFrequencies[this->terms.get(i)] = this->documentFrequencies[i];
+	}
+
+	return stats;
+}
+
+// Only documents which contain a query term are scored, by walking the
+// postings of the query terms. Every document's dot product and norm are summed
+// in the order of the query terms, as Recommender::recommend sums them, so the
+// scores are the same. Returns the (id, score) of the best limit documents, or
+// of all matching documents when limit is -1.
+vector<pair<int, double>> Corpus::search(const vector<QueryTerm> &terms, int documents, int limit) const {
+	StatsTimer timer(Stats::SIMILARITY);
+	vector<pair<int, double>> hits;
+	double queryNorm = 0;
+	for (const QueryTerm &term : terms) queryNorm += term.weight * term.weight;
+
+	vector<double> dotProducts(this->documents, 0);
+	vector<double> norms(this->documents, 0);
+	vector<int> matches;
+	for (const QueryTerm &term : terms) {
+		int termIndex = this->terms.find(term.term);
+		if (termIndex == -1) continue;
+
+		PostingCursor cursor = this->getPostings(termIndex);
+		for (; !cursor.isDone(); cursor.next()) {
+			int document = cursor.getDocument();
+			double tfidf = Corpus::calculateTfIdf(cursor.getCount(), this->lengths[document], term.documentFrequency, documents);
+			if (norms[document] == 0) matches.push_back(document);
+			dotProducts[document] += term.weight * tfidf;
+			norms[document] += tfidf * tfidf;
+		}
+	}
+
+	for (int document : matches) {
+		double similarity = dotProducts[document] / (sqrt(queryNorm) * sqrt(norms[document]));
+		hits.push_back(make_pair(this->ids[document], similarity));
+	}
+	Corpus::sortHits(hits, limit);
+
+	return hits;
+}
+
+// Document at a time BM25 with MaxScore pruning. The terms are ordered by the
+// upper bounds of their scores. Once the best limit documents are found, the
+// terms with the lowest bounds whose bounds add up to less than the worst of
+// them can't bring a document in on their own: documents are only taken from
+// the postings of the other terms, and the postings of these are skipped to the
+// document by their block skip pointers, and not at all if the document can't
+// reach the worst score any more. A document is only pruned when its bound is
+// below the worst score, so ties are broken by id as without pruning. The
+// scores of documents which are kept are added in query term order, so they
+// don't depend on the pruning. With limit -1 nothing is pruned.
+vector<pair<int, double>> Corpus::searchBm25(const vector<QueryTerm> &terms, double averageLength, int limit) const {
+	StatsTimer timer(Stats::SIMILARITY);
+	struct Cursor {
+		PostingCursor postings;
+		int queryTerm;
+		double upperBound;
+	};
+	struct compareHits {
+		inline bool operator() (const pair<int, double>& a, const pair<int, double>& b) {
+			return a.second > b.second || (a.second == b.second && a.first < b.first);
+		}
+	};
+
+	int termsSize = terms.size();
+	vector<Cursor> cursors;
+	for (int i = 0; i < termsSize; i++) {
+		int termIndex = this->terms.find(terms[i].term);
+		if (termIndex == -1) continue;
+
+		Cursor cursor;
+		cursor.postings = this->getPostings(termIndex);
+		cursor.queryTerm = i;
+		cursor.upperBound = Corpus::calculateBm25(terms[i].weight, this->maxCounts[termIndex], this->minLengths[termIndex], averageLength) *
+			(1 + BM25_BOUND_SLACK);
+		cursors.push_back(cursor);
+	}
+	sort(cursors.begin(), cursors.end(), [](const Cursor &a, const Cursor &b) { return a.upperBound < b.upperBound; });
+
+	// bounds[i] is the sum of the upper bounds of cursors 0 to i.
+	int cursorsSize = cursors.size();
+	vector<double> bounds(cursorsSize);
+	for (int i = 0; i < cursorsSize; i++) bounds[i] = cursors[i].upperBound + (i ? bounds[i - 1] : 0);
+
+	// The best documents so far, with the worst on top.
+	vector<pair<int, double>> hits;
+	vector<double> scores(termsSize, 0);
+	double threshold = 0;
+	bool full = false;
+	int essential = 0;
+	while (true) {
+		int document = INT32_MAX;
+		for (int i = essential; i < cursorsSize; i++) {
+			if (!cursors[i].postings.isDone() && cursors[i].postings.getDocument() < document) document = cursors[i].postings.getDocument();
+		}
+		if (document == INT32_MAX) break;
+
+		double score = 0;
+		int length = this->lengths[document];
+		for (int i = essential; i < cursorsSize; i++) {
+			Cursor &cursor = cursors[i];
+			if (cursor.postings.isDone() || cursor.postings.getDocument() != document) continue;
+			scores[cursor.queryTerm] = Corpus::calculateBm25(terms[cursor.queryTerm].weight, cursor.postings.getCount(), length, averageLength);
+			score += scores[cursor.queryTerm];
+			cursor.postings.next();
+		}
+
+		bool pruned = false;
+		for (int i = essential - 1; i >= 0; i--) {
+			if (score + bounds[i] < threshold) {
+				pruned = true;
+				break;
+			}
+
+			Cursor &cursor = cursors[i];
+			cursor.postings.advance(document);
+			if (cursor.postings.isDone() || cursor.postings.getDocument() != document) continue;
+			scores[cursor.queryTerm] = Corpus::calculateBm25(terms[cursor.queryTerm].weight, cursor.postings.getCount(), length, averageLength);
+			score += scores[cursor.queryTerm];
+			cursor.postings.next();
+		}
+
+		if (!pruned) {
+			score = 0;
+			for (int i = 0; i < termsSize; i++) score += scores[i];
+			pair<int, double> hit = make_pair(this->ids[document], score);
+			if (!full) {
+				hits.push_back(hit);
+				push_heap(hits.begin(), hits.end(), compareHits());
+			} else if (compareHits()(hit, hits.front())) {
+				pop_heap(hits.begin(), hits.end(), compareHits());
+				hits.back() = hit;
+				push_heap(hits.begin(), hits.end(), compareHits());
+			}
+
+			if (limit >= 0 && (int)hits.size() >= limit) {
+				full = true;
+				threshold = hits.front().second;
+				while (essential < cursorsSize && bounds[essential] < threshold) essential++;
+			}
+		}
+		for (int i = 0; i < termsSize; i++) scores[i] = 0;
+	}
+	Corpus::sortHits(hits, limit);
+
+	return hits;
+}
+
+// Best first and by id among equal scores, so the hits of several shards
+// merge into the same order as those of one corpus.
+void Corpus::sortHits(vector<pair<int, double>> &hits, int limit) {
+	StatsTimer timer(Stats::SORT);
+	struct compareHits {
+		inline bool operator() (const pair<int, double>& a, const pair<int, double>& b) {
+			return a.second > b.second || (a.second == b.second && a.first < b.first);
+		}
+	};
+
+	if (limit >= 0 && limit < (int)hits.size()) {
+		partial_sort(hits.begin(), hits.begin() + limit, hits.end(), compareHits());
+		hits.erase(hits.begin() + limit, hits.end());
+		return;
+	}
+
+	sort(hits.begin(), hits.end(), compareHits());
+}
+
+// The idf of Lucene's BM25, which is never negative.
+double Corpus::calculateBm25Idf(int documentFrequency, int documents) {
+	return log(1 + (documents - documentFrequency + 0.5) / (documentFrequency + 0.5));
+}
+
+double Corpus::calculateBm25(double weight, int count, int length, double averageLength) {
+	double norm = 1 - BM25_B + BM25_B * (averageLength > 0 ? length / averageLength : 0);
+	return weight * count * (BM25_K1 + 1) / (count + BM25_K1 * norm);
+}
+
+double Corpus::calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, int documentFrequency, int documents) {
+	double totalDocumentsSize = documents;
+	double tf = numberOfTimesTermAppears / (double)totalNumberOfTerms;
+	double idf = log(totalDocumentsSize / (double)documentFrequency);
+	idf++;
+	double tfidf = tf * idf;
+
+	return tfidf;
+}
@@ -0,0 +1,285 @@
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <math.h>
+#include <stdint.h>
+#include "../include/Evaluation.h"
+#include "../include/Constants.h"
+#include "../include/Utils.h"
+#include "../include/Parallel.h"
+#include "../include/Arena.h"
+#include "../include/Trace.h"
+#include "../include/Stats.h"
+#include "../include/RatingIndex.h"
+
+using namespace std;
+
+namespace {
+
+// Fisher-Yates on the raw output of the engine, which the standard fixes, so
+// a seed gives the same split with every standard library.
+void shuffle(vector<int> &values, mt19937_64 &random) {
+	for (int i = (int)values.size() - 1; i > 0; i--) swap(values[i], values[random() % (i + 1)]);
+}
+
+void addError(double prediction, double rating, double &squaredError, double &absoluteError, int &predictions) {
+	if (isnan(prediction) || isinf(prediction)) return;
+	double error = prediction - rating;
+	squaredError += error * error;
+	absoluteError += fabs(error);
+	predictions++;
+}
+
+}
+
+template <typename T>
+EvaluationResult Evaluator::evaluate(const vector<vector<double>> &ratings, int threads) {
+	TraceSpan span("evaluate");
+	EvaluationResult result;
+	int folds = 0;
+	vector<int> cellFolds = this->getFolds(ratings, folds);
+	result.folds = folds;
+
+	int rows = ratings.size();
+	bool topCF = this->options.predictor == PREDICTOR_TOP_CF;
+	double squaredError = 0;
+	double absoluteError = 0;
+	double precision = 0;
+	double recall = 0;
+	for (int fold = 0; fold < folds; fold++) {
+		if (this->recommender.isCancelled()) break;
+
+		vector<vector<double>> trainRows(ratings);
+		vector<UserRatings> tests(rows);
+		int cell = 0;
+		for (int i = 0; i < rows; i++) {
+			int rowSize = ratings[i].size();
+			for (int j = 0; j < rowSize; j++) {
+				if (ratings[i][j] == 0 || cellFolds[cell++] != fold) continue;
+				trainRows[i][j] = 0;
+				tests[i].push_back(make_pair(j, ratings[i][j]));
+			}
+		}
+		vector<int> users;
+		for (int i = 0; i < rows; i++) {
+			if (!tests[i].empty()) users.push_back(i);
+		}
+
+		Fold<T> state;
+		this->buildFold(trainRows, threads, state);
+		trainRows.clear();
+
+		int usersSize = users.size();
+		vector<UserResult> userResults(usersSize);
+		parallelFor(0, usersSize, threads, [&](int i) {
+			if (this->recommender.isCancelled()) return;
+			if (topCF) this->predictTopCF(state, users[i], tests[users[i]], userResults[i]);
+			else this->predictRatings(state, users[i], tests[users[i]], userResults[i]);
+		});
+
+		for (int i = 0; i < usersSize; i++) {
+			const UserResult &userResult = userResults[i];
+			result.testRatings += tests[users[i]].size();
+			if (topCF) {
+				if (!userResult.relevant) continue;
+				precision += userResult.precision;
+				recall += userResult.recall;
+			} else {
+				squaredError += userResult.squaredError;
+				absoluteError += userResult.absoluteError;
+				result.predictions += userResult.predictions;
+			}
+			result.users++;
+		}
+	}
+
+	if (topCF && result.users) {
+		result.precision = precision / result.users;
+		result.recall = recall / result.users;
+	} else if (!topCF && result.predictions) {
+		result.rmse = sqrt(squaredError / result.predictions);
+		result.mae = absoluteError / result.predictions;
+	}
+
+	return result;
+}
+
+// The fold every rating is tested in, in row major order of the ratings, or
+// -1 for ratings which are only trained on. Users with leaveOut ratings or
+// fewer have none held out, since nothing would be left to predict from.
+vector<int> Evaluator::getFolds(const vector<vector<double>> &ratings, int &folds) const {
+	mt19937_64 random(this->options.seed);
+	int rows = ratings.size();
+	vector<int> offsets(1, 0);
+	for (int i = 0; i < rows; i++) {
+		int count = 0;
+		for (double rating : ratings[i]) count += rating != 0;
+		offsets.push_back(offsets.back() + count);
+	}
+
+	int size = offsets[rows];
+	vector<int> cellFolds(size, -1);
+	folds = 1;
+	if (this->options.split == SPLIT_LEAVE_K_OUT) {
+		for (int i = 0; i < rows; i++) {
+			int count = offsets[i + 1] - offsets[i];
+			if (count <= this->options.leaveOut) continue;
+			vector<int> positions(count);
+			for (int j = 0; j < count; j++) positions[j] = offsets[i] + j;
+			shuffle(positions, random);
+			for (int j = 0; j < this->options.leaveOut; j++) cellFolds[positions[j]] = 0;
+		}
+		return cellFolds;
+	}
+
+	vector<int> positions(size);
+	for (int i = 0; i < size; i++) positions[i] = i;
+	shuffle(positions, random);
+	if (this->options.split == SPLIT_K_FOLD) {
+		folds = this->options.folds;
+		for (int i = 0; i < size; i++) cellFolds[positions[i]] = i % folds;
+	} else {
+		int testSize = (int)llround(this->options.testShare * size);
+		for (int i = 0; i < testSize; i++) cellFolds[positions[i]] = 0;
+	}
+
+	return cellFolds;
+}
+
+// The index is only built for the predictors which use neighbourhoods, and
+// the means only for the global baseline.
+template <typename T>
+void Evaluator::buildFold(const vector<vector<double>> &trainRows, int threads, Fold<T> &fold) {
+	fold.train = RatingMatrix<T>::fromRows(trainRows);
+	const RatingMatrix<T> &train = fold.train;
+	int rows = train.getRows();
+	int cols = train.getCols();
+	fold.mean = NAN;
+	if (this->options.predictor == PREDICTOR_GLOBAL_BASELINE) {
+		fold.colMeans.resize(cols);
+		fold.mean = this->recommender.getColMeans(train, fold.colMeans.data());
+		return;
+	}
+
+	fold.index = RatingIndex::build(train);
+	if (this->options.predictor == PREDICTOR_TOP_CF) fold.ratedItems = RatedItems::build(train, fold.ratedOffsets, fold.ratedItemsList);
+	fold.norms.resize(rows);
+	parallelFor(0, rows, threads, [&](int i) {
+		fold.norms[i] = Utils::getCenteredNorm(train.getRow(i), cols, train.getScale());
+	});
+}
+
+// The similarities of the row to the other rows of the fold, as getSimilarities
+// computes them, leaving out those which are 0. The dot products are added up
+// from the postings of the row's items in item order, which for double and
+// uint8 storage gives the same sums as a walk over the whole rows.
+template <typename T>
+Recommender::Neighbourhood Evaluator::getNeighbourhood(const Fold<T> &fold, int rowIndex, double normA) {
+	StatsTimer timer(Stats::SIMILARITY);
+	const RatingMatrix<T> &train = fold.train;
+	int rows = train.getRows();
+	int cols = train.getCols();
+	double scale = train.getScale();
+	const T *row = train.getRow(rowIndex);
+	ScratchVector<double> dotProducts(rows, 0);
+	ScratchVector<int> coRatings(rows, 0);
+	for (int j = 0; j < cols; j++) {
+		if (row[j] == 0) continue;
+		const int *raters = fold.index.getRows(j);
+		int ratersSize = fold.index.getRowsSize(j);
+		for (int k = 0; k < ratersSize; k++) {
+			dotProducts[raters[k]] += (double)row[j] * train.getRow(raters[k])[j];
+			coRatings[raters[k]]++;
+		}
+	}
+
+	Recommender::Neighbourhood similarities;
+	int minCoRatings = max(1, this->recommender.minCoRatings);
+	for (int i = 0; i < rows; i++) {
+		if (i == rowIndex || coRatings[i] < minCoRatings) continue;
+		double similarity = Utils::calculateCosineSimilarity(dotProducts[i] * scale * scale, normA, fold.norms[i]);
+		if (similarity != 0) similarities.push_back(make_pair(i, similarity));
+	}
+
+	return similarities;
+}
+
+// Predicts the test ratings as getRatingPrediction or
+// getGlobalBaselineRatingPrediction would on the training matrix, from the
+// similarities or means computed once for the user. A rating is predicted from
+// the postings of its item, the neighbours who rated it. Ratings which can't
+// be predicted, of items no neighbour rated or nobody rated, are left out.
+template <typename T>
+void Evaluator::predictRatings(const Fold<T> &fold, int rowIndex, const UserRatings &test, UserResult &result) {
+	const RatingMatrix<T> &train = fold.train;
+	const T *row = train.getRow(rowIndex);
+	int cols = train.getCols();
+	double scale = train.getScale();
+	int testSize = test.size();
+	if (this->options.predictor == PREDICTOR_GLOBAL_BASELINE) {
+		double mean = fold.mean;
+		double rowMean = Utils::getRawMean(row, cols, scale);
+		for (int i = 0; i < testSize; i++) {
+			double colMean = test[i].first < cols ? fold.colMeans[test[i].first] : NAN;
+			double prediction = fabs(mean + (colMean - mean) + (rowMean - mean));
+			addError(prediction, test[i].second, result.squaredError, result.absoluteError, result.predictions);
+		}
+		return;
+	}
+
+	ArenaScope scope;
+	double normA = Utils::calculateDotProduct(row, row, cols) * scale * scale;
+	Recommender::Neighbourhood neighbourhood = this->getNeighbourhood(fold, rowIndex, normA);
+	ScratchVector<double> similarities(train.getRows(), 0);
+	for (const pair<int, double> &neighbour : neighbourhood) similarities[neighbour.first] = neighbour.second;
+
+	StatsTimer timer(Stats::PREDICT);
+	for (int i = 0; i < testSize; i++) {
+		int item = test[i].first;
+		if (item >= cols) continue;
+		double ratingsSum = 0;
+		double similaritiesSum = 0;
+		const int *raters = fold.index.getRows(item);
+		int ratersSize = fold.index.getRowsSize(item);
+		for (int k = 0; k < ratersSize; k++) {
+			double similarity = similarities[raters[k]];
+			ratingsSum += train.get(raters[k], item) * similarity;
+			similaritiesSum += similarity;
+		}
+		addError(ratingsSum / similaritiesSum, test[i].second, result.squaredError, result.absoluteError, result.predictions);
+	}
+}
+
+// Precision is the share of the cutoff top CF recommendations which are
+// relevant test items, and recall the share of the relevant test items which
+// are among them. The recommendations are those of getTopCFRecommendations,
+// predicted from the rated items of the neighbours.
+template <typename T>
+void Evaluator::predictTopCF(const Fold<T> &fold, int rowIndex, const UserRatings &test, UserResult &result) {
+	vector<int> relevant;
+	for (const pair<int, double> &rating : test) {
+		if (rating.second >= this->options.relevantRating) relevant.push_back(rating.first);
+	}
+	if (relevant.empty()) return;
+	sort(relevant.begin(), relevant.end());
+
+	ArenaScope scope;
+	const RatingMatrix<T> &train = fold.train;
+	double normA = Utils::getCenteredNorm(train.getRow(rowIndex), train.getCols(), train.getScale());
+	Recommender::Neighbourhood neighbourhood = this->getNeighbourhood(fold, rowIndex, normA);
+	this->recommender.sortNeighbourhood(neighbourhood);
+	vector<pair<int, double>> recommendations = this->recommender.predictTopCF(train, rowIndex, neighbourhood, this->options.cutoff, -1,
+		&fold.ratedItems);
+	int hits = 0;
+	for (const pair<int, double> &recommendation : recommendations) {
+		if (binary_search(relevant.begin(), relevant.end(), recommendation.first)) hits++;
+	}
+
+	result.relevant = true;
+	result.precision = hits / (double)this->options.cutoff;
+	result.recall = hits / (double)relevant.size();
+}
+
+template EvaluationResult Evaluator::evaluate<double>(const vector<vector<double>> &ratings, int threads);
+template EvaluationResult Evaluator::evaluate<float>(const vector<vector<double>> &ratings, int threads);
+template EvaluationResult Evaluator::evaluate<uint8_t>(const vector<vector<double>> &ratings, int threads);
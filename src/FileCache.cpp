@@ -0,0 +1,174 @@
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include "../include/FileCache.h"
+#include "../include/MemoryBudget.h"
+#include "../include/Constants.h"
+#include "../include/Utils.h"
+
+using namespace std;
+
+namespace {
+
+shared_ptr<const ParsedFile> parseFile(const string &path, bool useStopWords, size_t &bytes) {
+	ifstream stream(path);
+	if (!stream.good()) return NULL;
+
+	shared_ptr<ParsedFile> file = make_shared<ParsedFile>();
+	bytes = sizeof(ParsedFile);
+	string line;
+	while (getline(stream, line)) {
+		file->words.push_back(Utils::splitLineToWords(line, useStopWords));
+		bytes += sizeof(string) + line.size() + sizeof(vector<string>);
+		for (const string &word : file->words.back()) bytes += sizeof(string) + word.size();
+		file->lines.push_back(move(line));
+	}
+
+	return file;
+}
+
+}
+
+FileCache& FileCache::getInstance() {
+	static FileCache instance;
+	return instance;
+}
+
+FileCache::FileCache() : budget(FILE_CACHE_BYTES), bytes(0), hits(0), misses(0) {
+	MemoryBudget::getInstance().addEvictor([this](size_t bytes) { return this->shrink(bytes); });
+}
+
+void FileCache::setBudget(size_t budget) {
+	lock_guard<mutex> guard(this->lock);
+	this->budget = budget;
+	this->evict(budget);
+}
+
+// The file is read without holding the lock, so calls for other files aren't
+// held up. Calls which miss on the same file at once each read it.
+shared_ptr<const ParsedFile> FileCache::get(const string &path, bool useStopWords) {
+	string key = to_string(useStopWords) + "|" + path;
+	string fileKey;
+	size_t fileSize;
+	bool identified = Utils::getFileKey(path, fileKey, fileSize);
+	{
+		lock_guard<mutex> guard(this->lock);
+		if (identified && this->budget > 0) {
+			unordered_map<string, list<Entry>::iterator>::iterator found = this->index.find(key);
+			if (found != this->index.end() && found->second->fileKey == fileKey) {
+				this->entries.splice(this->entries.begin(), this->entries, found->second);
+				this->hits++;
+				return found->second->file;
+			}
+			this->misses++;
+		}
+	}
+
+	size_t bytes = 0;
+	shared_ptr<const ParsedFile> file = parseFile(path, useStopWords, bytes);
+	// The key was taken before the file was read, so a file which changes
+	// while it is read gets another key next time and is read again.
+	if (file && identified) {
+		lock_guard<mutex> guard(this->lock);
+		this->put(key, fileKey, file, bytes);
+	}
+
+	return file;
+}
+
+void FileCache::clear() {
+	lock_guard<mutex> guard(this->lock);
+	this->evict(0);
+}
+
+void FileCache::resetCounters() {
+	lock_guard<mutex> guard(this->lock);
+	this->hits = 0;
+	this->misses = 0;
+}
+
+size_t FileCache::getBudget() {
+	lock_guard<mutex> guard(this->lock);
+	return this->budget;
+}
+
+size_t FileCache::getBytes() {
+	lock_guard<mutex> guard(this->lock);
+	return this->bytes;
+}
+
+size_t FileCache::getEntries() {
+	lock_guard<mutex> guard(this->lock);
+	return this->entries.size();
+}
+
+size_t FileCache::getHits() {
+	lock_guard<mutex> guard(this->lock);
+	return this->hits;
+}
+
+size_t FileCache::getMisses() {
+	lock_guard<mutex> guard(this->lock);
+	return this->misses;
+}
+
+// Node, map slot, keys and the file.
+void FileCache::put(const string &key, const string &fileKey, const shared_ptr<const ParsedFile> &file, size_t fileBytes) {
+	size_t entryBytes = sizeof(Entry) + 2 * sizeof(void *) + 2 * key.size() + fileKey.size() + 64 + fileBytes;
+	if (entryBytes > this->budget) return;
+
+	unordered_map<string, list<Entry>::iterator>::iterator found = this->index.find(key);
+	if (found != this->index.end()) {
+		this->bytes -= found->second->bytes;
+		MemoryBudget::getInstance().release(found->second->bytes, MemoryBudget::FILE_CACHE);
+		this->entries.erase(found->second);
+		this->index.erase(found);
+	}
+
+	this->evict(this->budget - entryBytes);
+	if (!this->reserve(entryBytes)) return;
+	Entry entry;
+	entry.key = key;
+	entry.fileKey = fileKey;
+	entry.file = file;
+	entry.bytes = entryBytes;
+	this->entries.push_front(entry);
+	this->index[key] = this->entries.begin();
+	this->bytes += entryBytes;
+}
+
+void FileCache::evict(size_t budget) {
+	while (this->bytes > budget && !this->entries.empty()) this->removeLast();
+}
+
+// Evicts the oldest entries for a model which doesn't fit in the MemoryBudget.
+size_t FileCache::shrink(size_t bytes) {
+	lock_guard<mutex> guard(this->lock);
+	size_t before = this->bytes;
+	while (before - this->bytes < bytes && !this->entries.empty()) this->removeLast();
+	return before - this->bytes;
+}
+
+// Reserves an entry in the MemoryBudget, evicting the oldest entries while it
+// doesn't fit. Returns false if it doesn't fit with the cache empty either.
+bool FileCache::reserve(size_t entryBytes) {
+	MemoryBudget &budget = MemoryBudget::getInstance();
+	while (!budget.reserve(entryBytes, MemoryBudget::FILE_CACHE)) {
+		if (this->entries.empty()) return false;
+		this->removeLast();
+	}
+
+	return true;
+}
+
+void FileCache::removeLast() {
+	Entry &last = this->entries.back();
+	this->bytes -= last.bytes;
+	MemoryBudget::getInstance().release(last.bytes, MemoryBudget::FILE_CACHE);
+	this->index.erase(last.key);
+	this->entries.pop_back();
+}
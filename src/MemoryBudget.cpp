@@ -0,0 +1,108 @@
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "../include/MemoryBudget.h"
+
+using namespace std;
+
+MemoryBudget& MemoryBudget::getInstance() {
+	static MemoryBudget instance;
+	return instance;
+}
+
+const char *MemoryBudget::getComponentName(Component component) {
+	static const char *names[COMPONENTS_SIZE] = { "models", "resultCache", "fileCache" };
+	return names[component];
+}
+
+// Models which are already held are not freed by a lower limit, which only
+// keeps new ones from being built until enough of them are gone. Caches are
+// evicted down to the limit right away.
+void MemoryBudget::setLimit(size_t limit) {
+	size_t shortage;
+	{
+		lock_guard<mutex> guard(this->lock);
+		this->limit = limit;
+		shortage = this->getShortage(0);
+	}
+	if (shortage) this->evict(shortage);
+}
+
+size_t MemoryBudget::getLimit() {
+	lock_guard<mutex> guard(this->lock);
+	return this->limit;
+}
+
+size_t MemoryBudget::getBytes() {
+	lock_guard<mutex> guard(this->lock);
+	return this->bytes;
+}
+
+size_t MemoryBudget::getBytes(Component component) {
+	lock_guard<mutex> guard(this->lock);
+	return this->componentBytes[component];
+}
+
+bool MemoryBudget::reserve(size_t bytes, Component component) {
+	if (this->tryReserve(bytes, component)) return true;
+	if (component != MODELS) return false;
+
+	size_t shortage;
+	{
+		lock_guard<mutex> guard(this->lock);
+		if (bytes > this->limit) return false;
+		shortage = this->getShortage(bytes);
+	}
+	this->evict(shortage);
+
+	return this->tryReserve(bytes, component);
+}
+
+void MemoryBudget::release(size_t bytes, Component component) {
+	lock_guard<mutex> guard(this->lock);
+	this->bytes -= bytes;
+	this->componentBytes[component] -= bytes;
+}
+
+void MemoryBudget::addEvictor(function<size_t(size_t)> evictor) {
+	lock_guard<mutex> guard(this->lock);
+	this->evictors.push_back(evictor);
+}
+
+bool MemoryBudget::tryReserve(size_t bytes, Component component) {
+	lock_guard<mutex> guard(this->lock);
+	if (this->limit && (bytes > this->limit || this->bytes > this->limit - bytes)) return false;
+	this->bytes += bytes;
+	this->componentBytes[component] += bytes;
+	return true;
+}
+
+// Bytes which have to be freed for the bytes to fit. Called with the lock held.
+size_t MemoryBudget::getShortage(size_t bytes) {
+	if (!this->limit || this->bytes + bytes <= this->limit) return 0;
+	return this->bytes + bytes - this->limit;
+}
+
+// The caches are evicted in the order they were added, each of them only as
+// far as the others didn't free enough.
+void MemoryBudget::evict(size_t bytes) {
+	vector<function<size_t(size_t)>> evictors;
+	{
+		lock_guard<mutex> guard(this->lock);
+		evictors = this->evictors;
+	}
+
+	for (const function<size_t(size_t)> &evictor : evictors) {
+		size_t freed = evictor(bytes);
+		if (freed >= bytes) return;
+		bytes -= freed;
+	}
+}
+
+bool MemoryReservation::resize(size_t bytes) {
+	MemoryBudget &budget = MemoryBudget::getInstance();
+	if (bytes > this->bytes && !budget.reserve(bytes - this->bytes)) return false;
+	if (bytes < this->bytes) budget.release(this->bytes - bytes);
+	this->bytes = bytes;
+	return true;
+}
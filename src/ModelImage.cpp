@@ -0,0 +1,191 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "../include/ModelImage.h"
+#include "../include/Utils.h"
+
+using namespace std;
+
+namespace {
+
+// A read-only mapping of a whole file, unmapped when the last image which
+// reads it is gone.
+class MappedFile {
+public:
+	const char *data;
+	size_t size;
+
+	MappedFile() : data(NULL), size(0) {};
+
+	~MappedFile() {
+		if (!this->data) return;
+#ifdef _WIN32
+		UnmapViewOfFile(this->data);
+#else
+		munmap((void *)this->data, this->size);
+#endif
+	}
+
+	bool map(const string &path, size_t size) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (!mapping) return false;
+		void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+		CloseHandle(mapping);
+		if (!data) return false;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file == -1) return false;
+		void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+		close(file);
+		if (data == MAP_FAILED) return false;
+#endif
+		this->data = (const char *)data;
+		this->size = size;
+		return true;
+	}
+};
+
+}
+
+ModelImage ModelImage::fromBytes(vector<char> &bytes) {
+	shared_ptr<vector<char>> owned = make_shared<vector<char>>();
+	owned->swap(bytes);
+	// The writer grows its bytes by doubling, and a model keeps them for
+	// its whole life, so more than an eighth of slack is given back.
+	if (owned->capacity() - owned->size() > owned->size() / 8) owned->shrink_to_fit();
+
+	ModelImage image;
+	image.owner = owned;
+	image.data = owned->data();
+	image.size = owned->size();
+	image.heapBytes = owned->capacity();
+	return image;
+}
+
+// The registry holds the mappings weakly, so a file is unmapped once no model
+// reads it any more.
+ModelImage ModelImage::open(const string &path) {
+	static mutex lock;
+	static map<string, weak_ptr<const MappedFile>> mappings;
+
+	ModelImage image;
+	string key;
+	size_t size;
+	if (!Utils::getFileKey(path, key, size) || size == 0) return image;
+
+	lock_guard<mutex> guard(lock);
+	shared_ptr<const MappedFile> mapping = mappings[key].lock();
+	if (!mapping) {
+		shared_ptr<MappedFile> file = make_shared<MappedFile>();
+		if (!file->map(path, size)) {
+			mappings.erase(key);
+			return image;
+		}
+		mapping = file;
+		mappings[key] = mapping;
+	}
+
+	image.owner = mapping;
+	image.data = mapping->data;
+	image.size = mapping->size;
+	return image;
+}
+
+// Writes to a temporary file which then replaces the file at path, so
+// processes which have the old file mapped keep reading it unchanged.
+bool ModelImage::write(const string &path) const {
+	string temporaryPath = path + ".tmp";
+	{
+		ofstream file(temporaryPath.c_str(), ios::binary | ios::trunc);
+		if (!file) return false;
+		file.write(this->data, this->size);
+		if (!file) {
+			remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+	if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+#endif
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Layout: the number of strings, the offsets of the end offsets and of the
+// characters, relative to the table, then the offsets and the characters.
+uint64_t StringTable::write(ImageWriter &writer, const vector<string> &strings) {
+	vector<uint64_t> offsets(1, 0);
+	string chars;
+	for (const string &value : strings) {
+		chars += value;
+		offsets.push_back(chars.size());
+	}
+
+	uint64_t table = writer.reserve(3 * sizeof(uint64_t));
+	uint64_t offsetsOffset = writer.add(offsets);
+	uint64_t charsOffset = writer.add(chars.data(), chars.size());
+	uint64_t *header = writer.at<uint64_t>(table);
+	header[0] = strings.size();
+	header[1] = offsetsOffset - table;
+	header[2] = charsOffset - table;
+
+	return table;
+}
+
+bool StringTable::read(const ModelImage &image, uint64_t offset) {
+	const uint64_t *header = image.get<uint64_t>(offset, 3);
+	if (!header || header[0] > INT32_MAX) return false;
+
+	const uint64_t *offsets = image.get<uint64_t>(offset + header[1], header[0] + 1);
+	if (!offsets) return false;
+	const char *chars = image.get<char>(offset + header[2], offsets[header[0]]);
+	if (!chars) return false;
+	// The strings are read without checks, so the offsets must not decrease
+	// and so stay within the characters.
+	for (uint64_t i = 0; i < header[0]; i++) {
+		if (offsets[i] > offsets[i + 1]) return false;
+	}
+
+	this->size = header[0];
+	this->offsets = offsets;
+	this->chars = chars;
+	return true;
+}
+
+int StringTable::find(const string &value) const {
+	int low = 0;
+	int high = this->size;
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		int comparison = value.compare(0, string::npos, this->chars + this->offsets[middle], this->offsets[middle + 1] - this->offsets[middle]);
+		if (comparison == 0) return middle;
+		if (comparison < 0) high = middle;
+		else low = middle + 1;
+	}
+
+	return -1;
+}
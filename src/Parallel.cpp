@@ -0,0 +1,89 @@
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "../include/Parallel.h"
+#include "../include/WorkerPool.h"
+
+using namespace std;
+
+namespace {
+
+// Set while a thread runs a body, so calls nested in it don't queue helpers.
+thread_local bool inParallelFor = false;
+
+// State of a call which its helpers share. A helper which starts after the
+// call has closed it returns without touching the body, which may be gone.
+struct ParallelState {
+	mutex lock;
+	condition_variable finished;
+	atomic<int> next;
+	int end;
+	const function<void(int)> *body;
+	int running;
+	bool closed;
+	exception_ptr error;
+
+	ParallelState(int begin, int end, const function<void(int)> *body) :
+		next(begin),
+		end(end),
+		body(body),
+		running(0),
+		closed(false) {};
+};
+
+void runIndexes(ParallelState &state) {
+	bool nested = inParallelFor;
+	inParallelFor = true;
+	for (int i = state.next.fetch_add(1); i < state.end; i = state.next.fetch_add(1)) {
+		try {
+			(*state.body)(i);
+		} catch (...) {
+			unique_lock<mutex> guard(state.lock);
+			if (!state.error) state.error = current_exception();
+			state.next = state.end;
+		}
+	}
+	inParallelFor = nested;
+}
+
+}
+
+void parallelFor(int begin, int end, int threads, const function<void(int)> &body) {
+	int count = end - begin;
+	if (count <= 0) return;
+	if (threads > count) threads = count;
+	if (threads > 1 && !inParallelFor) {
+		int poolSize = WorkerPool::getInstance().size();
+		if (threads > poolSize) threads = poolSize;
+	}
+	if (threads <= 1 || inParallelFor) {
+		for (int i = begin; i < end; i++) body(i);
+		return;
+	}
+
+	shared_ptr<ParallelState> state = make_shared<ParallelState>(begin, end, &body);
+	WorkerPool &pool = WorkerPool::getInstance();
+	for (int i = 1; i < threads; i++) {
+		pool.help([state]() {
+			{
+				unique_lock<mutex> guard(state->lock);
+				if (state->closed) return;
+				state->running++;
+			}
+			runIndexes(*state);
+			unique_lock<mutex> guard(state->lock);
+			if (--state->running == 0) state->finished.notify_all();
+		});
+	}
+
+	// The calling thread works through the indexes too, so the call finishes
+	// even when every thread of the pool is busy and no helper starts.
+	runIndexes(*state);
+	unique_lock<mutex> guard(state->lock);
+	state->closed = true;
+	state->finished.wait(guard, [&]() { return state->running == 0; });
+	if (state->error) rethrow_exception(state->error);
+}
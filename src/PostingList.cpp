@@ -0,0 +1,158 @@
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "../include/PostingList.h"
+
+using namespace std;
+
+const int PostingList::BLOCK_SIZE;
+
+namespace {
+
+int getBits(const uint32_t *values, int size) {
+	uint32_t all = 0;
+	for (int i = 0; i < size; i++) all |= values[i];
+
+	int bits = 0;
+	while (bits < 32 && (all >> bits) != 0) bits++;
+	return bits;
+}
+
+}
+
+void PostingList::encode(const vector<int32_t> &documents, const vector<int32_t> &counts, vector<PostingBlock> &blocks,
+	vector<uint32_t> &words) {
+	int postingsSize = documents.size();
+	int32_t previous = -1;
+	for (int start = 0; start < postingsSize; start += BLOCK_SIZE) {
+		int size = min(BLOCK_SIZE, postingsSize - start);
+		uint32_t gaps[BLOCK_SIZE] = { 0 };
+		uint32_t countValues[BLOCK_SIZE] = { 0 };
+		for (int i = 0; i < size; i++) {
+			gaps[i] = documents[start + i] - previous - 1;
+			countValues[i] = counts[start + i] - 1;
+			previous = documents[start + i];
+		}
+
+		PostingBlock block;
+		block.lastDocument = previous;
+		block.documentBits = getBits(gaps, size);
+		block.countBits = getBits(countValues, size);
+		block.size = size;
+		block.offset = words.size();
+		blocks.push_back(block);
+
+		words.resize(words.size() + getPackedSize(block.documentBits) + getPackedSize(block.countBits));
+		uint32_t *packed = words.data() + block.offset;
+		PostingList::pack(gaps, block.documentBits, packed);
+		PostingList::pack(countValues, block.countBits, packed + getPackedSize(block.documentBits));
+	}
+}
+
+// Value i is in lane i % 4 at position i / 4, and word j of lane l is at
+// j * 4 + l.
+void PostingList::pack(const uint32_t *values, int bits, uint32_t *packed) {
+	memset(packed, 0, getPackedSize(bits) * sizeof(uint32_t));
+	if (bits == 0) return;
+
+	for (int k = 0; k < BLOCK_SIZE / 4; k++) {
+		int bit = k * bits;
+		int shift = bit & 31;
+		uint32_t *out = packed + (bit >> 5) * 4;
+		const uint32_t *in = values + k * 4;
+		for (int lane = 0; lane < 4; lane++) {
+			out[lane] |= in[lane] << shift;
+			if (shift + bits > 32) out[lane + 4] |= in[lane] >> (32 - shift);
+		}
+	}
+}
+
+void PostingList::unpack(const uint32_t *packed, int bits, uint32_t *values) {
+	if (bits == 0) {
+		memset(values, 0, BLOCK_SIZE * sizeof(uint32_t));
+		return;
+	}
+
+	uint32_t mask = bits == 32 ? 0xffffffff : (1u << bits) - 1;
+#if defined(__SSE2__)
+	__m128i masks = _mm_set1_epi32(mask);
+	for (int k = 0; k < BLOCK_SIZE / 4; k++) {
+		int bit = k * bits;
+		int shift = bit & 31;
+		const __m128i *in = (const __m128i *)(packed + (bit >> 5) * 4);
+		__m128i lanes = _mm_srl_epi32(_mm_loadu_si128(in), _mm_cvtsi32_si128(shift));
+		if (shift + bits > 32) lanes = _mm_or_si128(lanes, _mm_sll_epi32(_mm_loadu_si128(in + 1), _mm_cvtsi32_si128(32 - shift)));
+		_mm_storeu_si128((__m128i *)(values + k * 4), _mm_and_si128(lanes, masks));
+	}
+#elif defined(__ARM_NEON)
+	uint32x4_t masks = vdupq_n_u32(mask);
+	for (int k = 0; k < BLOCK_SIZE / 4; k++) {
+		int bit = k * bits;
+		int shift = bit & 31;
+		const uint32_t *in = packed + (bit >> 5) * 4;
+		uint32x4_t lanes = vshlq_u32(vld1q_u32(in), vdupq_n_s32(-shift));
+		if (shift + bits > 32) lanes = vorrq_u32(lanes, vshlq_u32(vld1q_u32(in + 4), vdupq_n_s32(32 - shift)));
+		vst1q_u32(values + k * 4, vandq_u32(lanes, masks));
+	}
+#else
+	for (int k = 0; k < BLOCK_SIZE / 4; k++) {
+		int bit = k * bits;
+		int shift = bit & 31;
+		const uint32_t *in = packed + (bit >> 5) * 4;
+		uint32_t *out = values + k * 4;
+		for (int lane = 0; lane < 4; lane++) {
+			uint32_t value = in[lane] >> shift;
+			if (shift + bits > 32) value |= in[lane + 4] << (32 - shift);
+			out[lane] = value & mask;
+		}
+	}
+#endif
+}
+
+PostingCursor::PostingCursor(const PostingBlock *begin, const PostingBlock *end, const uint32_t *words) :
+	begin(begin),
+	block(begin),
+	end(end),
+	words(words),
+	position(0),
+	size(0) {
+	if (this->block != this->end) this->decode();
+}
+
+void PostingCursor::advance(int32_t target) {
+	if (this->isDone() || this->documents[this->position] >= target) return;
+
+	if (this->block->lastDocument < target) {
+		do {
+			this->block++;
+		} while (this->block != this->end && this->block->lastDocument < target);
+		if (this->block == this->end) {
+			this->position = this->size;
+			return;
+		}
+		this->decode();
+	}
+
+	// The block ends with target or a later document.
+	while (this->documents[this->position] < target) this->position++;
+}
+
+void PostingCursor::decode() {
+	const uint32_t *packed = this->words + this->block->offset;
+	PostingList::unpack(packed, this->block->documentBits, (uint32_t *)this->documents);
+	PostingList::unpack(packed + PostingList::getPackedSize(this->block->documentBits), this->block->countBits, (uint32_t *)this->counts);
+
+	this->size = this->block->size;
+	int32_t previous = this->block == this->begin ? -1 : (this->block - 1)->lastDocument;
+	for (int i = 0; i < this->size; i++) {
+		previous += this->documents[i] + 1;
+		this->documents[i] = previous;
+	}
+	for (int i = 0; i < this->size; i++) this->counts[i]++;
+	this->position = 0;
+}
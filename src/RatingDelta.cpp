@@ -0,0 +1,103 @@
+#include <map>
+#include <memory>
+#include <mutex>
+#include "../include/RatingDelta.h"
+
+using namespace std;
+
+namespace {
+
+// A node of a map: the value, the links and the color.
+const size_t CELL_BYTES = sizeof(pair<const int, double>) + 4 * sizeof(void *);
+const size_t ROW_BYTES = sizeof(pair<const int, map<int, double>>) + 4 * sizeof(void *);
+
+}
+
+void RatingDelta::set(int id, int item, double rating) {
+	lock_guard<mutex> guard(this->lock);
+	map<int, double> &row = this->pending[id];
+	if (row.insert(make_pair(item, rating)).second) this->pendingSize++;
+	else row[item] = rating;
+	this->view.reset();
+}
+
+void RatingDelta::clear() {
+	lock_guard<mutex> guard(this->lock);
+	this->pending.clear();
+	this->pendingSize = 0;
+	this->merging.reset();
+	this->mergingSize = 0;
+	this->view.reset();
+	this->generation++;
+}
+
+shared_ptr<const DeltaRows> RatingDelta::get() {
+	lock_guard<mutex> guard(this->lock);
+	if (this->view) return this->view;
+
+	shared_ptr<DeltaRows> rows = this->merging ? make_shared<DeltaRows>(*this->merging) : make_shared<DeltaRows>();
+	for (const pair<const int, map<int, double>> &row : this->pending) {
+		map<int, double> &cells = (*rows)[row.first];
+		for (const pair<const int, double> &cell : row.second) cells[cell.first] = cell.second;
+	}
+	this->view = rows;
+
+	return this->view;
+}
+
+bool RatingDelta::startMerge(shared_ptr<const DeltaRows> &rows) {
+	lock_guard<mutex> guard(this->lock);
+	if (this->running || !this->pendingSize) return false;
+
+	shared_ptr<DeltaRows> merging = make_shared<DeltaRows>();
+	merging->swap(this->pending);
+	this->merging = merging;
+	this->mergingSize = this->pendingSize;
+	this->pendingSize = 0;
+	this->running = true;
+	this->mergeGeneration = this->generation;
+	rows = this->merging;
+
+	return true;
+}
+
+// The ratings of a merge which couldn't publish go back under those which
+// were added while it ran, unless the model was replaced since it started.
+void RatingDelta::finishMerge(bool merged) {
+	lock_guard<mutex> guard(this->lock);
+	if (!this->running) return;
+
+	if (!merged && this->merging && this->mergeGeneration == this->generation) {
+		for (const pair<const int, map<int, double>> &row : *this->merging) {
+			map<int, double> &cells = this->pending[row.first];
+			for (const pair<const int, double> &cell : row.second) {
+				if (cells.insert(cell).second) this->pendingSize++;
+			}
+		}
+	}
+	this->merging.reset();
+	this->mergingSize = 0;
+	this->running = false;
+	this->view.reset();
+}
+
+size_t RatingDelta::size() {
+	lock_guard<mutex> guard(this->lock);
+	return this->pendingSize;
+}
+
+bool RatingDelta::isMerging() {
+	lock_guard<mutex> guard(this->lock);
+	return this->running;
+}
+
+// The pending and merging ratings, and the copy readers share.
+size_t RatingDelta::getBytes() {
+	lock_guard<mutex> guard(this->lock);
+	size_t bytes = this->pending.size() * ROW_BYTES + this->pendingSize * CELL_BYTES;
+	if (this->merging) bytes += this->merging->size() * ROW_BYTES + this->mergingSize * CELL_BYTES;
+	if (!this->view) return bytes;
+
+	for (const pair<const int, map<int, double>> &row : *this->view) bytes += ROW_BYTES + row.second.size() * CELL_BYTES;
+	return bytes;
+}
@@ -0,0 +1,164 @@
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "../include/RatingModel.h"
+
+using namespace std;
+
+void RatingStats::add(const double *row, int cols) {
+	if ((int)this->colSums.size() < cols) {
+		this->colSums.resize(cols, 0);
+		this->colCounts.resize(cols, 0);
+	}
+	for (int i = 0; i < cols; i++) {
+		if (row[i] == 0) continue;
+		this->sum += row[i];
+		this->count++;
+		this->colSums[i] += row[i];
+		this->colCounts[i]++;
+	}
+}
+
+void RatingStats::merge(const RatingStats &other) {
+	int otherSize = other.colSums.size();
+	if ((int)this->colSums.size() < otherSize) {
+		this->colSums.resize(otherSize, 0);
+		this->colCounts.resize(otherSize, 0);
+	}
+	this->sum += other.sum;
+	this->count += other.count;
+	for (int i = 0; i < otherSize; i++) {
+		this->colSums[i] += other.colSums[i];
+		this->colCounts[i] += other.colCounts[i];
+	}
+}
+
+// Layout, with offsets relative to the header: the header, the ratings row by
+// row, the sums and counts of every item, the (id, row) of every row sorted by
+// id, and the offsets and items of the rated items of every row.
+vector<char> RatingModel::build(const vector<const vector<double> *> &rows, const vector<int> &ids, int cols) {
+	int rowsSize = rows.size();
+	RatingMatrix<double> ratings(rowsSize, cols);
+	RatingStats stats;
+	stats.colSums.resize(cols, 0);
+	stats.colCounts.resize(cols, 0);
+	vector<RowId> rowIds(rowsSize);
+	for (int i = 0; i < rowsSize; i++) {
+		int rowSize = min((int)rows[i]->size(), cols);
+		for (int j = 0; j < rowSize; j++) ratings.set(i, j, (*rows[i])[j]);
+		stats.add(ratings.getRow(i), cols);
+		rowIds[i].id = ids[i];
+		rowIds[i].row = i;
+	}
+	// Of rows with the same id the last one is found.
+	sort(rowIds.begin(), rowIds.end(), [](const RowId &a, const RowId &b) { return a.id < b.id || (a.id == b.id && a.row > b.row); });
+
+	ImageWriter writer;
+	uint64_t header = writer.reserve(sizeof(Header));
+	uint64_t valuesOffset = writer.add(ratings.getValues(), (size_t)rowsSize * cols);
+	uint64_t colSumsOffset = writer.add(stats.colSums);
+	uint64_t colCountsOffset = writer.add(stats.colCounts);
+	uint64_t rowIdsOffset = writer.add(rowIds);
+	vector<uint64_t> ratedOffsets;
+	vector<int32_t> ratedItems;
+	RatedItems::build(ratings, ratedOffsets, ratedItems);
+	uint64_t ratedOffsetsOffset = writer.add(ratedOffsets);
+	uint64_t ratedItemsOffset = writer.add(ratedItems);
+
+	Header *section = writer.at<Header>(header);
+	section->rows = rowsSize;
+	section->cols = cols;
+	section->sum = stats.sum;
+	section->count = stats.count;
+	section->values = valuesOffset - header;
+	section->colSums = colSumsOffset - header;
+	section->colCounts = colCountsOffset - header;
+	section->rowIds = rowIdsOffset - header;
+	section->ratedOffsets = ratedOffsetsOffset - header;
+	section->ratedItems = ratedItemsOffset - header;
+
+	return writer.getBytes();
+}
+
+bool RatingModel::read(const ModelImage &image, uint64_t offset) {
+	const Header *header = image.get<Header>(offset, 1);
+	if (!header || header->rows < 0 || header->cols < 0) return false;
+
+	const double *values = image.get<double>(offset + header->values, (uint64_t)header->rows * header->cols);
+	this->colSums = image.get<double>(offset + header->colSums, header->cols);
+	this->colCounts = image.get<double>(offset + header->colCounts, header->cols);
+	this->rowIds = image.get<RowId>(offset + header->rowIds, header->rows);
+	const uint64_t *ratedOffsets = image.get<uint64_t>(offset + header->ratedOffsets, (uint64_t)header->rows + 1);
+	if (!values || !this->colSums || !this->colCounts || !this->rowIds || !ratedOffsets) return false;
+	const int32_t *ratedItems = image.get<int32_t>(offset + header->ratedItems, ratedOffsets[header->rows]);
+	if (!ratedItems) return false;
+
+	this->ratings = RatingMatrix<double>::view(values, header->rows, header->cols);
+	this->ratedItems = RatedItems(ratedOffsets, ratedItems);
+	this->ratedItemsSize = ratedOffsets[header->rows];
+	this->sum = header->sum;
+	this->count = header->count;
+	return true;
+}
+
+RatingStats RatingModel::getStats() const {
+	RatingStats stats;
+	int cols = this->getCols();
+	stats.sum = this->sum;
+	stats.count = this->count;
+	stats.colSums.assign(this->colSums, this->colSums + cols);
+	stats.colCounts.assign(this->colCounts, this->colCounts + cols);
+
+	return stats;
+}
+
+void RatingModel::addMemoryUsage(MemoryUsage &usage) const {
+	usage.add("matrix", this->ratings.getBytes());
+	usage.add("index", (size_t)this->size() * (sizeof(RowId) + sizeof(uint64_t)) + sizeof(uint64_t) + this->ratedItemsSize * sizeof(int32_t));
+	usage.add("stats", (size_t)this->getCols() * 2 * sizeof(double));
+}
+
+const double *RatingModel::getRow(int id) const {
+	int rowIndex = this->getRowIndex(id);
+	if (rowIndex == -1) return NULL;
+
+	return this->ratings.getRow(rowIndex);
+}
+
+void RatingModel::copyRows(const DeltaRows &delta, int cols, vector<vector<double>> &rows, vector<int> &ids) const {
+	int rowsSize = this->size();
+	int modelCols = this->getCols();
+	size_t first = rows.size();
+	rows.resize(first + rowsSize);
+	ids.resize(first + rowsSize);
+	for (int i = 0; i < rowsSize; i++) ids[first + this->rowIds[i].row] = this->rowIds[i].id;
+	for (int i = 0; i < rowsSize; i++) {
+		const double *row = this->ratings.getRow(i);
+		vector<double> &copy = rows[first + i];
+		copy.assign(row, row + modelCols);
+		copy.resize(cols, 0);
+		DeltaRows::const_iterator cells = delta.find(ids[first + i]);
+		if (cells == delta.end()) continue;
+		for (const pair<const int, double> &cell : cells->second) {
+			if (cell.first >= 0 && cell.first < cols) copy[cell.first] = cell.second;
+		}
+	}
+}
+
+int RatingModel::getTopCFSums(Recommender &recommender, const double *row, int id, vector<double> &ratingsSums, double &similaritiesSum,
+	double *ratersCounts) const {
+	if (!this->size()) return 0;
+	return recommender.getTopCFSums(this->ratings, row, this->getRowIndex(id), ratingsSums, similaritiesSum, ratersCounts, &this->ratedItems);
+}
+
+int RatingModel::getRatingPredictionSums(Recommender &recommender, const double *row, int id, int colIndex,
+	double &ratingsSum, double &similaritiesSum) const {
+	if (!this->size()) return 0;
+	return recommender.getRatingPredictionSums(this->ratings, row, this->getRowIndex(id), colIndex, ratingsSum, similaritiesSum);
+}
+
+int RatingModel::getRowIndex(int id) const {
+	const RowId *end = this->rowIds + this->size();
+	const RowId *rowId = lower_bound(this->rowIds, end, id, [](const RowId &a, int id) { return a.id < id; });
+	return rowId == end || rowId->id != id ? -1 : rowId->row;
+}
@@ -0,0 +1,139 @@
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../include/ResultCache.h"
+#include "../include/MemoryBudget.h"
+
+using namespace std;
+
+ResultCache& ResultCache::getInstance() {
+	static ResultCache instance;
+	return instance;
+}
+
+ResultCache::ResultCache() : budget(0), bytes(0), hits(0), misses(0) {
+	MemoryBudget::getInstance().addEvictor([this](size_t bytes) { return this->shrink(bytes); });
+}
+
+void ResultCache::setBudget(size_t budget) {
+	lock_guard<mutex> guard(this->lock);
+	this->budget = budget;
+	this->evict(budget);
+}
+
+bool ResultCache::isEnabled() {
+	lock_guard<mutex> guard(this->lock);
+	return this->budget > 0;
+}
+
+bool ResultCache::get(const string &key, vector<pair<int, double>> &result) {
+	lock_guard<mutex> guard(this->lock);
+	unordered_map<string, list<Entry>::iterator>::iterator found = this->index.find(key);
+	if (found == this->index.end()) {
+		this->misses++;
+		return false;
+	}
+
+	this->entries.splice(this->entries.begin(), this->entries, found->second);
+	result = found->second->result;
+	this->hits++;
+
+	return true;
+}
+
+void ResultCache::put(const string &key, const vector<pair<int, double>> &result) {
+	// Node, map slot, key and payload.
+	size_t entryBytes = sizeof(Entry) + 2 * sizeof(void *) + 2 * key.size() + 64 +
+		result.size() * sizeof(pair<int, double>);
+
+	lock_guard<mutex> guard(this->lock);
+	if (entryBytes > this->budget) return;
+
+	unordered_map<string, list<Entry>::iterator>::iterator found = this->index.find(key);
+	if (found != this->index.end()) {
+		this->bytes -= found->second->bytes;
+		MemoryBudget::getInstance().release(found->second->bytes, MemoryBudget::RESULT_CACHE);
+		this->entries.erase(found->second);
+		this->index.erase(found);
+	}
+
+	this->evict(this->budget - entryBytes);
+	if (!this->reserve(entryBytes)) return;
+	Entry entry;
+	entry.key = key;
+	entry.result = result;
+	entry.bytes = entryBytes;
+	this->entries.push_front(entry);
+	this->index[key] = this->entries.begin();
+	this->bytes += entryBytes;
+}
+
+void ResultCache::clear() {
+	lock_guard<mutex> guard(this->lock);
+	this->evict(0);
+}
+
+void ResultCache::resetCounters() {
+	lock_guard<mutex> guard(this->lock);
+	this->hits = 0;
+	this->misses = 0;
+}
+
+size_t ResultCache::getBudget() {
+	lock_guard<mutex> guard(this->lock);
+	return this->budget;
+}
+
+size_t ResultCache::getBytes() {
+	lock_guard<mutex> guard(this->lock);
+	return this->bytes;
+}
+
+size_t ResultCache::getEntries() {
+	lock_guard<mutex> guard(this->lock);
+	return this->entries.size();
+}
+
+size_t ResultCache::getHits() {
+	lock_guard<mutex> guard(this->lock);
+	return this->hits;
+}
+
+size_t ResultCache::getMisses() {
+	lock_guard<mutex> guard(this->lock);
+	return this->misses;
+}
+
+void ResultCache::evict(size_t budget) {
+	while (this->bytes > budget && !this->entries.empty()) this->removeLast();
+}
+
+// Evicts the oldest entries for a model which doesn't fit in the MemoryBudget.
+size_t ResultCache::shrink(size_t bytes) {
+	lock_guard<mutex> guard(this->lock);
+	size_t before = this->bytes;
+	while (before - this->bytes < bytes && !this->entries.empty()) this->removeLast();
+	return before - this->bytes;
+}
+
+// Reserves an entry in the MemoryBudget, evicting the oldest entries while it
+// doesn't fit. Returns false if it doesn't fit with the cache empty either.
+bool ResultCache::reserve(size_t entryBytes) {
+	MemoryBudget &budget = MemoryBudget::getInstance();
+	while (!budget.reserve(entryBytes, MemoryBudget::RESULT_CACHE)) {
+		if (this->entries.empty()) return false;
+		this->removeLast();
+	}
+
+	return true;
+}
+
+void ResultCache::removeLast() {
+	Entry &last = this->entries.back();
+	this->bytes -= last.bytes;
+	MemoryBudget::getInstance().release(last.bytes, MemoryBudget::RESULT_CACHE);
+	this->index.erase(last.key);
+	this->entries.pop_back();
+}
@@ -0,0 +1,564 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <math.h>
+#include "../include/Sharding.h"
+#include "../include/Utils.h"
+#include "../include/Parallel.h"
+#include "../include/WorkerPool.h"
+#include "../include/Trace.h"
+
+using namespace std;
+
+int getShardIndex(int id, int position, int size, int shards, ShardPartition partition) {
+	if (partition == PARTITION_HASH) return Utils::hashBytes(&id, sizeof(int)) % shards;
+	return (int)((long long)position * shards / size);
+}
+
+static const char *CORPUS_MAGIC = "RCORPUS";
+static const char *RATING_MODEL_MAGIC = "RRATINGS";
+
+// Without ids the documents get their positions as ids. The shards are built on
+// the threads of the WorkerPool and then written into one image with the
+// document frequencies of the whole corpus. The bytes of the text are reserved
+// before the documents are tokenized, as an estimate of the image, which is
+// usually smaller.
+ShardedCorpus::ShardedCorpus(const vector<string> &documents, const vector<int> &ids, int shards, ShardPartition partition,
+	bool useStopWords) :
+	documents(0),
+	words(0),
+	useStopWords(false),
+	documentFrequencies(NULL) {
+	if (shards < 1) shards = 1;
+	int documentsSize = documents.size();
+	size_t textBytes = 0;
+	for (int i = 0; i < documentsSize; i++) textBytes += documents[i].size();
+	if (!this->reservation.resize(textBytes)) return;
+
+	vector<vector<int>> shardIds(shards);
+	vector<vector<const string *>> shardDocuments(shards);
+	for (int i = 0; i < documentsSize; i++) {
+		int id = ids.empty() ? i : ids[i];
+		int shard = getShardIndex(id, i, documentsSize, shards, partition);
+		shardIds[shard].push_back(id);
+		shardDocuments[shard].push_back(&documents[i]);
+	}
+
+	vector<vector<char>> sections(shards);
+	vector<CorpusStats> shardStats(shards);
+	parallelFor(0, shards, WorkerPool::getInstance().size(), [&](int shard) {
+		sections[shard] = Corpus::build(shardIds[shard], shardDocuments[shard], useStopWords, shardStats[shard]);
+	});
+	CorpusStats stats;
+	for (int i = 0; i < shards; i++) stats.merge(shardStats[i]);
+
+	vector<string> terms;
+	vector<int32_t> documentFrequencies;
+	for (auto const &entry : stats.documentFrequencies) {
+		terms.push_back(entry.first);
+		documentFrequencies.push_back(entry.second);
+	}
+
+	ImageWriter writer;
+	uint64_t header = writer.reserve(sizeof(Header));
+	uint64_t termsOffset = StringTable::write(writer, terms);
+	uint64_t documentFrequenciesOffset = writer.add(documentFrequencies);
+	vector<uint64_t> shardOffsets(shards);
+	for (int i = 0; i < shards; i++) {
+		shardOffsets[i] = writer.append(sections[i]);
+		vector<char>().swap(sections[i]);
+	}
+	uint64_t shardOffsetsOffset = writer.add(shardOffsets);
+
+	Header *image = writer.at<Header>(header);
+	image->image.init(CORPUS_MAGIC);
+	image->shards = shards;
+	image->documents = stats.documents;
+	image->useStopWords = useStopWords;
+	image->words = stats.words;
+	image->terms = termsOffset;
+	image->documentFrequencies = documentFrequenciesOffset;
+	image->shardOffsets = shardOffsetsOffset;
+
+	this->image = ModelImage::fromBytes(writer.getBytes());
+	this->read();
+	this->reserve();
+}
+
+ShardedCorpus::ShardedCorpus(const ModelImage &image) :
+	image(image),
+	documents(0),
+	words(0),
+	useStopWords(false),
+	documentFrequencies(NULL) {
+	this->read();
+	this->reserve();
+}
+
+// Leaves the corpus without shards if the image is not a valid corpus.
+void ShardedCorpus::read() {
+	const Header *header = this->image.get<Header>(0, 1);
+	if (!header || !header->image.isValid(CORPUS_MAGIC) || header->shards < 1) return;
+	if (!this->terms.read(this->image, header->terms)) return;
+	this->documentFrequencies = this->image.get<int32_t>(header->documentFrequencies, this->terms.getSize());
+	const uint64_t *shardOffsets = this->image.get<uint64_t>(header->shardOffsets, header->shards);
+	if (!this->documentFrequencies || !shardOffsets) return;
+
+	vector<Corpus> shards(header->shards);
+	for (int i = 0; i < header->shards; i++) {
+		if (!shards[i].read(this->image, shardOffsets[i])) return;
+	}
+	this->documents = header->documents;
+	this->words = header->words;
+	this->useStopWords = header->useStopWords;
+	this->shards.swap(shards);
+}
+
+// Settles the reservation on the bytes the corpus holds, and leaves it without
+// shards if they don't fit.
+void ShardedCorpus::reserve() {
+	if (this->isValid() && !this->reservation.resize(this->getMemoryUsage().heapBytes)) this->shards.clear();
+}
+
+// The document frequencies of the whole corpus are counted with its terms.
+MemoryUsage ShardedCorpus::getMemoryUsage() const {
+	MemoryUsage usage;
+	usage.heapBytes = this->image.getHeapBytes();
+	if (!usage.heapBytes) usage.mappedBytes = this->image.getSize();
+	usage.add("terms", this->terms.getBytes() + this->terms.getSize() * sizeof(int32_t));
+	for (const Corpus &shard : this->shards) shard.addMemoryUsage(usage);
+
+	return usage;
+}
+
+CorpusStats ShardedCorpus::getStats() const {
+	CorpusStats stats;
+	stats.documents = this->documents;
+	stats.words = this->words;
+	int termsSize = this->terms.getSize();
+	for (int i = 0; i < termsSize; i++) stats.documentFrequencies[this->terms.get(i)] = this->documentFrequencies[i];
+
+	return stats;
+}
+
+int ShardedCorpus::getDocumentFrequency(const string &term, const CorpusStats *stats) const {
+	if (stats) {
+		map<string, int>::const_iterator documentFrequency = stats->documentFrequencies.find(term);
+		return documentFrequency == stats->documentFrequencies.end() ? 0 : documentFrequency->second;
+	}
+
+	int termIndex = this->terms.find(term);
+	return termIndex == -1 ? 0 : this->documentFrequencies[termIndex];
+}
+
+// Scores with the stats passed in when this corpus is part of a larger one.
+// The tf-idf query weights are those of Recommender::tfidf, in term order.
+// Terms which no document contains can't match anything and are left out.
+vector<pair<int, double>> ShardedCorpus::search(const string &query, int limit, int threads, const CorpusStats *stats,
+	CorpusScoring scoring) const {
+	TraceSpan span("search");
+	int documents = stats ? stats->documents : this->documents;
+	double words = stats ? stats->words : this->words;
+	vector<string> queryWords = Utils::splitLineToWords(query, this->useStopWords);
+	int totalNumberOfTerms = queryWords.size();
+	map<string, QueryTerm> queryTerms;
+	for (int i = 0; i < totalNumberOfTerms; i++) {
+		int documentFrequency = this->getDocumentFrequency(queryWords[i], stats);
+		if (documentFrequency == 0) continue;
+
+		QueryTerm &queryTerm = queryTerms[queryWords[i]];
+		queryTerm.term = queryWords[i];
+		queryTerm.documentFrequency = documentFrequency;
+		if (scoring == SCORING_BM25) {
+			queryTerm.weight += Corpus::calculateBm25Idf(documentFrequency, documents);
+		} else {
+			int numberOfTimesTermAppears = count(queryWords.begin(), queryWords.end(), queryWords[i]);
+			queryTerm.weight += Corpus::calculateTfIdf(numberOfTimesTermAppears, totalNumberOfTerms, documentFrequency, documents);
+		}
+	}
+	vector<QueryTerm> terms;
+	for (auto const &entry : queryTerms) terms.push_back(entry.second);
+
+	int shardsSize = this->shards.size();
+	vector<vector<pair<int, double>>> hits(shardsSize);
+	double averageLength = documents ? words / documents : 0;
+	parallelFor(0, shardsSize, threads, [&](int shard) {
+		if (scoring == SCORING_BM25) hits[shard] = this->shards[shard].searchBm25(terms, averageLength, limit);
+		else hits[shard] = this->shards[shard].search(terms, documents, limit);
+	});
+
+	return ShardedCorpus::mergeHits(hits, limit);
+}
+
+// Every list holds the best hits of its shard, so the best limit of all of
+// them are among those.
+vector<pair<int, double>> ShardedCorpus::mergeHits(const vector<vector<pair<int, double>>> &hits, int limit) {
+	vector<pair<int, double>> merged;
+	for (const vector<pair<int, double>> &shardHits : hits) merged.insert(merged.end(), shardHits.begin(), shardHits.end());
+	Corpus::sortHits(merged, limit);
+
+	return merged;
+}
+
+namespace {
+
+// The ratings and the row index of a rating model, reserved before it is
+// built.
+size_t getRatingModelBytes(size_t rows, int cols, size_t rated) {
+	return rows * cols * sizeof(double) + rows * (2 * sizeof(int32_t) + sizeof(uint64_t)) + rated * sizeof(int32_t);
+}
+
+}
+
+// Without ids the rows get their positions as ids. Rows shorter than the
+// longest one are padded with zeros. The ratings and the row index are
+// reserved before anything is built.
+ShardedRatingModel::ShardedRatingModel(const vector<vector<double>> &rows, const vector<int> &ids, int shards, ShardPartition partition) :
+	cols(0) {
+	if (shards < 1) shards = 1;
+	int rowsSize = rows.size();
+	int cols = 0;
+	size_t rated = 0;
+	for (int i = 0; i < rowsSize; i++) {
+		if ((int)rows[i].size() > cols) cols = rows[i].size();
+		for (double rating : rows[i]) rated += rating != 0;
+	}
+	if (!this->reservation.resize(getRatingModelBytes(rowsSize, cols, rated))) return;
+
+	vector<vector<const vector<double> *>> shardRows(shards);
+	vector<vector<int>> shardIds(shards);
+	for (int i = 0; i < rowsSize; i++) {
+		int id = ids.empty() ? i : ids[i];
+		int shard = getShardIndex(id, i, rowsSize, shards, partition);
+		shardRows[shard].push_back(&rows[i]);
+		shardIds[shard].push_back(id);
+	}
+
+	this->build(shardRows, shardIds, cols);
+}
+
+// Rows stay in their shards, and the rows of ids which are not in the model
+// go to the shards with the fewest rows. Items past the last one of the model
+// widen the rows. The delta is reserved as if all its ratings were new.
+ShardedRatingModel::ShardedRatingModel(const ShardedRatingModel &model, const DeltaRows &delta) :
+	cols(0) {
+	if (!model.isValid()) return;
+	int shardsSize = model.shards.size();
+	int cols = model.cols;
+	size_t rows = 0;
+	size_t rated = 0;
+	for (const RatingModel &shard : model.shards) {
+		rows += shard.size();
+		rated += shard.getRatedSize();
+	}
+	for (const pair<const int, map<int, double>> &cells : delta) {
+		if (!model.getRow(cells.first)) rows++;
+		rated += cells.second.size();
+		if (!cells.second.empty()) cols = max(cols, cells.second.rbegin()->first + 1);
+	}
+	if (!this->reservation.resize(getRatingModelBytes(rows, cols, rated))) return;
+
+	vector<vector<vector<double>>> rowsByShard(shardsSize);
+	vector<vector<int>> shardIds(shardsSize);
+	for (int i = 0; i < shardsSize; i++) model.shards[i].copyRows(delta, cols, rowsByShard[i], shardIds[i]);
+	for (const pair<const int, map<int, double>> &cells : delta) {
+		if (model.getRow(cells.first)) continue;
+		int shard = 0;
+		for (int i = 1; i < shardsSize; i++) {
+			if (rowsByShard[i].size() < rowsByShard[shard].size()) shard = i;
+		}
+		vector<double> row(cols, 0);
+		for (const pair<const int, double> &cell : cells.second) {
+			if (cell.first >= 0) row[cell.first] = cell.second;
+		}
+		rowsByShard[shard].push_back(row);
+		shardIds[shard].push_back(cells.first);
+	}
+
+	vector<vector<const vector<double> *>> shardRows(shardsSize);
+	for (int i = 0; i < shardsSize; i++) {
+		for (const vector<double> &row : rowsByShard[i]) shardRows[i].push_back(&row);
+	}
+	this->build(shardRows, shardIds, cols);
+}
+
+ShardedRatingModel::ShardedRatingModel(const ModelImage &image) :
+	image(image),
+	cols(0) {
+	this->read();
+	this->reserve();
+}
+
+// The shards are built on the threads of the WorkerPool and written into one
+// image.
+void ShardedRatingModel::build(const vector<vector<const vector<double> *>> &shardRows, const vector<vector<int>> &shardIds, int cols) {
+	int shards = shardRows.size();
+	vector<vector<char>> sections(shards);
+	parallelFor(0, shards, WorkerPool::getInstance().size(), [&](int shard) {
+		sections[shard] = RatingModel::build(shardRows[shard], shardIds[shard], cols);
+	});
+
+	ImageWriter writer;
+	uint64_t header = writer.reserve(sizeof(Header));
+	vector<uint64_t> shardOffsets(shards);
+	for (int i = 0; i < shards; i++) {
+		shardOffsets[i] = writer.append(sections[i]);
+		vector<char>().swap(sections[i]);
+	}
+	uint64_t shardOffsetsOffset = writer.add(shardOffsets);
+
+	Header *image = writer.at<Header>(header);
+	image->image.init(RATING_MODEL_MAGIC);
+	image->shards = shards;
+	image->cols = cols;
+	image->shardOffsets = shardOffsetsOffset;
+
+	this->image = ModelImage::fromBytes(writer.getBytes());
+	this->read();
+	this->reserve();
+}
+
+// Leaves the model without shards if the image is not a valid rating model.
+// The stats of the shards are merged in shard order, and the items are sorted
+// by their biases once for all global baseline recommendations.
+void ShardedRatingModel::read() {
+	const Header *header = this->image.get<Header>(0, 1);
+	if (!header || !header->image.isValid(RATING_MODEL_MAGIC) || header->shards < 1) return;
+	const uint64_t *shardOffsets = this->image.get<uint64_t>(header->shardOffsets, header->shards);
+	if (!shardOffsets) return;
+
+	vector<RatingModel> shards(header->shards);
+	RatingStats stats;
+	for (int i = 0; i < header->shards; i++) {
+		if (!shards[i].read(this->image, shardOffsets[i]) || shards[i].getCols() != header->cols) return;
+		stats.merge(shards[i].getStats());
+	}
+	vector<double> colMeans(header->cols);
+	for (int i = 0; i < header->cols; i++) colMeans[i] = stats.getColMean(i);
+	this->itemBiases = ItemBiasIndex::build(colMeans.data(), header->cols, stats.getMean());
+	this->cols = header->cols;
+	this->stats = stats;
+	this->shards.swap(shards);
+}
+
+// Settles the reservation as ShardedCorpus::reserve does.
+void ShardedRatingModel::reserve() {
+	if (this->isValid() && !this->reservation.resize(this->getMemoryUsage().heapBytes)) this->shards.clear();
+}
+
+// The merged stats and the item biases are held on the heap even when the image
+// is mapped.
+MemoryUsage ShardedRatingModel::getMemoryUsage() const {
+	MemoryUsage usage;
+	usage.heapBytes = this->image.getHeapBytes();
+	if (!usage.heapBytes) usage.mappedBytes = this->image.getSize();
+	size_t statsBytes = (this->stats.colSums.capacity() + this->stats.colCounts.capacity()) * sizeof(double);
+	usage.heapBytes += statsBytes;
+	usage.add("stats", statsBytes);
+	usage.heapBytes += this->itemBiases.getBytes();
+	usage.add("index", this->itemBiases.getBytes());
+	for (const RatingModel &shard : this->shards) shard.addMemoryUsage(usage);
+
+	return usage;
+}
+
+const double *ShardedRatingModel::getRow(int id) const {
+	for (const RatingModel &shard : this->shards) {
+		const double *row = shard.getRow(id);
+		if (row) return row;
+	}
+
+	return NULL;
+}
+
+// Copies the row of the id with the ratings of the delta applied. Returns
+// false if neither the model nor the delta has the id.
+bool ShardedRatingModel::getRow(int id, const DeltaRows *delta, vector<double> &row) const {
+	const double *modelRow = this->getRow(id);
+	DeltaRows::const_iterator cells = delta ? delta->find(id) : DeltaRows::const_iterator();
+	bool added = delta && cells != delta->end();
+	if (!modelRow && !added) return false;
+
+	if (modelRow) row.assign(modelRow, modelRow + this->cols);
+	else row.assign(this->cols, 0);
+	if (!added) return true;
+
+	for (const pair<const int, double> &cell : cells->second) {
+		if (cell.first >= 0 && cell.first < this->cols) row[cell.first] = cell.second;
+	}
+	return true;
+}
+
+// The rows of the ids of the delta but the id, as the model has them and
+// with the delta applied. Ids which are not in the model only have the
+// latter.
+void ShardedRatingModel::getDeltaRows(const DeltaRows &delta, int id, RatingMatrix<double> &oldRows, RatingMatrix<double> &newRows) const {
+	vector<vector<double>> oldValues;
+	vector<vector<double>> newValues;
+	vector<double> row;
+	for (const pair<const int, map<int, double>> &cells : delta) {
+		if (cells.first == id) continue;
+		const double *modelRow = this->getRow(cells.first);
+		if (modelRow) oldValues.push_back(vector<double>(modelRow, modelRow + this->cols));
+		this->getRow(cells.first, &delta, row);
+		newValues.push_back(row);
+	}
+	oldRows = RatingMatrix<double>::fromRows(oldValues);
+	newRows = RatingMatrix<double>::fromRows(newValues);
+}
+
+vector<pair<int, double>> ShardedRatingModel::getTopCFRecommendations(const Recommender &recommender, int id, int limit, int includeRatedItems,
+	int threads, const DeltaRows *delta) const {
+	TraceSpan span("getTopCFRecommendations");
+	vector<double> row;
+	if (!this->getRow(id, delta, row)) return vector<pair<int, double>>();
+
+	vector<double> ratingsSums;
+	double similaritiesSum = 0;
+	if (!this->getTopCFSums(recommender, row.data(), id, threads, ratingsSums, similaritiesSum, NULL, delta)) return vector<pair<int, double>>();
+
+	Recommender rankRecommender = recommender;
+	return rankRecommender.rankTopCF(row.data(), this->cols, 1.0, ratingsSums.data(), similaritiesSum, limit, includeRatedItems);
+}
+
+// The means of the baseline are those of the merged stats, so only the
+// neighbourhood has to be computed.
+vector<pair<int, double>> ShardedRatingModel::getHybridRecommendations(const Recommender &recommender, int id, int limit, int includeRatedItems,
+	int shrinkage, int threads, const DeltaRows *delta) const {
+	TraceSpan span("getHybridRecommendations");
+	vector<double> row;
+	if (!this->getRow(id, delta, row)) return vector<pair<int, double>>();
+
+	vector<double> ratingsSums;
+	vector<double> ratersCounts;
+	double similaritiesSum = 0;
+	this->getTopCFSums(recommender, row.data(), id, threads, ratingsSums, similaritiesSum, &ratersCounts, delta);
+	vector<double> colMeans(this->cols);
+	for (int i = 0; i < this->cols; i++) colMeans[i] = this->stats.getColMean(i);
+
+	Recommender rankRecommender = recommender;
+	return rankRecommender.rankHybrid(row.data(), this->cols, 1.0, ratingsSums.data(), ratersCounts.data(), similaritiesSum, this->stats.getMean(),
+		colMeans.data(), limit, includeRatedItems, shrinkage);
+}
+
+// Adds up the neighbourhood sums of all shards in shard order, and with
+// ratersCounts the number of neighbours who rated every item. The sums of the
+// rows of the delta are then taken off and those of the rows with the delta
+// applied added. Returns the size of the whole neighbourhood.
+int ShardedRatingModel::getTopCFSums(const Recommender &recommender, const double *row, int id, int threads, vector<double> &ratingsSums,
+	double &similaritiesSum, vector<double> *ratersCounts, const DeltaRows *delta) const {
+	int shardsSize = this->shards.size();
+	vector<vector<double>> shardRatingsSums(shardsSize, vector<double>(this->cols, 0));
+	vector<vector<double>> shardRatersCounts(ratersCounts ? shardsSize : 0, vector<double>(this->cols, 0));
+	vector<double> similaritiesSums(shardsSize, 0);
+	vector<int> neighbourhoodSizes(shardsSize, 0);
+	parallelFor(0, shardsSize, threads, [&](int shard) {
+		Recommender shardRecommender = recommender;
+		neighbourhoodSizes[shard] = this->shards[shard].getTopCFSums(shardRecommender, row, id, shardRatingsSums[shard], similaritiesSums[shard],
+			ratersCounts ? shardRatersCounts[shard].data() : NULL);
+	});
+
+	int neighbourhoodSize = 0;
+	for (int shard = 0; shard < shardsSize; shard++) {
+		neighbourhoodSize += neighbourhoodSizes[shard];
+		similaritiesSum += similaritiesSums[shard];
+		if (shard == 0) continue;
+		for (int i = 0; i < this->cols; i++) shardRatingsSums[0][i] += shardRatingsSums[shard][i];
+		if (!ratersCounts) continue;
+		for (int i = 0; i < this->cols; i++) shardRatersCounts[0][i] += shardRatersCounts[shard][i];
+	}
+	ratingsSums.swap(shardRatingsSums[0]);
+	if (ratersCounts) ratersCounts->swap(shardRatersCounts[0]);
+	if (!delta || delta->empty()) return neighbourhoodSize;
+
+	RatingMatrix<double> oldRows;
+	RatingMatrix<double> newRows;
+	this->getDeltaRows(*delta, id, oldRows, newRows);
+	const RatingMatrix<double> *deltaRows[] = { &oldRows, &newRows };
+	for (int i = 0; i < 2; i++) {
+		if (!deltaRows[i]->getRows()) continue;
+		Recommender deltaRecommender = recommender;
+		vector<double> deltaRatingsSums(this->cols, 0);
+		vector<double> deltaRatersCounts(ratersCounts ? this->cols : 0, 0);
+		double deltaSimilaritiesSum = 0;
+		int size = deltaRecommender.getTopCFSums(*deltaRows[i], row, -1, deltaRatingsSums, deltaSimilaritiesSum,
+			ratersCounts ? deltaRatersCounts.data() : NULL);
+		int sign = i == 0 ? -1 : 1;
+		neighbourhoodSize += sign * size;
+		similaritiesSum += sign * deltaSimilaritiesSum;
+		for (int j = 0; j < this->cols; j++) ratingsSums[j] += sign * deltaRatingsSums[j];
+		if (!ratersCounts) continue;
+		for (int j = 0; j < this->cols; j++) (*ratersCounts)[j] += sign * deltaRatersCounts[j];
+	}
+
+	return neighbourhoodSize;
+}
+
+double ShardedRatingModel::getRatingPrediction(const Recommender &recommender, int id, int colIndex, int threads, const DeltaRows *delta) const {
+	TraceSpan span("getRatingPrediction");
+	vector<double> row;
+	if (!this->getRow(id, delta, row) || colIndex < 0 || colIndex >= this->cols) return 0;
+
+	int shardsSize = this->shards.size();
+	vector<double> ratingsSums(shardsSize, 0);
+	vector<double> similaritiesSums(shardsSize, 0);
+	vector<int> neighbourhoodSizes(shardsSize, 0);
+	parallelFor(0, shardsSize, threads, [&](int shard) {
+		Recommender shardRecommender = recommender;
+		neighbourhoodSizes[shard] = this->shards[shard].getRatingPredictionSums(shardRecommender, row.data(), id, colIndex,
+			ratingsSums[shard], similaritiesSums[shard]);
+	});
+
+	int neighbourhoodSize = 0;
+	double ratingsSum = 0;
+	double similaritiesSum = 0;
+	for (int shard = 0; shard < shardsSize; shard++) {
+		neighbourhoodSize += neighbourhoodSizes[shard];
+		ratingsSum += ratingsSums[shard];
+		similaritiesSum += similaritiesSums[shard];
+	}
+	if (delta && !delta->empty()) {
+		RatingMatrix<double> oldRows;
+		RatingMatrix<double> newRows;
+		this->getDeltaRows(*delta, id, oldRows, newRows);
+		const RatingMatrix<double> *deltaRows[] = { &oldRows, &newRows };
+		for (int i = 0; i < 2; i++) {
+			if (!deltaRows[i]->getRows()) continue;
+			Recommender deltaRecommender = recommender;
+			double deltaRatingsSum = 0;
+			double deltaSimilaritiesSum = 0;
+			int size = deltaRecommender.getRatingPredictionSums(*deltaRows[i], row.data(), -1, colIndex, deltaRatingsSum, deltaSimilaritiesSum);
+			int sign = i == 0 ? -1 : 1;
+			neighbourhoodSize += sign * size;
+			ratingsSum += sign * deltaRatingsSum;
+			similaritiesSum += sign * deltaSimilaritiesSum;
+		}
+	}
+	if (!neighbourhoodSize) return 0;
+
+	return ratingsSum / similaritiesSum;
+}
+
+double ShardedRatingModel::getGlobalBaselineRatingPrediction(int id, int colIndex, const DeltaRows *delta) const {
+	TraceSpan span("getGlobalBaselineRatingPrediction");
+	vector<double> row;
+	if (!this->getRow(id, delta, row) || colIndex < 0 || colIndex >= this->cols) return 0;
+
+	double meanRating = this->stats.getMean();
+	double userMeanRating = Utils::getRawMean(row.data(), this->cols, 1.0);
+	double itemMeanRating = this->stats.getColMean(colIndex);
+
+	double result = fabs(meanRating + (itemMeanRating - meanRating) + (userMeanRating - meanRating));
+	if (isnan(result)) return 0;
+	return result;
+}
+
+vector<pair<int, double>> ShardedRatingModel::getGlobalBaselineRecommendations(int id, int limit, int includeRatedItems,
+	const DeltaRows *delta) const {
+	TraceSpan span("getGlobalBaselineRecommendations");
+	vector<double> row;
+	bool found = this->getRow(id, delta, row);
+	Recommender recommender;
+	return recommender.rankGlobalBaseline(found ? row.data() : NULL, this->cols, 1.0, this->itemBiases, limit, includeRatedItems);
+}
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <stdint.h>
+#include "../include/Stats.h"
+
+using namespace std;
+
+Stats& Stats::getInstance() {
+	static Stats instance;
+	return instance;
+}
+
+Stats::Stats() : enabled(false) {
+	this->reset();
+}
+
+void Stats::setEnabled(bool enabled) {
+	this->enabled.store(enabled);
+}
+
+void Stats::record(Phase phase, uint64_t nanoseconds) {
+	int bucket = 0;
+	while (bucket < HISTOGRAM_SIZE - 1 && nanoseconds > Stats::getBucketBound(bucket)) bucket++;
+
+	this->calls[phase].fetch_add(1, memory_order_relaxed);
+	this->totalNanoseconds[phase].fetch_add(nanoseconds, memory_order_relaxed);
+	this->histogram[phase][bucket].fetch_add(1, memory_order_relaxed);
+}
+
+void Stats::add(Counter counter, uint64_t value) {
+	if (!this->isEnabled()) return;
+	this->counters[counter].fetch_add(value, memory_order_relaxed);
+}
+
+void Stats::reset() {
+	for (int i = 0; i < PHASES_SIZE; i++) {
+		this->calls[i].store(0);
+		this->totalNanoseconds[i].store(0);
+		for (int j = 0; j < HISTOGRAM_SIZE; j++) this->histogram[i][j].store(0);
+	}
+	for (int i = 0; i < COUNTERS_SIZE; i++) this->counters[i].store(0);
+}
+
+uint64_t Stats::getCalls(Phase phase) const {
+	return this->calls[phase].load(memory_order_relaxed);
+}
+
+uint64_t Stats::getTotalNanoseconds(Phase phase) const {
+	return this->totalNanoseconds[phase].load(memory_order_relaxed);
+}
+
+uint64_t Stats::getBucket(Phase phase, int bucket) const {
+	return this->histogram[phase][bucket].load(memory_order_relaxed);
+}
+
+uint64_t Stats::getCounter(Counter counter) const {
+	return this->counters[counter].load(memory_order_relaxed);
+}
+
+const char *Stats::getPhaseName(Phase phase) {
+	static const char *names[PHASES_SIZE] = {
+		"marshal",
+		"tokenize",
+		"tfidf",
+		"similarity",
+		"sort",
+		"predict",
+		"convert",
+		"queueWait",
+		"execute"
+	};
+
+	return names[phase];
+}
+
+const char *Stats::getCounterName(Counter counter) {
+	static const char *names[COUNTERS_SIZE] = {
+		"bytesCopied",
+		"coalesced",
+		"cancelled",
+		"arenaChunks"
+	};
+
+	return names[counter];
+}
+
+// 1us * 4^bucket, the last bucket has no bound.
+uint64_t Stats::getBucketBound(int bucket) {
+	if (bucket >= HISTOGRAM_SIZE - 1) return UINT64_MAX;
+
+	uint64_t bound = 1000;
+	for (int i = 0; i < bucket; i++) bound *= 4;
+
+	return bound;
+}
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdio.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include "../include/Trace.h"
+
+using namespace std;
+
+namespace {
+
+const size_t BATCH_SIZE = 4096;
+
+// Small ids in the order threads first trace, which read better in a viewer
+// than native thread ids.
+int getThreadId() {
+	static atomic<int> next(1);
+	static thread_local int id = next.fetch_add(1);
+	return id;
+}
+
+}
+
+Trace& Trace::getInstance() {
+	static Trace instance;
+	return instance;
+}
+
+Trace::Trace() : enabled(false), file(NULL), origin(0), written(false) {}
+
+bool Trace::start(const string &path) {
+	this->stop();
+
+	lock_guard<mutex> guard(this->lock);
+	this->file = fopen(path.c_str(), "w");
+	if (!this->file) return false;
+
+	fputs("[\n", this->file);
+	this->origin = Trace::now();
+	this->written = false;
+	this->enabled.store(true);
+	return true;
+}
+
+// The file of a process which crashed lacks the closing bracket, which the
+// trace viewers accept.
+bool Trace::stop() {
+	lock_guard<mutex> guard(this->lock);
+	if (!this->file) return true;
+
+	this->enabled.store(false);
+	bool ok = this->flush();
+	fputs("\n]\n", this->file);
+	ok = fclose(this->file) == 0 && ok;
+	this->file = NULL;
+	return ok;
+}
+
+void Trace::record(const char *name, const char *category, uint64_t start, uint64_t end) {
+	int thread = getThreadId();
+
+	lock_guard<mutex> guard(this->lock);
+	if (!this->file || start < this->origin) return;
+
+	Event event = { name, category, start, end, thread };
+	this->events.push_back(event);
+	if (this->events.size() >= BATCH_SIZE) this->flush();
+}
+
+uint64_t Trace::now() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Times are in microseconds since the trace started.
+bool Trace::flush() {
+	int pid = getpid();
+	bool ok = true;
+	for (const Event &event : this->events) {
+		int written = fprintf(this->file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+			this->written ? ",\n" : "", event.name, event.category, (event.start - this->origin) / 1000.0,
+			(event.end - event.start) / 1000.0, pid, event.thread);
+		if (written < 0) ok = false;
+		this->written = true;
+	}
+	this->events.clear();
+
+	return ok;
+}
@@ -1,11 +1,21 @@
 #include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
 #include <math.h>
+#include <string.h>
 #include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "../include/Utils.h"
+#include "../include/StorageTraits.h"
+#include "../include/Constants.h"
+#include "../include/Arena.h"
 
 using namespace std;
 
-double Utils::calculateDotProduct(const vector<double> &a, const vector<double> &b) {
+template <typename Allocator>
+double Utils::calculateDotProduct(const vector<double, Allocator> &a, const vector<double, Allocator> &b) {
 	double sum = 0;
 	int vectorSize = a.size();
 	for (int i = 0; i < vectorSize; i++) {
@@ -15,7 +25,65 @@ double Utils::calculateDotProduct(const vector<double> &a, const vector<double>
 	return sum;
 }
 
-double Utils::normalizeVector(const vector<double> &a) {
+// Returns the dot product of the stored values. The caller multiplies it by the
+// scales of both rows.
+template <typename T>
+double Utils::calculateDotProduct(const T *a, const T *b, int size) {
+	typedef typename StorageTraits<T>::BlockAccumulator BlockAccumulator;
+	typename StorageTraits<T>::Accumulator sum = 0;
+	for (int start = 0; start < size; start += StorageTraits<T>::BLOCK_SIZE) {
+		int end = size - start > StorageTraits<T>::BLOCK_SIZE ? start + StorageTraits<T>::BLOCK_SIZE : size;
+		BlockAccumulator blockSum = 0;
+		for (int i = start; i < end; i++) {
+			blockSum += (BlockAccumulator)a[i] * (BlockAccumulator)b[i];
+		}
+		sum += blockSum;
+	}
+
+	return (double)sum;
+}
+
+template <typename T>
+double Utils::getRawMean(const T *a, int size, double scale) {
+	double sum = 0;
+	double nonZeros = 0;
+	for (int i = 0; i < size; i++) {
+		if (a[i] == 0) continue;
+		sum += a[i] * scale;
+		nonZeros++;
+	}
+
+	return sum / nonZeros;
+}
+
+// Same as normalizeVector(getSubtractRawMeanFromVector(a)) without the copy.
+template <typename T>
+double Utils::getCenteredNorm(const T *a, int size, double scale) {
+	double rawMean = Utils::getRawMean(a, size, scale);
+	double normalized = 0;
+	for (int i = 0; i < size; i++) {
+		if (a[i] == 0) continue;
+		double centered = a[i] * scale - rawMean;
+		normalized += centered * centered;
+	}
+
+	return normalized;
+}
+
+template double Utils::calculateDotProduct<allocator<double>>(const vector<double> &a, const vector<double> &b);
+template double Utils::calculateDotProduct<ArenaAllocator<double>>(const ScratchVector<double> &a, const ScratchVector<double> &b);
+template double Utils::calculateDotProduct<double>(const double *a, const double *b, int size);
+template double Utils::calculateDotProduct<float>(const float *a, const float *b, int size);
+template double Utils::calculateDotProduct<uint8_t>(const uint8_t *a, const uint8_t *b, int size);
+template double Utils::getRawMean<double>(const double *a, int size, double scale);
+template double Utils::getRawMean<float>(const float *a, int size, double scale);
+template double Utils::getRawMean<uint8_t>(const uint8_t *a, int size, double scale);
+template double Utils::getCenteredNorm<double>(const double *a, int size, double scale);
+template double Utils::getCenteredNorm<float>(const float *a, int size, double scale);
+template double Utils::getCenteredNorm<uint8_t>(const uint8_t *a, int size, double scale);
+
+template <typename Allocator>
+double Utils::normalizeVector(const vector<double, Allocator> &a) {
 	double normalized = 0;
 	int vectorSize = a.size();
 	for (int i = 0; i < vectorSize; i++) {
@@ -25,6 +93,9 @@ double Utils::normalizeVector(const vector<double> &a) {
 	return normalized;
 }
 
+template double Utils::normalizeVector<allocator<double>>(const vector<double> &a);
+template double Utils::normalizeVector<ArenaAllocator<double>>(const ScratchVector<double> &a);
+
 double Utils::calculateCosineSimilarity(const double &dotProduct, const double &normA, const double &normB) {
 	if (dotProduct == 0 || normA == 0 || normB == 0) return 0;
 	return dotProduct / (sqrt(normA) * sqrt(normB));
@@ -106,4 +177,80 @@ double Utils::getColMean(const vector<vector<double>> &ratings, int colIndex) {
 	}
 
 	return sum / counter;
-}
\ No newline at end of file
+}
+
+uint64_t Utils::hashStrings(const vector<string> &strings, uint64_t seed) {
+	uint64_t hash = Utils::hashBytes(nullptr, 0, seed ^ strings.size());
+	int stringsSize = strings.size();
+	for (int i = 0; i < stringsSize; i++) {
+		hash = Utils::hashBytes(strings[i].data(), strings[i].size(), hash ^ strings[i].size());
+	}
+
+	return hash;
+}
+
+// Word at a time multiply-xorshift hash. Used to key in-flight requests and
+// cached results on the content of the model they were computed from.
+uint64_t Utils::hashBytes(const void *data, size_t size, uint64_t seed) {
+	const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	uint64_t hash = seed ^ (size * multiplier);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 29;
+	}
+	if (i < size) {
+		uint64_t word = 0;
+		memcpy(&word, bytes + i, size - i);
+		hash = (hash ^ word) * multiplier;
+	}
+	hash ^= hash >> 32;
+	hash *= multiplier;
+	hash ^= hash >> 29;
+
+	return hash;
+}
+
+// Lower cased words of the line, without stop words if useStopWords is set.
+vector<string> Utils::splitLineToWords(const string &line, bool useStopWords) {
+	vector<string> document;
+	stringstream s(line);
+	string word;
+	while (s >> word) {
+		transform(word.begin(), word.end(), word.begin(), ::tolower);
+		if (useStopWords) {
+			const bool isStopWord = STOP_WORDS.find(word) != STOP_WORDS.end();
+			if (isStopWord) continue;
+		}
+		document.push_back(word);
+	}
+
+	return document;
+}
+
+// The identity of a file's contents: a file which is replaced or rewritten
+// gets another key. Returns false if the file doesn't exist.
+bool Utils::getFileKey(const string &path, string &key, size_t &size) {
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0) return false;
+	long modifiedNanoseconds = 0;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return false;
+#ifdef __APPLE__
+	long modifiedNanoseconds = info.st_mtimespec.tv_nsec;
+#else
+	long modifiedNanoseconds = info.st_mtim.tv_nsec;
+#endif
+#endif
+	if (info.st_size < 0) return false;
+
+	size = info.st_size;
+	key = path + "|" + to_string(info.st_dev) + "|" + to_string(info.st_ino) + "|" + to_string(info.st_mtime) + "." +
+		to_string(modifiedNanoseconds) + "|" + to_string(info.st_size);
+	return true;
+}
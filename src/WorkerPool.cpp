@@ -0,0 +1,163 @@
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include "../include/WorkerPool.h"
+#include "../include/Constants.h"
+
+using namespace std;
+
+WorkerPool& WorkerPool::getInstance() {
+	// Never destroyed: jobs may still be running while the process exits.
+	static WorkerPool *instance = nullptr;
+	static once_flag created;
+	call_once(created, []() {
+		int size = thread::hardware_concurrency();
+		const char *env = getenv("RECOMMENDER_POOL_SIZE");
+		if (env != nullptr && atoi(env) > 0) size = atoi(env);
+		if (size <= 0) size = DEFAULT_POOL_SIZE;
+		instance = new WorkerPool(size);
+	});
+
+	return *instance;
+}
+
+WorkerPool::WorkerPool(int size) :
+	activeThreads(0),
+	threadsToRetire(0),
+	consecutiveInteractive(0),
+	stopping(false) {
+	this->resize(size);
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->available.notify_all();
+	int threadsSize = this->threads.size();
+	for (int i = 0; i < threadsSize; i++) {
+		if (this->threads[i].joinable()) this->threads[i].join();
+	}
+	this->joinRetired();
+}
+
+void WorkerPool::submit(function<void()> task, Priority priority) {
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->queues[priority].push_back(task);
+	}
+	this->available.notify_one();
+}
+
+void WorkerPool::help(function<void()> task) {
+	{
+		unique_lock<mutex> guard(this->lock);
+		this->helpers.push_back(task);
+	}
+	this->available.notify_one();
+}
+
+void WorkerPool::resize(int size) {
+	if (size < 1) size = 1;
+	this->joinRetired();
+	unique_lock<mutex> guard(this->lock);
+	int running = this->activeThreads - this->threadsToRetire;
+	if (size < running) {
+		this->threadsToRetire += running - size;
+		guard.unlock();
+		this->available.notify_all();
+		return;
+	}
+
+	int retiredToKeep = min(this->threadsToRetire, size - running);
+	this->threadsToRetire -= retiredToKeep;
+	running += retiredToKeep;
+	for (int i = running; i < size; i++) {
+		this->threads.push_back(thread(&WorkerPool::run, this));
+		this->activeThreads++;
+	}
+}
+
+int WorkerPool::size() {
+	unique_lock<mutex> guard(this->lock);
+	return this->activeThreads - this->threadsToRetire;
+}
+
+int WorkerPool::pending() {
+	unique_lock<mutex> guard(this->lock);
+	return this->queues[INTERACTIVE].size() + this->queues[BATCH].size();
+}
+
+void WorkerPool::run() {
+	while (true) {
+		function<void()> task;
+		{
+			unique_lock<mutex> guard(this->lock);
+			this->available.wait(guard, [this]() {
+				return this->stopping || this->threadsToRetire > 0 || !this->helpers.empty() ||
+					!this->queues[INTERACTIVE].empty() || !this->queues[BATCH].empty();
+			});
+			if (this->stopping) return;
+			if (this->threadsToRetire > 0) {
+				this->threadsToRetire--;
+				this->activeThreads--;
+				this->retire(this_thread::get_id());
+				return;
+			}
+			this->takeTask(task);
+		}
+		task();
+	}
+}
+
+// A thread can't join itself, so a retiring thread hands its handle over to
+// the next resize or the destructor. Called with the lock held.
+void WorkerPool::retire(thread::id id) {
+	int threadsSize = this->threads.size();
+	for (int i = 0; i < threadsSize; i++) {
+		if (this->threads[i].get_id() != id) continue;
+		this->retired.push_back(move(this->threads[i]));
+		this->threads.erase(this->threads.begin() + i);
+		return;
+	}
+}
+
+void WorkerPool::joinRetired() {
+	vector<thread> retired;
+	{
+		unique_lock<mutex> guard(this->lock);
+		retired.swap(this->retired);
+	}
+	int retiredSize = retired.size();
+	for (int i = 0; i < retiredSize; i++) {
+		if (retired[i].joinable()) retired[i].join();
+	}
+}
+
+// Helpers of running jobs go first, then interactive jobs, but a batch job is
+// let through after BATCH_STARVATION_LIMIT interactive ones so batch work
+// still progresses.
+bool WorkerPool::takeTask(function<void()> &task) {
+	if (!this->helpers.empty()) {
+		task = this->helpers.front();
+		this->helpers.pop_front();
+		return true;
+	}
+
+	deque<function<void()>> &interactive = this->queues[INTERACTIVE];
+	deque<function<void()>> &batch = this->queues[BATCH];
+	bool preferBatch = !batch.empty() && (interactive.empty() || this->consecutiveInteractive >= BATCH_STARVATION_LIMIT);
+	deque<function<void()>> &queue = preferBatch ? batch : interactive;
+	if (queue.empty()) return false;
+
+	this->consecutiveInteractive = preferBatch ? 0 : this->consecutiveInteractive + 1;
+	task = queue.front();
+	queue.pop_front();
+
+	return true;
+}
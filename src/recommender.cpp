@@ -10,19 +10,31 @@
 #include "../include/recommender.h"
 #include "../include/Constants.h"
 #include "../include/Utils.h"
+#include "../include/ResultCache.h"
+#include "../include/RatingMatrix.h"
+#include "../include/Stats.h"
+#include "../include/Trace.h"
+#include "../include/Parallel.h"
+#include "../include/FileCache.h"
 
 using namespace std;
 
 map<string, double> Recommender::tfidf(string documentFilePath, string documentsFilePath, bool useStopWords) {
+	TraceSpan span("tfidf");
 	map<string, double> result;
 
 	this->useStopWords = useStopWords;
-	this->document = this->readDocument(documentFilePath);
-	this->documents = this->getVocabulary(documentsFilePath);
+	{
+		StatsTimer timer(Stats::TOKENIZE);
+		this->document = this->readDocument(documentFilePath);
+		this->documentsFile = FileCache::getInstance().get(documentsFilePath, useStopWords);
+	}
 
+	StatsTimer timer(Stats::TFIDF);
 	int totalNumberOfTerms = this->document.size();
 	for (int i = 0; i < totalNumberOfTerms; i++) {
-		string currentTerm = this->document[i];
+		if (this->isCancelled()) break;
+		const string &currentTerm = this->document[i];
 		int numberOfTimesTermAppears = this->getNumberOfTimesTermAppears(currentTerm, this->document);
 		double tfidf = this->calculateTfIdf(numberOfTimesTermAppears, totalNumberOfTerms, currentTerm);
 		result[currentTerm] += tfidf;
@@ -33,19 +45,26 @@ map<string, double> Recommender::tfidf(string documentFilePath, string documents
 }
 
 map<string, double> Recommender::tfidf(string query, vector<string> documents, bool useStopWords) {
+	TraceSpan span("tfidf");
 	map<string, double> result;
 
 	this->useStopWords = useStopWords;
-	this->document = this->splitLineToWords(query);
-	int totalDocumentsSize = documents.size();
-	for (int i = 0; i < totalDocumentsSize; i++) {
-		this->rawDocuments.push_back(documents[i]);
-		this->documents.push_back(splitLineToWords(documents[i]));
+	{
+		StatsTimer timer(Stats::TOKENIZE);
+		this->document = this->splitLineToWords(query);
+		this->documentsFile.reset();
+		int totalDocumentsSize = documents.size();
+		for (int i = 0; i < totalDocumentsSize; i++) {
+			this->rawDocuments.push_back(documents[i]);
+			this->documents.push_back(splitLineToWords(documents[i]));
+		}
 	}
 
+	StatsTimer timer(Stats::TFIDF);
 	int totalNumberOfTerms = this->document.size();
 	for (int i = 0; i < totalNumberOfTerms; i++) {
-		string currentTerm = this->document[i];
+		if (this->isCancelled()) break;
+		const string &currentTerm = this->document[i];
 		int numberOfTimesTermAppears = this->getNumberOfTimesTermAppears(currentTerm, this->document);
 		double tfidf = this->calculateTfIdf(numberOfTimesTermAppears, totalNumberOfTerms, currentTerm);
 		result[currentTerm] += tfidf;
@@ -55,22 +74,34 @@ map<string, double> Recommender::tfidf(string query, vector<string> documents, b
 	return result;
 }
 
-vector<double> Recommender::recommend(map<string, double> weights) {
+vector<double> Recommender::recommend(const map<string, double> &weights) {
+	TraceSpan span("recommend");
 	vector<double> similarities;
 	if (weights.size() == 0) return similarities;
 
-	vector<double> queryVector;
+	StatsTimer timer(Stats::SIMILARITY);
+	ArenaScope scope;
+
+	ScratchVector<double> queryVector;
+	queryVector.reserve(weights.size());
 	for (auto const &entry : weights) {
 		queryVector.push_back(entry.second);
 	}
 
-	int totalDocumentsSize = this->documents.size();
+	const vector<vector<string>> &documents = this->getDocuments();
+	int totalDocumentsSize = documents.size();
+	similarities.reserve(totalDocumentsSize);
+	ScratchVector<double> documentVector(queryVector.size());
 	for (int i = 0; i < totalDocumentsSize; i++) {
-		vector<double> documentVector(queryVector.size());
+		if (this->isCancelled()) {
+			similarities.resize(totalDocumentsSize, 0);
+			break;
+		}
+		fill(documentVector.begin(), documentVector.end(), 0);
 		bool hasEqualTerms = false;
-		int documentSize = this->documents[i].size();
+		int documentSize = documents[i].size();
 		for (int j = 0; j < documentSize; j++) {
-			string currentTerm = this->documents[i][j];
+			const string &currentTerm = documents[i][j];
 			bool queryTermExistsInDocument = false;
 			int foundIndex = 0;
 			int idx = 0;
@@ -85,7 +116,7 @@ vector<double> Recommender::recommend(map<string, double> weights) {
 			}
 			if (!queryTermExistsInDocument) continue;
 
-			int numberOfTimesTermAppears = this->getNumberOfTimesTermAppears(currentTerm, this->documents[i]);
+			int numberOfTimesTermAppears = this->getNumberOfTimesTermAppears(currentTerm, documents[i]);
 			int totalNumberOfTerms = documentSize;
 			double tfidf = this->calculateTfIdf(numberOfTimesTermAppears, totalNumberOfTerms, currentTerm);
 			documentVector[foundIndex] = tfidf;
@@ -104,13 +135,46 @@ vector<double> Recommender::recommend(map<string, double> weights) {
 	return similarities;
 }
 
-vector<string> Recommender::getSortedDocuments(vector<double> similarities) {
+vector<string> Recommender::getSortedDocuments(const vector<double> &similarities) {
+	TraceSpan span("getSortedDocuments");
+	ArenaScope scope;
+	ScratchVector<int> sortedIndexes;
+	this->sortDocumentIndexes(similarities, sortedIndexes);
+	int sortedIndexesSize = sortedIndexes.size();
 	vector<string> result;
+	result.reserve(sortedIndexesSize);
+	for (int i = 0; i < sortedIndexesSize; i++) {
+		result.push_back(this->getRawDocuments()[sortedIndexes[i]]);
+	}
+
+	return result;
+}
+
+vector<int> Recommender::getSortedDocumentIndexes(const vector<double> &similarities) {
+	ArenaScope scope;
+	ScratchVector<int> used;
+	this->sortDocumentIndexes(similarities, used);
+	return vector<int>(used.begin(), used.end());
+}
+
+// Appends the indexes of the documents to used, from the most to the least
+// similar. The buffers live in the arena of the caller's scope.
+void Recommender::sortDocumentIndexes(const vector<double> &similarities, ScratchVector<int> &used) {
 	int similaritiesSize = similarities.size();
-	if (similaritiesSize == 0) return result;
+	if (similaritiesSize == 0) return;
+
+	StatsTimer timer(Stats::SORT);
 
-	vector<int> used;
-	while (result.size() < similaritiesSize) {
+	used.reserve(similaritiesSize);
+	while ((int)used.size() < similaritiesSize) {
+		if (this->isCancelled()) {
+			ScratchVector<char> isUsed(similaritiesSize, false);
+			for (int i : used) isUsed[i] = true;
+			for (int i = 0; i < similaritiesSize; i++) {
+				if (!isUsed[i]) used.push_back(i);
+			}
+			break;
+		}
 		double max = -DBL_MAX;
 		int maxIndex = 0;
 		for (int i = 0; i < similaritiesSize; i++) {
@@ -129,88 +193,616 @@ vector<string> Recommender::getSortedDocuments(vector<double> similarities) {
 			}
 		}
 		used.push_back(maxIndex);
-		result.push_back(this->rawDocuments[maxIndex]);
+	}
+}
+
+vector<string> Recommender::recommendDocuments(string query, vector<string> documents, bool useStopWords) {
+	TraceSpan span("recommendDocuments");
+	vector<string> result;
+	ResultCache &cache = ResultCache::getInstance();
+	string key;
+	vector<pair<int, double>> ranking;
+	if (cache.isEnabled()) {
+		// The corpus is only known by its hash, so a ranking that does not fit
+		// the documents is a collision and is treated as a miss.
+		uint64_t corpusVersion = Utils::hashStrings(documents);
+		int documentsSize = documents.size();
+		key = "tfidf|" + to_string(documentsSize) + "|" + to_string(corpusVersion) + "|" + to_string(useStopWords) + "|" + query;
+		if (cache.get(key, ranking)) {
+			int rankingSize = ranking.size();
+			for (int i = 0; i < rankingSize; i++) {
+				if (ranking[i].first < 0 || ranking[i].first >= documentsSize) break;
+				result.push_back(documents[ranking[i].first]);
+			}
+			if ((int)result.size() == rankingSize) return result;
+			result.clear();
+			ranking.clear();
+		}
 	}
 
+	this->tfidf(query, documents, useStopWords);
+	vector<double> similarities = this->recommend(this->weights);
+	ArenaScope scope;
+	ScratchVector<int> sortedIndexes;
+	this->sortDocumentIndexes(similarities, sortedIndexes);
+	int sortedIndexesSize = sortedIndexes.size();
+	result.reserve(sortedIndexesSize);
+	ranking.reserve(sortedIndexesSize);
+	for (int i = 0; i < sortedIndexesSize; i++) {
+		result.push_back(this->rawDocuments[sortedIndexes[i]]);
+		ranking.push_back(make_pair(sortedIndexes[i], similarities[sortedIndexes[i]]));
+	}
+
+	if (!key.empty() && !this->isCancelled()) cache.put(key, ranking);
 	return result;
 }
 
 double Recommender::getRatingPrediction(vector<vector<double>> &ratings, int rowIndex, int colIndex) {
-	vector<vector<double>> originalRatings;
-	int ratingsSize = ratings.size();
-	for (int i = 0; i < ratingsSize; i++) {
-		originalRatings.push_back(ratings[i]);
-	}
+	return this->getRatingPrediction(RatingMatrix<double>::fromRows(ratings), rowIndex, colIndex);
+}
 
-	double similaritiesSum = 0;
+double Recommender::getGlobalBaselineRatingPrediction(vector<vector<double>> &ratings, int rowIndex, int colIndex) {
+	return this->getGlobalBaselineRatingPrediction(RatingMatrix<double>::fromRows(ratings), rowIndex, colIndex);
+}
+
+vector<pair<int, double>> Recommender::getTopCFRecommendations(vector<vector<double>> &ratings, int rowIndex, int limit, int includeRatedItems) {
+	return this->getTopCFRecommendations(RatingMatrix<double>::fromRows(ratings), rowIndex, limit, includeRatedItems);
+}
+
+template <typename T>
+double Recommender::getRatingPrediction(const RatingMatrix<T> &ratings, int rowIndex, int colIndex) {
+	TraceSpan span("getRatingPrediction");
 	double ratingsSum = 0;
-	vector<pair<int, double>> neighbourhood = this->getNeighbourhood(rowIndex, colIndex, ratings, originalRatings);
+	double similaritiesSum = 0;
+	if (!this->getRatingPredictionSums(ratings, ratings.getRow(rowIndex), rowIndex, colIndex, ratingsSum, similaritiesSum)) return 0;
+
+	double res = ratingsSum / similaritiesSum;
+	return res;
+}
+
+// Adds the weighted ratings of colIndex and the similarities of the row's
+// neighbourhood among the rows of ratings to the sums, which lets the sums of
+// several shards be added up. The row itself is rowIndex of ratings, or -1
+// when it is not one of them. Returns the size of the neighbourhood.
+template <typename T>
+int Recommender::getRatingPredictionSums(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex,
+	double &ratingsSum, double &similaritiesSum) {
+	ArenaScope scope;
+	double normA = Utils::calculateDotProduct(row, row, ratings.getCols()) * ratings.getScale() * ratings.getScale();
+	Neighbourhood neighbourhood = this->getNeighbourhood(ratings, row, rowIndex, colIndex, normA);
 	int neighbourhoodSize = neighbourhood.size();
 	if (!neighbourhoodSize) return 0;
+
+	StatsTimer timer(Stats::PREDICT);
 	for (int i = 0; i < neighbourhoodSize; i++) {
 		similaritiesSum += neighbourhood[i].second;
-		ratingsSum += originalRatings[neighbourhood[i].first][colIndex] * neighbourhood[i].second;
+		ratingsSum += ratings.get(neighbourhood[i].first, colIndex) * neighbourhood[i].second;
 	}
 
-	double res = ratingsSum / similaritiesSum;
-	return res;
+	return neighbourhoodSize;
 }
 
-double Recommender::getGlobalBaselineRatingPrediction(vector<vector<double>> &ratings, int rowIndex, int colIndex) {
-	double meanRating = Utils::getMean(ratings);
-	double userMeanRating = Utils::getRowMean(ratings[rowIndex]);
-	double itemMeanRating = Utils::getColMean(ratings, colIndex);
+template <typename T>
+double Recommender::getGlobalBaselineRatingPrediction(const RatingMatrix<T> &ratings, int rowIndex, int colIndex) {
+	TraceSpan span("getGlobalBaselineRatingPrediction");
+	StatsTimer timer(Stats::PREDICT);
+	double meanRating = ratings.getMean();
+	double userMeanRating = ratings.getRowMean(rowIndex);
+	double itemMeanRating = ratings.getColMean(colIndex);
 
 	double result = fabs(meanRating + (itemMeanRating - meanRating) + (userMeanRating - meanRating));
 	if (isnan(result)) return 0;
 	return result;
 }
 
-vector<pair<int, double>> Recommender::getTopCFRecommendations(vector<vector<double>> &ratings, int rowIndex, int limit, int includeRatedItems) {
+template <typename T>
+vector<pair<int, double>> Recommender::getTopCFRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems) {
+	TraceSpan span("getTopCFRecommendations");
+	ResultCache &cache = ResultCache::getInstance();
+	if (!cache.isEnabled()) return this->computeTopCFRecommendations(ratings, rowIndex, limit, includeRatedItems);
+
 	vector<pair<int, double>> recommendations;
-	vector<vector<double>> originalRatings;
-	int ratingsSize = ratings.size();
-	for (int i = 0; i < ratingsSize; i++) {
-		originalRatings.push_back(ratings[i]);
-		if (i == rowIndex) {
-			Utils::subtractRawMeanFromVector(ratings[rowIndex]);
+	string key = "topcf|" + to_string(ratings.getVersion()) + "|" + to_string(rowIndex) + "|" +
+		to_string(limit) + "|" + to_string(includeRatedItems) + "|" + to_string(this->minCoRatings);
+	if (cache.get(key, recommendations)) return recommendations;
+
+	recommendations = this->computeTopCFRecommendations(ratings, rowIndex, limit, includeRatedItems);
+	if (!this->isCancelled()) cache.put(key, recommendations);
+
+	return recommendations;
+}
+
+template <typename T>
+vector<pair<int, double>> Recommender::computeTopCFRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems) {
+	vector<pair<int, double>> recommendations;
+	if (rowIndex < 0 || rowIndex >= ratings.getRows()) return recommendations;
+
+	ArenaScope scope;
+	const T *row = ratings.getRow(rowIndex);
+	double normA = Utils::getCenteredNorm(row, ratings.getCols(), ratings.getScale());
+	Neighbourhood neighbourhood = this->getNeighbourhood(ratings, row, rowIndex, -1, normA);
+
+	return this->predictTopCF(ratings, rowIndex, neighbourhood, limit, includeRatedItems);
+}
+
+// Adds the weighted ratings of every item and the similarities of the row's
+// neighbourhood among the rows of ratings to the sums, for rankTopCF, and with
+// ratersCounts the number of neighbours who rated every item, for rankHybrid.
+// The row itself is rowIndex of ratings, or -1 when it is not one of them.
+// Returns the size of the neighbourhood.
+template <typename T>
+int Recommender::getTopCFSums(const RatingMatrix<T> &ratings, const T *row, int rowIndex, vector<double> &ratingsSums, double &similaritiesSum,
+	double *ratersCounts, const RatedItems *ratedItems) {
+	ArenaScope scope;
+	double normA = Utils::getCenteredNorm(row, ratings.getCols(), ratings.getScale());
+	Neighbourhood neighbourhood = this->getNeighbourhood(ratings, row, rowIndex, -1, normA);
+	this->addNeighbourhoodSums(ratings, neighbourhood, ratingsSums.data(), similaritiesSum, ratersCounts, ratedItems);
+
+	return neighbourhood.size();
+}
+
+template <typename T>
+vector<pair<int, double>> Recommender::getHybridRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems,
+	int shrinkage) {
+	TraceSpan span("getHybridRecommendations");
+	ResultCache &cache = ResultCache::getInstance();
+	if (!cache.isEnabled()) return this->computeHybridRecommendations(ratings, rowIndex, limit, includeRatedItems, shrinkage);
+
+	vector<pair<int, double>> recommendations;
+	string key = "hybrid|" + to_string(ratings.getVersion()) + "|" + to_string(rowIndex) + "|" + to_string(limit) + "|" +
+		to_string(includeRatedItems) + "|" + to_string(this->minCoRatings) + "|" + to_string(shrinkage);
+	if (cache.get(key, recommendations)) return recommendations;
+
+	recommendations = this->computeHybridRecommendations(ratings, rowIndex, limit, includeRatedItems, shrinkage);
+	if (!this->isCancelled()) cache.put(key, recommendations);
+
+	return recommendations;
+}
+
+// The means of the global baseline come from one sweep over the matrix and the
+// neighbourhood sums from one walk over the neighbours, instead of a sweep for
+// every item whose baseline is asked for.
+template <typename T>
+vector<pair<int, double>> Recommender::computeHybridRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems,
+	int shrinkage) {
+	if (rowIndex < 0 || rowIndex >= ratings.getRows()) return vector<pair<int, double>>();
+
+	ArenaScope scope;
+	int cols = ratings.getCols();
+	ScratchVector<double> colMeans(cols);
+	double mean = this->getColMeans(ratings, colMeans.data());
+
+	const T *row = ratings.getRow(rowIndex);
+	double normA = Utils::getCenteredNorm(row, cols, ratings.getScale());
+	Neighbourhood neighbourhood = this->getNeighbourhood(ratings, row, rowIndex, -1, normA);
+	ScratchVector<double> ratingsSums(cols, 0);
+	ScratchVector<double> ratersCounts(cols, 0);
+	double similaritiesSum = 0;
+	this->addNeighbourhoodSums(ratings, neighbourhood, ratingsSums.data(), similaritiesSum, ratersCounts.data());
+
+	return this->rankHybrid(row, cols, ratings.getScale(), ratingsSums.data(), ratersCounts.data(), similaritiesSum, mean, colMeans.data(),
+		limit, includeRatedItems, shrinkage);
+}
+
+template <typename T>
+vector<pair<int, double>> Recommender::getGlobalBaselineRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit,
+	int includeRatedItems) {
+	TraceSpan span("getGlobalBaselineRecommendations");
+	ResultCache &cache = ResultCache::getInstance();
+	if (!cache.isEnabled()) return this->computeGlobalBaselineRecommendations(ratings, rowIndex, limit, includeRatedItems);
+
+	vector<pair<int, double>> recommendations;
+	string key = "baseline|" + to_string(ratings.getVersion()) + "|" + to_string(rowIndex) + "|" + to_string(limit) + "|" +
+		to_string(includeRatedItems);
+	if (cache.get(key, recommendations)) return recommendations;
+
+	recommendations = this->computeGlobalBaselineRecommendations(ratings, rowIndex, limit, includeRatedItems);
+	if (!this->isCancelled()) cache.put(key, recommendations);
+
+	return recommendations;
+}
+
+// One sweep over the matrix for the means of all items, where predicting
+// every item with getGlobalBaselineRatingPrediction sweeps it for each.
+template <typename T>
+vector<pair<int, double>> Recommender::computeGlobalBaselineRecommendations(const RatingMatrix<T> &ratings, int rowIndex, int limit,
+	int includeRatedItems) {
+	if (rowIndex < 0 || rowIndex >= ratings.getRows()) return vector<pair<int, double>>();
+
+	ArenaScope scope;
+	int cols = ratings.getCols();
+	ScratchVector<double> colMeans(cols);
+	double mean = this->getColMeans(ratings, colMeans.data());
+	ItemBiasIndex index = ItemBiasIndex::build(colMeans.data(), cols, mean);
+
+	return this->rankGlobalBaseline(ratings.getRow(rowIndex), cols, ratings.getScale(), index, limit, includeRatedItems);
+}
+
+template <typename S>
+vector<pair<int, double>> Recommender::getBinaryRecommendations(const BinaryMatrix &interactions, int rowIndex, int limit, int includeRatedItems) {
+	TraceSpan span("getBinaryRecommendations");
+	ResultCache &cache = ResultCache::getInstance();
+	if (!cache.isEnabled()) return this->computeBinaryRecommendations<S>(interactions, rowIndex, limit, includeRatedItems);
+
+	vector<pair<int, double>> recommendations;
+	string key = string("binary|") + S::getName() + "|" + to_string(interactions.getVersion()) + "|" + to_string(rowIndex) + "|" +
+		to_string(limit) + "|" + to_string(includeRatedItems) + "|" + to_string(this->minCoRatings);
+	if (cache.get(key, recommendations)) return recommendations;
+
+	recommendations = this->computeBinaryRecommendations<S>(interactions, rowIndex, limit, includeRatedItems);
+	if (!this->isCancelled()) cache.put(key, recommendations);
+
+	return recommendations;
+}
+
+// The score of an item is the sum of the similarities of the neighbours who
+// have it over the sum of all similarities, the share of the neighbourhood
+// which has the item weighted by similarity, between 0 and 1. The items of a
+// neighbour are walked a set bit at a time. Items no neighbour has are left
+// out.
+template <typename S>
+vector<pair<int, double>> Recommender::computeBinaryRecommendations(const BinaryMatrix &interactions, int rowIndex, int limit, int includeRatedItems) {
+	if (rowIndex < 0 || rowIndex >= interactions.getRows()) return vector<pair<int, double>>();
+
+	ArenaScope scope;
+	Neighbourhood neighbourhood = this->getBinarySimilarities<S>(interactions, rowIndex);
+	int cols = interactions.getCols();
+	int words = interactions.getWords();
+	ScratchVector<double> scores(cols, 0);
+	double similaritiesSum = 0;
+	{
+		StatsTimer timer(Stats::PREDICT);
+		int neighbourhoodSize = neighbourhood.size();
+		for (int i = 0; i < neighbourhoodSize; i++) {
+			double similarity = neighbourhood[i].second;
+			similaritiesSum += similarity;
+			const uint64_t *neighbourRow = interactions.getRow(neighbourhood[i].first);
+			for (int j = 0; j < words; j++) {
+				for (uint64_t word = neighbourRow[j]; word; word &= word - 1) scores[j * 64 + BinaryMatrix::getLowestBit(word)] += similarity;
+			}
 		}
 	}
 
-	vector<pair<int, double>> neighbourhood = this->getNeighbourhood(rowIndex, ratings, originalRatings);
+	Neighbourhood recommendations;
+	const uint64_t *row = interactions.getRow(rowIndex);
+	for (int i = 0; i < cols; i++) {
+		if (scores[i] == 0) continue;
+		if (includeRatedItems == -1 && (row[i >> 6] >> (i & 63)) & 1) continue;
+		recommendations.push_back(make_pair(i, scores[i] / similaritiesSum));
+	}
+
+	return this->sortRecommendations(recommendations, limit);
+}
+
+// Similarities of the row to all other rows of interactions which have at
+// least max(1, minCoRatings) items in common with it. The others have a
+// similarity of 0 and are left out.
+template <typename S>
+Recommender::Neighbourhood Recommender::getBinarySimilarities(const BinaryMatrix &interactions, int rowIndex) {
+	TraceSpan span("getBinarySimilarities");
+	StatsTimer timer(Stats::SIMILARITY);
+	Neighbourhood similarities;
+	int rows = interactions.getRows();
+	int words = interactions.getWords();
+	const uint64_t *row = interactions.getRow(rowIndex);
+	int count = interactions.getCount(rowIndex);
+	int minCommon = max(1, this->minCoRatings);
+	for (int i = 0; i < rows; i++) {
+		if (i % CANCELLATION_CHECK_INTERVAL == 0 && this->isCancelled()) break;
+		if (i == rowIndex) continue;
+		int common = BinaryMatrix::countCommon(row, interactions.getRow(i), words);
+		if (common < minCommon) continue;
+		similarities.push_back(make_pair(i, S::get(common, count, interactions.getCount(i))));
+	}
+
+	return similarities;
+}
+
+// Sums and counts every column without a branch, since unrated cells add 0 to
+// the sums. Returns the mean of all ratings.
+template <typename T>
+double Recommender::getColMeans(const RatingMatrix<T> &ratings, double *colMeans) {
+	StatsTimer timer(Stats::PREDICT);
+	int rows = ratings.getRows();
+	int cols = ratings.getCols();
+	ScratchVector<double> colCounts(cols, 0);
+	fill(colMeans, colMeans + cols, 0);
+	for (int i = 0; i < rows; i++) {
+		const T *values = ratings.getRow(i);
+		for (int j = 0; j < cols; j++) {
+			colMeans[j] += values[j];
+			colCounts[j] += values[j] != 0;
+		}
+	}
+
+	double sum = 0;
+	double count = 0;
+	for (int j = 0; j < cols; j++) {
+		sum += colMeans[j];
+		count += colCounts[j];
+		colMeans[j] = colMeans[j] * ratings.getScale() / colCounts[j];
+	}
+
+	return sum * ratings.getScale() / count;
+}
+
+// Computes the recommendations of many rows in chunks. The similarities of a
+// chunk to all rows are computed in tiles of rows which fit in the cache, each
+// pair of rows of the chunk only once and only for rows with co-rated items,
+// and the norms of all rows only once for the whole job. Rows are spread over
+// threads and each finished chunk is passed to onChunk, so memory stays
+// bounded by the chunk size. The results are the same as those of
+// getTopCFRecommendations. Returns the number of rows passed to onChunk, which
+// is less than requested if the job was cancelled.
+template <typename T>
+int Recommender::getAllTopCFRecommendations(const RatingMatrix<T> &ratings, const vector<int> &rowIndexes, int limit, int includeRatedItems,
+	int chunkSize, int threads, const function<void(const TopCFChunk &)> &onChunk) {
+	TraceSpan span("getAllTopCFRecommendations");
+	int rowsSize = ratings.getRows();
+	int colsSize = ratings.getCols();
+	double scale = ratings.getScale();
+	if (chunkSize < 1) chunkSize = TOP_CF_BATCH_CHUNK_SIZE;
+
+	vector<int> targets;
+	vector<int> chunkPositions(rowsSize, -1);
+	for (int rowIndex : rowIndexes) {
+		if (rowIndex < 0 || rowIndex >= rowsSize || chunkPositions[rowIndex] == 0) continue;
+		chunkPositions[rowIndex] = 0;
+		targets.push_back(rowIndex);
+	}
+	fill(chunkPositions.begin(), chunkPositions.end(), -1);
+
+	// Only pairs of rows with co-rated items are scored, and only the rated
+	// items of the neighbours are added up.
+	RatingIndex index = RatingIndex::build(ratings);
+	vector<uint64_t> ratedOffsets;
+	vector<int32_t> ratedItemsList;
+	RatedItems ratedItems = RatedItems::build(ratings, ratedOffsets, ratedItemsList);
+	int minCoRatings = max(1, this->minCoRatings);
+
+	vector<double> norms(rowsSize);
+	parallelFor(0, rowsSize, threads, [&](int i) {
+		norms[i] = Utils::getCenteredNorm(ratings.getRow(i), colsSize, scale);
+	});
+
+	// A tile of chunk rows and a tile of candidate rows fit in the cache together.
+	int tileRows = max(1, TOP_CF_BATCH_TILE_BYTES / (int)(2 * max(1, colsSize) * sizeof(T)));
+	int processed = 0;
+	int targetsSize = targets.size();
+	for (int chunkStart = 0; chunkStart < targetsSize; chunkStart += chunkSize) {
+		if (this->isCancelled()) break;
+		int chunkEnd = min(targetsSize, chunkStart + chunkSize);
+		int chunkRows = chunkEnd - chunkStart;
+		for (int i = chunkStart; i < chunkEnd; i++) chunkPositions[targets[i]] = i - chunkStart;
+
+		vector<double> dotProducts((size_t)chunkRows * rowsSize, 0);
+		vector<int> coRatings((size_t)chunkRows * rowsSize, 0);
+		{
+			StatsTimer timer(Stats::SIMILARITY);
+			parallelFor(0, chunkRows, threads, [&](int p) {
+				this->getCoRatingCounts(ratings, ratings.getRow(targets[chunkStart + p]), &index, coRatings.data() + (size_t)p * rowsSize);
+			});
+
+			int tiles = (chunkRows + tileRows - 1) / tileRows;
+			parallelFor(0, tiles, threads, [&](int tile) {
+				int tileStart = tile * tileRows;
+				int tileEnd = min(chunkRows, tileStart + tileRows);
+				for (int candidateStart = 0; candidateStart < rowsSize; candidateStart += tileRows) {
+					if (this->isCancelled()) return;
+					int candidateEnd = min(rowsSize, candidateStart + tileRows);
+					for (int p = tileStart; p < tileEnd; p++) {
+						int u = targets[chunkStart + p];
+						const T *row = ratings.getRow(u);
+						for (int v = candidateStart; v < candidateEnd; v++) {
+							int q = chunkPositions[v];
+							// The pair was computed for the row which comes first in the chunk.
+							if (v == u || (q != -1 && q < p) || coRatings[(size_t)p * rowsSize + v] < minCoRatings) continue;
+							double dotProduct = Utils::calculateDotProduct(row, ratings.getRow(v), colsSize);
+							dotProducts[(size_t)p * rowsSize + v] = dotProduct;
+							if (q != -1) dotProducts[(size_t)q * rowsSize + u] = dotProduct;
+						}
+					}
+				}
+			});
+		}
+
+		TopCFChunk chunk(chunkRows);
+		if (!this->isCancelled()) {
+			parallelFor(0, chunkRows, threads, [&](int p) {
+				ArenaScope scope;
+				int u = targets[chunkStart + p];
+				Neighbourhood similarities;
+				similarities.reserve(rowsSize);
+				for (int v = 0; v < rowsSize; v++) {
+					if (v == u) continue;
+					double dotProduct = dotProducts[(size_t)p * rowsSize + v] * scale * scale;
+					similarities.push_back(make_pair(v, Utils::calculateCosineSimilarity(dotProduct, norms[u], norms[v])));
+				}
+				this->sortNeighbourhood(similarities);
+				chunk[p] = make_pair(u, this->predictTopCF(ratings, u, similarities, limit, includeRatedItems, &ratedItems));
+			});
+		}
+
+		for (int i = chunkStart; i < chunkEnd; i++) chunkPositions[targets[i]] = -1;
+		// A chunk cut short by cancellation holds incomplete results.
+		if (this->isCancelled()) break;
+		onChunk(chunk);
+		processed += chunkRows;
+	}
+
+	return processed;
+}
+
+// Predicts the ratings of all items from a sorted neighbourhood.
+template <typename T>
+vector<pair<int, double>> Recommender::predictTopCF(const RatingMatrix<T> &ratings, int rowIndex, const Neighbourhood &neighbourhood,
+	int limit, int includeRatedItems, const RatedItems *ratedItems) {
+	if (neighbourhood.empty()) return vector<pair<int, double>>();
+
+	ScratchVector<double> ratingsSums(ratings.getCols(), 0);
+	double similaritiesSum = 0;
+	this->addNeighbourhoodSums(ratings, neighbourhood, ratingsSums.data(), similaritiesSum, NULL, ratedItems);
+
+	return this->rankTopCF(ratings.getRow(rowIndex), ratings.getCols(), ratings.getScale(), ratingsSums.data(), similaritiesSum, limit, includeRatedItems);
+}
+
+// Each neighbour row is added to the sums of all items at once, which reads the
+// rows sequentially but adds to every sum in neighbourhood order, as a column
+// by column walk would. Unrated cells and neighbours with a similarity of 0 add
+// exactly 0 and are skipped. With ratedItems only the items a neighbour rated
+// are visited, so the sums cost as much as the neighbours' ratings instead of
+// a walk over every item of every neighbour.
+template <typename T>
+void Recommender::addNeighbourhoodSums(const RatingMatrix<T> &ratings, const Neighbourhood &neighbourhood,
+	double *ratingsSums, double &similaritiesSum, double *ratersCounts, const RatedItems *ratedItems) {
+	StatsTimer timer(Stats::PREDICT);
 	int neighbourhoodSize = neighbourhood.size();
-	if (!neighbourhoodSize) return recommendations;
+	int userRowSize = ratings.getCols();
+	double scale = ratings.getScale();
+	for (int j = 0; j < neighbourhoodSize; j++) {
+		if (j % CANCELLATION_CHECK_INTERVAL == 0 && this->isCancelled()) break;
+		int neighbourIndex = neighbourhood[j].first;
+		double similarity = neighbourhood[j].second;
+		if (similarity == 0) continue;
+		const T *neighbourRow = ratings.getRow(neighbourIndex);
+		similaritiesSum += similarity;
+		if (ratedItems) {
+			const int32_t *end = ratedItems->end(neighbourIndex);
+			for (const int32_t *item = ratedItems->begin(neighbourIndex); item != end; item++) {
+				ratingsSums[*item] += neighbourRow[*item] * scale * similarity;
+				if (ratersCounts) ratersCounts[*item]++;
+			}
+			continue;
+		}
+		for (int i = 0; i < userRowSize; i++) {
+			if (neighbourRow[i] == 0) continue;
+			ratingsSums[i] += neighbourRow[i] * scale * similarity;
+		}
+		if (!ratersCounts) continue;
+		for (int i = 0; i < userRowSize; i++) ratersCounts[i] += neighbourRow[i] != 0;
+	}
+}
 
-	int userRowSize = ratings[rowIndex].size();
-	for (int i = 0; i < userRowSize; i++) {
-		if (includeRatedItems == -1 && ratings[rowIndex][i] != 0) continue;
+// Turns the sums of the row's neighbourhood into the recommendations, sorted
+// by predicted rating. The candidates are ranked in the arena, and only the
+// recommendations which are returned are copied out of it.
+template <typename T>
+vector<pair<int, double>> Recommender::rankTopCF(const T *row, int cols, double scale, const double *ratingsSums, double similaritiesSum,
+	int limit, int includeRatedItems) {
+	ArenaScope scope;
+	Neighbourhood recommendations;
+	recommendations.reserve(cols);
+	{
+		StatsTimer timer(Stats::PREDICT);
+		double rawMean = Utils::getRawMean(row, cols, scale);
+		for (int i = 0; i < cols; i++) {
+			// An item counts as rated when its mean centered rating is not 0.
+			if (includeRatedItems == -1 && row[i] != 0 && row[i] * scale - rawMean != 0) continue;
+
+			double predictedRating = ratingsSums[i] / similaritiesSum;
+			if (!isnan(predictedRating)) recommendations.push_back(make_pair(i, predictedRating));
+		}
+	}
 
-		double similaritiesSum = 0;
-		double ratingsSum = 0;
-		for (int j = 0; j < neighbourhoodSize; j++) {
-			similaritiesSum += neighbourhood[j].second;
-			ratingsSum += originalRatings[neighbourhood[j].first][i] * neighbourhood[j].second;
+	return this->sortRecommendations(recommendations, limit);
+}
+
+// Blends the prediction of the neighbourhood with the global baseline of every
+// item, weighting the prediction by the number of neighbours who rated the
+// item and the baseline by shrinkage: (n * cf + shrinkage * baseline) /
+// (n + shrinkage). Items no neighbour rated get their baseline, so a row
+// without a neighbourhood gets the baseline of every item. The baseline is
+// that of getGlobalBaselineRatingPrediction, except that a bias which can't be
+// computed, of a row without ratings or an item nobody rated, counts as 0
+// instead of making the baseline 0.
+template <typename T>
+vector<pair<int, double>> Recommender::rankHybrid(const T *row, int cols, double scale, const double *ratingsSums, const double *ratersCounts,
+	double similaritiesSum, double mean, const double *colMeans, int limit, int includeRatedItems, int shrinkage) {
+	ArenaScope scope;
+	Neighbourhood recommendations;
+	recommendations.reserve(cols);
+	{
+		StatsTimer timer(Stats::PREDICT);
+		double rawMean = Utils::getRawMean(row, cols, scale);
+		double rowBias = isnan(rawMean) ? 0 : rawMean - mean;
+		for (int i = 0; i < cols; i++) {
+			if (includeRatedItems == -1 && row[i] != 0 && row[i] * scale - rawMean != 0) continue;
+
+			double baseline = fabs(mean + (isnan(colMeans[i]) ? 0 : colMeans[i] - mean) + rowBias);
+			double predictedRating = ratingsSums[i] / similaritiesSum;
+			double raters = ratersCounts[i];
+			if (isnan(predictedRating) || isinf(predictedRating)) raters = 0;
+
+			double rating = raters ? (raters * predictedRating + shrinkage * baseline) / (raters + shrinkage) : baseline;
+			if (!isnan(rating)) recommendations.push_back(make_pair(i, rating));
 		}
+	}
+
+	return this->sortRecommendations(recommendations, limit);
+}
 
-		double predictedRating = ratingsSum / similaritiesSum;
-		if (!isnan(predictedRating)) recommendations.push_back(make_pair(i, predictedRating));
+// Ranks the global baseline of every item for the row, which is NULL for a
+// user who is not in the ratings, with the biases of rankHybrid. The
+// baseline is highest at one of the ends of the index, so the items are
+// taken from whichever end has the higher one until limit unrated items and
+// those which tie with the last of them are taken, and only those are
+// sorted.
+template <typename T>
+vector<pair<int, double>> Recommender::rankGlobalBaseline(const T *row, int cols, double scale, const ItemBiasIndex &index, int limit,
+	int includeRatedItems) {
+	const vector<pair<int, double>> &items = index.getItems();
+	ArenaScope scope;
+	Neighbourhood recommendations;
+	recommendations.reserve(limit < 0 ? items.size() : min(items.size(), (size_t)limit));
+	{
+		StatsTimer timer(Stats::PREDICT);
+		double mean = index.getMean();
+		double rawMean = row ? Utils::getRawMean(row, cols, scale) : NAN;
+		double rowBias = isnan(rawMean) ? 0 : rawMean - mean;
+		double lastRating = NAN;
+		int high = 0;
+		int low = (int)items.size() - 1;
+		while (high <= low) {
+			double highRating = fabs(mean + items[high].second + rowBias);
+			double lowRating = fabs(mean + items[low].second + rowBias);
+			int item = highRating >= lowRating ? items[high++].first : items[low--].first;
+			double rating = max(highRating, lowRating);
+			if (isnan(rating) || (limit >= 0 && (int)recommendations.size() >= limit && rating != lastRating)) break;
+			if (includeRatedItems == -1 && row && row[item] != 0 && row[item] * scale - rawMean != 0) continue;
+
+			recommendations.push_back(make_pair(item, rating));
+			lastRating = rating;
+		}
 	}
 
+	return this->sortRecommendations(recommendations, limit);
+}
+
+// Sorts the candidates in the arena by rating and copies out the first limit,
+// or all of them when limit is negative. With a limit only those are sorted,
+// after they are selected from the others. Items with the same rating are
+// ordered by id.
+vector<pair<int, double>> Recommender::sortRecommendations(Neighbourhood &recommendations, int limit) {
 	int recommendationsSize = recommendations.size();
-	if (!recommendationsSize) return recommendations;
+	if (!recommendationsSize) return vector<pair<int, double>>();
 
+	StatsTimer timer(Stats::SORT);
 	struct compareRecommendations {
 		inline bool operator() (const pair<int, double>& a, const pair<int, double>& b) {
-			return (a.second > b.second);
+			return a.second > b.second || (a.second == b.second && a.first < b.first);
 		}
 	};
-	sort(recommendations.begin(), recommendations.end(), compareRecommendations());
-
-	if (limit != -1 && recommendationsSize > limit) {
-		recommendations.erase(recommendations.begin() + limit, recommendations.end());
+	if (limit >= 0 && recommendationsSize > limit) {
+		recommendationsSize = limit;
+		nth_element(recommendations.begin(), recommendations.begin() + limit, recommendations.end(), compareRecommendations());
 	}
+	sort(recommendations.begin(), recommendations.begin() + recommendationsSize, compareRecommendations());
 
-	return recommendations;
+	return vector<pair<int, double>>(recommendations.begin(), recommendations.begin() + recommendationsSize);
+}
+
+bool Recommender::isCancelled() const {
+	return this->cancellationToken && this->cancellationToken->isCancelled();
 }
 
 vector<string> Recommender::readDocument(string documentFilePath) {
@@ -226,47 +818,28 @@ vector<string> Recommender::readDocument(string documentFilePath) {
 	return result;
 }
 
-vector<vector<string>> Recommender::getVocabulary(string documentsFilePath) {
-	vector<vector<string>> result;
-
-	ifstream file(documentsFilePath);
-	if (!file.good()) return result;
-	string str;
-	while (getline(file, str)) {
-		this->rawDocuments.push_back(str);
-		vector<string> document;
-		document = splitLineToWords(str);
-		result.push_back(document);
-	}
+const vector<vector<string>> &Recommender::getDocuments() const {
+	return this->documentsFile ? this->documentsFile->words : this->documents;
+}
 
-	return result;
+const vector<string> &Recommender::getRawDocuments() const {
+	return this->documentsFile ? this->documentsFile->lines : this->rawDocuments;
 }
 
 vector<string> Recommender::splitLineToWords(const string &line) {
-	vector<string> document;
-	stringstream s(line);
-	string word;
-	while (s >> word) {
-		transform(word.begin(), word.end(), word.begin(), ::tolower);
-		if (this->useStopWords) {
-			const bool isStopWord = STOP_WORDS.find(word) != STOP_WORDS.end();
-			if (isStopWord) continue;
-		}
-		document.push_back(word);
-	}
-
-	return document;
+	return Utils::splitLineToWords(line, this->useStopWords);
 }
 
-int Recommender::getNumberOfTimesTermAppears(const string& term, vector<string> document) const {
+int Recommender::getNumberOfTimesTermAppears(const string& term, const vector<string> &document) const {
 	return std::count(document.begin(), document.end(), term);
 }
 
-int Recommender::getNumberOfDocumentsWithTerm(string& term) const {
+int Recommender::getNumberOfDocumentsWithTerm(const string& term) const {
 	int count = 0;
-	int totalDocumentsSize = this->documents.size();
+	const vector<vector<string>> &documents = this->getDocuments();
+	int totalDocumentsSize = documents.size();
 	for (int i = 0; i < totalDocumentsSize; i++) {
-		if (this->getNumberOfTimesTermAppears(term, this->documents[i]) >= 1) {
+		if (this->getNumberOfTimesTermAppears(term, documents[i]) >= 1) {
 			count++;
 		}
 	}
@@ -274,8 +847,8 @@ int Recommender::getNumberOfDocumentsWithTerm(string& term) const {
 	return count;
 }
 
-double Recommender::calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, string currentTerm) const {
-	double totalDocumentsSize = this->documents.size();
+double Recommender::calculateTfIdf(int numberOfTimesTermAppears, int totalNumberOfTerms, const string &currentTerm) const {
+	double totalDocumentsSize = this->getDocuments().size();
 	double tf = numberOfTimesTermAppears / (double)totalNumberOfTerms;
 	int numberOfDocumentsWithTerm = this->getNumberOfDocumentsWithTerm(currentTerm);
 	double idf = log(totalDocumentsSize / (double)numberOfDocumentsWithTerm);
@@ -285,25 +858,17 @@ double Recommender::calculateTfIdf(int numberOfTimesTermAppears, int totalNumber
 	return tfidf;
 }
 
-vector<pair<int, double>> Recommender::getNeighbourhood(int rowIndex, int colIndex, vector<vector<double>> &ratings, vector<vector<double>> originalRatings) {
-	double normA = Utils::normalizeVector(ratings[rowIndex]);
-	vector<pair<int, double>> similarities = this->getSimilarities(ratings, normA, rowIndex, colIndex, originalRatings);
-
-	struct comparePairs {
-		inline bool operator() (const pair<int, double>& a, const pair<int, double>& b) {
-			return (a.second > b.second);
-		}
-	};
-
-	sort(similarities.begin(), similarities.end(), comparePairs());
+template <typename T>
+Recommender::Neighbourhood Recommender::getNeighbourhood(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, double normA) {
+	TraceSpan span("getNeighbourhood");
+	Neighbourhood similarities = this->getSimilarities(ratings, row, rowIndex, colIndex, normA);
+	this->sortNeighbourhood(similarities);
 
 	return similarities;
 }
 
-vector<pair<int, double>> Recommender::getNeighbourhood(int rowIndex, vector<vector<double>> &ratings, vector<vector<double>> originalRatings) {
-	double normA = Utils::normalizeVector(ratings[rowIndex]);
-	vector<pair<int, double>> similarities = this->getSimilarities(ratings, normA, rowIndex, originalRatings);
-
+void Recommender::sortNeighbourhood(Neighbourhood &similarities) const {
+	StatsTimer timer(Stats::SORT);
 	struct comparePairs {
 		inline bool operator() (const pair<int, double>& a, const pair<int, double>& b) {
 			return (a.second > b.second);
@@ -311,38 +876,113 @@ vector<pair<int, double>> Recommender::getNeighbourhood(int rowIndex, vector<vec
 	};
 
 	sort(similarities.begin(), similarities.end(), comparePairs());
-
-	return similarities;
 }
 
-vector<pair<int, double>> Recommender::getSimilarities(vector<vector<double>> &ratings, double normA, int rowIndex, int colIndex, vector<vector<double>> originalRatings) {
-	vector<pair<int, double>> similarities;
-	int ratingsSize = ratings.size();
+// Similarities of the row to all rows of ratings but rowIndex, which is -1 when
+// the row is not one of them. With a colIndex other than -1 only rows which
+// rated that column are considered. Rows with fewer co-rated items than
+// minCoRatings get a similarity of 0 without being scored.
+template <typename T>
+Recommender::Neighbourhood Recommender::getSimilarities(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, double normA) {
+	TraceSpan span("getSimilarities");
+	StatsTimer timer(Stats::SIMILARITY);
+	Neighbourhood similarities;
+	int ratingsSize = ratings.getRows();
+	int colsSize = ratings.getCols();
+	double scale = ratings.getScale();
+	similarities.reserve(ratingsSize);
+	ScratchVector<int> coRatings(ratingsSize, 0);
+	bool pruned = this->getCoRatingCounts(ratings, row, nullptr, coRatings.data());
 	for (int i = 0; i < ratingsSize; i++) {
+		if (i % CANCELLATION_CHECK_INTERVAL == 0 && this->isCancelled()) break;
 		if ((int)i == rowIndex) continue;
-		if (originalRatings[i][colIndex] != 0) {
-			double dotProduct = Utils::calculateDotProduct(originalRatings[rowIndex], originalRatings[i]);
-			vector<double> subtractedRawMeanVector = Utils::getSubtractRawMeanFromVector(ratings[i]);
-			double normB = Utils::normalizeVector(subtractedRawMeanVector);
-			double cosineSimilarity = Utils::calculateCosineSimilarity(dotProduct, normA, normB);
-			similarities.push_back(make_pair(i, cosineSimilarity));
+		if (colIndex != -1 && ratings.getRow(i)[colIndex] == 0) continue;
+		// Without co-rated items the dot product is 0, and so is the similarity.
+		if (pruned && coRatings[i] < max(1, this->minCoRatings)) {
+			similarities.push_back(make_pair(i, 0.0));
+			continue;
 		}
+		double dotProduct = Utils::calculateDotProduct(row, ratings.getRow(i), colsSize) * scale * scale;
+		double normB = Utils::getCenteredNorm(ratings.getRow(i), colsSize, scale);
+		double cosineSimilarity = Utils::calculateCosineSimilarity(dotProduct, normA, normB);
+		similarities.push_back(make_pair(i, cosineSimilarity));
 	}
 
 	return similarities;
 }
 
-vector<pair<int, double>> Recommender::getSimilarities(vector<vector<double>> &ratings, double normA, int rowIndex, vector<vector<double>> originalRatings) {
-	vector<pair<int, double>> similarities;
-	int ratingsSize = ratings.size();
+// Adds to counts[i] the number of items both row i and the row rated, from the
+// postings of the row's items when an index is given or else by looking up the
+// row's items in every row. Returns false without counting when the row rated
+// so many items that a scan would cost about as much as scoring every row.
+template <typename T>
+bool Recommender::getCoRatingCounts(const RatingMatrix<T> &ratings, const T *row, const RatingIndex *index, int *counts) const {
+	int ratingsSize = ratings.getRows();
+	int colsSize = ratings.getCols();
+	ArenaScope scope;
+	ScratchVector<int> items;
+	for (int j = 0; j < colsSize; j++) {
+		if (row[j] != 0) items.push_back(j);
+	}
+	int itemsSize = items.size();
+
+	if (index) {
+		for (int j = 0; j < itemsSize; j++) {
+			const int *rows = index->getRows(items[j]);
+			int rowsSize = index->getRowsSize(items[j]);
+			for (int k = 0; k < rowsSize; k++) counts[rows[k]]++;
+		}
+		return true;
+	}
+
+	if (this->minCoRatings <= 1 && itemsSize * CO_RATING_SCAN_MAX_SHARE > colsSize) return false;
 	for (int i = 0; i < ratingsSize; i++) {
-		if ((int)i == rowIndex) continue;
-		double dotProduct = Utils::calculateDotProduct(originalRatings[rowIndex], originalRatings[i]);
-		vector<double> subtractedRawMeanVector = Utils::getSubtractRawMeanFromVector(ratings[i]);
-		double normB = Utils::normalizeVector(subtractedRawMeanVector);
-		double cosineSimilarity = Utils::calculateCosineSimilarity(dotProduct, normA, normB);
-		similarities.push_back(make_pair(i, cosineSimilarity));
+		const T *candidate = ratings.getRow(i);
+		int count = 0;
+		for (int j = 0; j < itemsSize; j++) {
+			if (candidate[items[j]] != 0) count++;
+		}
+		counts[i] += count;
 	}
 
-	return similarities;
-}
\ No newline at end of file
+	return true;
+}
+
+#define INSTANTIATE_RATING_STORAGE(T) \
+	template double Recommender::getRatingPrediction<T>(const RatingMatrix<T> &ratings, int rowIndex, int colIndex); \
+	template double Recommender::getGlobalBaselineRatingPrediction<T>(const RatingMatrix<T> &ratings, int rowIndex, int colIndex); \
+	template vector<pair<int, double>> Recommender::getTopCFRecommendations<T>(const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems); \
+	template int Recommender::getAllTopCFRecommendations<T>(const RatingMatrix<T> &ratings, const vector<int> &rowIndexes, int limit, int includeRatedItems, \
+		int chunkSize, int threads, const function<void(const TopCFChunk &)> &onChunk); \
+	template int Recommender::getRatingPredictionSums<T>(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, \
+		double &ratingsSum, double &similaritiesSum); \
+	template vector<pair<int, double>> Recommender::getHybridRecommendations<T>(const RatingMatrix<T> &ratings, int rowIndex, int limit, \
+		int includeRatedItems, int shrinkage); \
+	template vector<pair<int, double>> Recommender::getGlobalBaselineRecommendations<T>(const RatingMatrix<T> &ratings, int rowIndex, int limit, \
+		int includeRatedItems); \
+	template int Recommender::getTopCFSums<T>(const RatingMatrix<T> &ratings, const T *row, int rowIndex, vector<double> &ratingsSums, \
+		double &similaritiesSum, double *ratersCounts, const RatedItems *ratedItems); \
+	template vector<pair<int, double>> Recommender::rankTopCF<T>(const T *row, int cols, double scale, const double *ratingsSums, \
+		double similaritiesSum, int limit, int includeRatedItems); \
+	template vector<pair<int, double>> Recommender::rankHybrid<T>(const T *row, int cols, double scale, const double *ratingsSums, \
+		const double *ratersCounts, double similaritiesSum, double mean, const double *colMeans, int limit, int includeRatedItems, int shrinkage); \
+	template vector<pair<int, double>> Recommender::rankGlobalBaseline<T>(const T *row, int cols, double scale, const ItemBiasIndex &index, \
+		int limit, int includeRatedItems); \
+	template vector<pair<int, double>> Recommender::computeTopCFRecommendations<T>(const RatingMatrix<T> &ratings, int rowIndex, int limit, \
+		int includeRatedItems); \
+	template double Recommender::getColMeans<T>(const RatingMatrix<T> &ratings, double *colMeans); \
+	template vector<pair<int, double>> Recommender::predictTopCF<T>(const RatingMatrix<T> &ratings, int rowIndex, \
+		const Neighbourhood &neighbourhood, int limit, int includeRatedItems, const RatedItems *ratedItems); \
+	template Recommender::Neighbourhood Recommender::getSimilarities<T>(const RatingMatrix<T> &ratings, const T *row, int rowIndex, int colIndex, double normA); \
+	template bool Recommender::getCoRatingCounts<T>(const RatingMatrix<T> &ratings, const T *row, const RatingIndex *index, int *counts) const;
+
+INSTANTIATE_RATING_STORAGE(double)
+INSTANTIATE_RATING_STORAGE(float)
+INSTANTIATE_RATING_STORAGE(uint8_t)
+
+#define INSTANTIATE_BINARY_SIMILARITY(S) \
+	template vector<pair<int, double>> Recommender::getBinaryRecommendations<S>(const BinaryMatrix &interactions, int rowIndex, int limit, \
+		int includeRatedItems);
+
+INSTANTIATE_BINARY_SIMILARITY(CosineSimilarity)
+INSTANTIATE_BINARY_SIMILARITY(JaccardSimilarity)
@@ -0,0 +1,59 @@
+#include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/BinaryMatrix.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+template <typename S>
+class BinaryRecommendationsWorker : public RecommenderWorker {
+public:
+	BinaryRecommendationsWorker(Callback *callback, Recommender recommender, const BinaryMatrix &interactions, int rowIndex, int limit,
+		int includeRatedItems) :
+		RecommenderWorker(callback, recommender),
+		interactions(interactions),
+		rowIndex(rowIndex),
+		limit(limit),
+		includeRatedItems(includeRatedItems) {
+		this->external.set(this->interactions.getBytes());
+	}
+
+	void Compute() {
+		this->result = this->recommender.getBinaryRecommendations<S>(this->interactions, this->rowIndex, this->limit, this->includeRatedItems);
+	}
+
+	Local<Value> GetResult() {
+		Local<Array> result = New<v8::Array>(this->result.size());
+		Local<String> itemIdProp = Nan::New<String>("itemId").ToLocalChecked();
+		Local<String> ratingProp = Nan::New<String>("rating").ToLocalChecked();
+		for (unsigned i = 0; i < this->result.size(); i++) {
+			Local<Object> obj = Nan::New<Object>();
+			Nan::Set(obj, itemIdProp, Nan::New<Number>(this->result[i].first));
+			Nan::Set(obj, ratingProp, Nan::New<Number>(this->result[i].second));
+			Nan::Set(result, i, obj);
+		}
+
+		return result;
+	}
+
+	string GetCoalescingKey() {
+		return string("binary|") + S::getName() + "|" + to_string(this->interactions.getVersion()) + "|" + to_string(this->rowIndex) + "|" +
+			to_string(this->limit) + "|" + to_string(this->includeRatedItems) + "|" + to_string(this->recommender.minCoRatings);
+	}
+
+	// The key names the worker and its similarity, so the leader has this type.
+	bool HasSameArguments(RecommenderWorker *leader) {
+		return this->interactions.equals(static_cast<BinaryRecommendationsWorker<S> *>(leader)->interactions);
+	}
+
+private:
+	BinaryMatrix interactions;
+	ExternalMemory external;
+	int rowIndex;
+	int limit;
+	int includeRatedItems;
+	vector<pair<int, double>> result;
+};
@@ -1,33 +1,49 @@
 #include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
 #include "../../include/recommender.h"
+#include "../../include/Utils.h"
+#include "../../include/RatingMatrix.h"
 
 using namespace std;
 using namespace Nan;
 using namespace v8;
 
-class CollaborativeFilteringWorker : public AsyncWorker {
+template <typename T>
+class CollaborativeFilteringWorker : public RecommenderWorker {
 public:
-	CollaborativeFilteringWorker(Callback * callback, Recommender recommender, vector<vector<double>> ratings, int rowIndex, int colIndex):
-		AsyncWorker(callback),
-		recommender(recommender),
+	CollaborativeFilteringWorker(Callback * callback, Recommender recommender, const RatingMatrix<T> &ratings, int rowIndex, int colIndex):
+		RecommenderWorker(callback, recommender),
 		ratings(ratings),
 		rowIndex(rowIndex),
-		colIndex(colIndex) {}
+		colIndex(colIndex),
+		ratingPrediction(0) {
+		this->external.set(this->ratings.getBytes());
+	}
 
-	void Execute() {
+	void Compute() {
 		this->ratingPrediction = this->recommender.getRatingPrediction(this->ratings, this->rowIndex, this->colIndex);
 	}
 
-	void HandleOKCallback() {
-		Local<Number> result = Nan::New(this->ratingPrediction);
-		Local<Value> argv[] = { result };
-		callback->Call(1, argv);
+	Local<Value> GetResult() {
+		return Nan::New(this->ratingPrediction);
+	}
+
+	string GetCoalescingKey() {
+		return string("prediction|") + StorageTraits<T>::getName() + "|" +
+			to_string(this->ratings.getVersion()) + "|" + to_string(this->rowIndex) + "|" +
+			to_string(this->colIndex) + "|" + to_string(this->recommender.minCoRatings);
+	}
+
+	// The key names the worker and its storage, so the leader has this type.
+	bool HasSameArguments(RecommenderWorker *leader) {
+		return this->ratings.equals(static_cast<CollaborativeFilteringWorker<T> *>(leader)->ratings);
 	}
 
 private:
-	Recommender recommender;
-	vector<vector<double>> ratings;
+	RatingMatrix<T> ratings;
+	ExternalMemory external;
 	int rowIndex;
 	int colIndex;
 	double ratingPrediction;
-};
\ No newline at end of file
+};
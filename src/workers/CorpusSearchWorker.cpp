@@ -0,0 +1,58 @@
+#include <memory>
+#include <stdint.h>
+#include "nan.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/Sharding.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+class CorpusSearchWorker : public RecommenderWorker {
+public:
+	CorpusSearchWorker(Callback *callback, Recommender recommender, shared_ptr<const ShardedCorpus> corpus, string query, int limit,
+		shared_ptr<CorpusStats> stats, CorpusScoring scoring, int threads) :
+		RecommenderWorker(callback, recommender),
+		corpus(corpus),
+		query(query),
+		limit(limit),
+		stats(stats),
+		scoring(scoring),
+		threads(threads) {}
+
+	void Compute() {
+		this->result = this->corpus->search(this->query, this->limit, this->threads, this->stats.get(), this->scoring);
+	}
+
+	Local<Value> GetResult() {
+		Local<Array> result = New<v8::Array>(this->result.size());
+		Local<String> idProp = Nan::New<String>("id").ToLocalChecked();
+		Local<String> scoreProp = Nan::New<String>("score").ToLocalChecked();
+		for (unsigned i = 0; i < this->result.size(); i++) {
+			Local<Object> obj = Nan::New<Object>();
+			Nan::Set(obj, idProp, Nan::New<Number>(this->result[i].first));
+			Nan::Set(obj, scoreProp, Nan::New<Number>(this->result[i].second));
+			Nan::Set(result, i, obj);
+		}
+
+		return result;
+	}
+
+	// The worker holds the corpus while it is in flight, so no other corpus
+	// can have its address until then.
+	string GetCoalescingKey() {
+		if (this->stats) return "";
+		return "search|" + to_string((uintptr_t)this->corpus.get()) + "|" + to_string(this->limit) + "|" + to_string(this->scoring) + "|" +
+			this->query;
+	}
+
+private:
+	shared_ptr<const ShardedCorpus> corpus;
+	string query;
+	int limit;
+	shared_ptr<CorpusStats> stats;
+	CorpusScoring scoring;
+	int threads;
+	vector<pair<int, double>> result;
+};
@@ -0,0 +1,61 @@
+#include <math.h>
+#include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/Evaluation.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// The metrics of the predictor which was evaluated, as an object.
+Local<Object> convertEvaluationResultToV8Object(const EvaluationResult &result, EvaluationPredictor predictor) {
+	Local<Object> object = Nan::New<Object>();
+	if (predictor == PREDICTOR_TOP_CF) {
+		Nan::Set(object, Nan::New<String>("precision").ToLocalChecked(), Nan::New<Number>(result.precision));
+		Nan::Set(object, Nan::New<String>("recall").ToLocalChecked(), Nan::New<Number>(result.recall));
+	} else {
+		Nan::Set(object, Nan::New<String>("rmse").ToLocalChecked(), Nan::New<Number>(result.rmse));
+		Nan::Set(object, Nan::New<String>("mae").ToLocalChecked(), Nan::New<Number>(result.mae));
+		Nan::Set(object, Nan::New<String>("predictions").ToLocalChecked(), Nan::New<Number>(result.predictions));
+	}
+	Nan::Set(object, Nan::New<String>("testRatings").ToLocalChecked(), Nan::New<Number>(result.testRatings));
+	Nan::Set(object, Nan::New<String>("users").ToLocalChecked(), Nan::New<Number>(result.users));
+	Nan::Set(object, Nan::New<String>("folds").ToLocalChecked(), Nan::New<Number>(result.folds));
+
+	return object;
+}
+
+// Runs an evaluation on the pool, which spreads the users of every fold over
+// threads threads of its own.
+template <typename T>
+class EvaluationWorker : public RecommenderWorker {
+public:
+	EvaluationWorker(Callback *callback, Recommender recommender, const vector<vector<double>> &ratings, const EvaluationOptions &options,
+		int threads) :
+		RecommenderWorker(callback, recommender),
+		ratings(ratings),
+		options(options),
+		threads(threads) {
+		size_t bytes = 0;
+		for (const vector<double> &row : this->ratings) bytes += row.size() * sizeof(double);
+		this->external.set(bytes);
+	}
+
+	void Compute() {
+		Evaluator evaluator(this->recommender, this->options);
+		this->result = evaluator.evaluate<T>(this->ratings, this->threads);
+	}
+
+	Local<Value> GetResult() {
+		return convertEvaluationResultToV8Object(this->result, this->options.predictor);
+	}
+
+private:
+	vector<vector<double>> ratings;
+	ExternalMemory external;
+	EvaluationOptions options;
+	int threads;
+	EvaluationResult result;
+};
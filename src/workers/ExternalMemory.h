@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef EXTERNAL_MEMORY_H
+#define EXTERNAL_MEMORY_H
+
+#include <stdint.h>
+#include "nan.h"
+
+using namespace v8;
+
+// Native bytes which a JS object or a worker holds, reported to V8 so that heap
+// stats show them and the garbage collector knows what collecting the holder
+// would free. Only used on the JS thread, where the holder is created and
+// destroyed.
+class ExternalMemory {
+public:
+	ExternalMemory() : bytes(0) {}
+
+	~ExternalMemory() {
+		this->set(0);
+	}
+
+	void set(int64_t bytes) {
+		if (bytes == this->bytes) return;
+		Isolate::GetCurrent()->AdjustAmountOfExternalAllocatedMemory(bytes - this->bytes);
+		this->bytes = bytes;
+	}
+
+private:
+	int64_t bytes;
+};
+
+#endif
@@ -1,33 +1,48 @@
 #include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
 #include "../../include/recommender.h"
+#include "../../include/Utils.h"
+#include "../../include/RatingMatrix.h"
 
 using namespace std;
 using namespace Nan;
 using namespace v8;
 
-class GlobalBaselineWorker : public AsyncWorker {
+template <typename T>
+class GlobalBaselineWorker : public RecommenderWorker {
 public:
-	GlobalBaselineWorker(Callback * callback, Recommender recommender, vector<vector<double>> ratings, int rowIndex, int colIndex) :
-		AsyncWorker(callback),
-		recommender(recommender),
+	GlobalBaselineWorker(Callback * callback, Recommender recommender, const RatingMatrix<T> &ratings, int rowIndex, int colIndex) :
+		RecommenderWorker(callback, recommender),
 		ratings(ratings),
 		rowIndex(rowIndex),
-		colIndex(colIndex) {}
+		colIndex(colIndex),
+		ratingPrediction(0) {
+		this->external.set(this->ratings.getBytes());
+	}
 
-	void Execute() {
+	void Compute() {
 		this->ratingPrediction = this->recommender.getGlobalBaselineRatingPrediction(this->ratings, this->rowIndex, this->colIndex);
 	}
 
-	void HandleOKCallback() {
-		Local<Number> result = Nan::New(this->ratingPrediction);
-		Local<Value> argv[] = { result };
-		callback->Call(1, argv);
+	Local<Value> GetResult() {
+		return Nan::New(this->ratingPrediction);
+	}
+
+	string GetCoalescingKey() {
+		return string("baselinePrediction|") + StorageTraits<T>::getName() + "|" +
+			to_string(this->ratings.getVersion()) + "|" + to_string(this->rowIndex) + "|" + to_string(this->colIndex);
+	}
+
+	// The key names the worker and its storage, so the leader has this type.
+	bool HasSameArguments(RecommenderWorker *leader) {
+		return this->ratings.equals(static_cast<GlobalBaselineWorker<T> *>(leader)->ratings);
 	}
 
 private:
-	Recommender recommender;
-	vector<vector<double>> ratings;
+	RatingMatrix<T> ratings;
+	ExternalMemory external;
 	int rowIndex;
 	int colIndex;
 	double ratingPrediction;
-};
\ No newline at end of file
+};
@@ -0,0 +1,64 @@
+#include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/RatingMatrix.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+template <typename T>
+class HybridRecommendationsWorker : public RecommenderWorker {
+public:
+	HybridRecommendationsWorker(Callback *callback, Recommender recommender, const RatingMatrix<T> &ratings, int rowIndex, int limit,
+		int includeRatedItems, int shrinkage) :
+		RecommenderWorker(callback, recommender),
+		ratings(ratings),
+		rowIndex(rowIndex),
+		limit(limit),
+		includeRatedItems(includeRatedItems),
+		shrinkage(shrinkage) {
+		this->external.set(this->ratings.getBytes());
+	}
+
+	void Compute() {
+		this->result = this->recommender.getHybridRecommendations(this->ratings, this->rowIndex, this->limit, this->includeRatedItems,
+			this->shrinkage);
+	}
+
+	Local<Value> GetResult() {
+		Local<Array> result = New<v8::Array>(this->result.size());
+		Local<String> itemIdProp = Nan::New<String>("itemId").ToLocalChecked();
+		Local<String> ratingProp = Nan::New<String>("rating").ToLocalChecked();
+		for (unsigned i = 0; i < this->result.size(); i++) {
+			Local<Object> obj = Nan::New<Object>();
+			Nan::Set(obj, itemIdProp, Nan::New<Number>(this->result[i].first));
+			Nan::Set(obj, ratingProp, Nan::New<Number>(this->result[i].second));
+			Nan::Set(result, i, obj);
+		}
+
+		return result;
+	}
+
+	string GetCoalescingKey() {
+		return string("hybrid|") + StorageTraits<T>::getName() + "|" +
+			to_string(this->ratings.getVersion()) + "|" + to_string(this->rowIndex) + "|" + to_string(this->limit) + "|" +
+			to_string(this->includeRatedItems) + "|" + to_string(this->recommender.minCoRatings) + "|" +
+			to_string(this->shrinkage);
+	}
+
+	// The key names the worker and its storage, so the leader has this type.
+	bool HasSameArguments(RecommenderWorker *leader) {
+		return this->ratings.equals(static_cast<HybridRecommendationsWorker<T> *>(leader)->ratings);
+	}
+
+private:
+	RatingMatrix<T> ratings;
+	ExternalMemory external;
+	int rowIndex;
+	int limit;
+	int includeRatedItems;
+	int shrinkage;
+	vector<pair<int, double>> result;
+};
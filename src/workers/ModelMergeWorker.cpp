@@ -0,0 +1,58 @@
+#include <memory>
+#include <functional>
+#include "nan.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/Sharding.h"
+#include "../../include/RatingDelta.h"
+#include "../../include/Snapshot.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// Merges the ratings a merge took from the delta of a rating model into a new
+// version of the model on the pool, and publishes it unless a later version
+// was published first. The model and the version are those of when the merge
+// was made, like those of an update. The delta is told how the merge went
+// right after it was published, so the ratings are read alongside one model
+// or the other the whole time. Merges are not cancelled, since the delta
+// waits for them to finish.
+class ModelMergeWorker : public RecommenderWorker {
+public:
+	ModelMergeWorker(Callback *callback, shared_ptr<Snapshot<ShardedRatingModel>> snapshot, shared_ptr<RatingDelta> delta,
+		shared_ptr<const DeltaRows> rows, function<void()> onPublished) :
+		RecommenderWorker(callback, Recommender()),
+		snapshot(snapshot),
+		delta(delta),
+		rows(rows),
+		onPublished(onPublished),
+		model(snapshot->get()),
+		version(snapshot->reserve()),
+		published(false) {}
+
+	void Compute() {
+		shared_ptr<const ShardedRatingModel> model = make_shared<const ShardedRatingModel>(*this->model, *this->rows);
+		this->model.reset();
+		this->published = model->isValid() && this->snapshot->publish(model, this->version);
+		this->delta->finishMerge(this->published);
+	}
+
+	void HandleOKCallback() {
+		if (this->published) this->onPublished();
+		RecommenderWorker::HandleOKCallback();
+	}
+
+	Local<Value> GetResult() {
+		return Nan::New<Boolean>(this->published);
+	}
+
+private:
+	shared_ptr<Snapshot<ShardedRatingModel>> snapshot;
+	shared_ptr<RatingDelta> delta;
+	shared_ptr<const DeltaRows> rows;
+	function<void()> onPublished;
+	shared_ptr<const ShardedRatingModel> model;
+	uint64_t version;
+	bool published;
+};
@@ -0,0 +1,51 @@
+#include <memory>
+#include <functional>
+#include "nan.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/Snapshot.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// Builds or loads a new version of a model on the pool and publishes it, while
+// queries keep running on the version they started with. The version is
+// reserved when the update is queued, so updates are published in the order
+// they were made. onPublished runs on the JS thread once a version was
+// published, before the callback.
+template <typename Model>
+class ModelUpdateWorker : public RecommenderWorker {
+public:
+	ModelUpdateWorker(Callback *callback, Recommender recommender, shared_ptr<Snapshot<Model>> snapshot, function<shared_ptr<const Model>()> build,
+		function<void()> onPublished) :
+		RecommenderWorker(callback, recommender),
+		snapshot(snapshot),
+		build(build),
+		onPublished(onPublished),
+		version(snapshot->reserve()),
+		published(false) {}
+
+	void Compute() {
+		shared_ptr<const Model> model = this->build();
+		if (!model->isValid()) return;
+		if (this->recommender.cancellationToken && this->recommender.cancellationToken->isCancelled()) return;
+		this->published = this->snapshot->publish(model, this->version);
+	}
+
+	void HandleOKCallback() {
+		if (this->published) this->onPublished();
+		RecommenderWorker::HandleOKCallback();
+	}
+
+	Local<Value> GetResult() {
+		return Nan::New<Boolean>(this->published);
+	}
+
+private:
+	shared_ptr<Snapshot<Model>> snapshot;
+	function<shared_ptr<const Model>()> build;
+	function<void()> onPublished;
+	uint64_t version;
+	bool published;
+};
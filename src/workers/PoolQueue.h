@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef POOL_QUEUE_H
+#define POOL_QUEUE_H
+
+#include <mutex>
+#include <vector>
+#include "nan.h"
+#include "../../include/WorkerPool.h"
+#include "../../include/Stats.h"
+#include "../../include/Trace.h"
+
+using namespace std;
+using namespace Nan;
+
+// Replacement for Nan::AsyncQueueWorker: Execute() runs on the WorkerPool and
+// all finished workers are handed back to the loop through a single uv_async
+// handle, which is only referenced while work is in flight.
+//
+// The pool is shared by every environment which loads the addon, such as the
+// main thread and worker threads, but each of them has its own queue on its own
+// loop. When an environment is torn down its queue is closed, and workers which
+// finish after that are dropped, since their callbacks can't run any more.
+class PoolQueue {
+public:
+	static void Queue(AsyncWorker *worker, WorkerPool::Priority priority) {
+		PoolQueue *queue = PoolQueue::getCurrent();
+		if (queue->inFlight++ == 0) uv_ref(reinterpret_cast<uv_handle_t *>(&queue->completionHandle));
+
+		bool timed = Stats::getInstance().isEnabled();
+		bool traced = Trace::getInstance().isEnabled();
+		uint64_t queued = timed || traced ? Trace::now() : 0;
+
+		WorkerPool::getInstance().submit([queue, worker, timed, traced, queued]() {
+			if (timed || traced) {
+				uint64_t started = Trace::now();
+				if (timed) Stats::getInstance().record(Stats::QUEUE_WAIT, started - queued);
+				if (traced) Trace::getInstance().record("queue", "worker", queued, started);
+			}
+			{
+				StatsTimer timer(Stats::EXECUTE);
+				worker->Execute();
+			}
+
+			lock_guard<mutex> guard(queue->lock);
+			if (queue->closed) return;
+			queue->completed.push_back(worker);
+			uv_async_send(&queue->completionHandle);
+		}, priority);
+	}
+
+private:
+	uv_async_t completionHandle;
+	mutex lock;
+	vector<AsyncWorker *> completed;
+	int inFlight;
+	bool closed;
+
+	explicit PoolQueue(uv_loop_t *loop) : inFlight(0), closed(false) {
+		uv_async_init(loop, &this->completionHandle, PoolQueue::OnComplete);
+		this->completionHandle.data = this;
+		uv_unref(reinterpret_cast<uv_handle_t *>(&this->completionHandle));
+	}
+
+	// Every environment runs on its own thread. A closed queue is never
+	// freed, since tasks still on the pool may hold it.
+	static PoolQueue *getCurrent() {
+		static thread_local PoolQueue *queue = NULL;
+		if (!queue) {
+			queue = new PoolQueue(Nan::GetCurrentEventLoop());
+#if NODE_MODULE_VERSION >= NODE_10_0_MODULE_VERSION
+			node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), PoolQueue::OnCleanup, queue);
+#endif
+		}
+
+		return queue;
+	}
+
+	static void OnCleanup(void *data) {
+		PoolQueue *queue = static_cast<PoolQueue *>(data);
+		lock_guard<mutex> guard(queue->lock);
+		queue->closed = true;
+		uv_close(reinterpret_cast<uv_handle_t *>(&queue->completionHandle), NULL);
+	}
+
+	static NAUV_WORK_CB(OnComplete) {
+		PoolQueue *queue = static_cast<PoolQueue *>(async->data);
+		vector<AsyncWorker *> completed;
+		{
+			lock_guard<mutex> guard(queue->lock);
+			completed.swap(queue->completed);
+		}
+
+		int completedSize = completed.size();
+		for (int i = 0; i < completedSize; i++) {
+			{
+				TraceSpan span("callback", "worker");
+				completed[i]->WorkComplete();
+			}
+			completed[i]->Destroy();
+		}
+
+		queue->inFlight -= completedSize;
+		if (queue->inFlight == 0) uv_unref(reinterpret_cast<uv_handle_t *>(&queue->completionHandle));
+	}
+};
+
+#endif
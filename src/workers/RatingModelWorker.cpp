@@ -0,0 +1,87 @@
+#include <memory>
+#include <stdint.h>
+#include "nan.h"
+#include "RecommenderWorker.h"
+#include "../../include/recommender.h"
+#include "../../include/Sharding.h"
+#include "../../include/RatingDelta.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// Runs one of the prediction methods of a sharded rating model on the pool,
+// with the ratings added to it when the method was called.
+class RatingModelWorker : public RecommenderWorker {
+public:
+	enum Method { TOP_CF, HYBRID, BASELINE_TOP, PREDICTION, BASELINE };
+
+	RatingModelWorker(Callback *callback, Recommender recommender, shared_ptr<const ShardedRatingModel> model, shared_ptr<const DeltaRows> delta,
+		Method method, int rowIndex, int colIndex, int limit, int includeRatedItems, int shrinkage, int threads) :
+		RecommenderWorker(callback, recommender),
+		model(model),
+		delta(delta),
+		method(method),
+		rowIndex(rowIndex),
+		colIndex(colIndex),
+		limit(limit),
+		includeRatedItems(includeRatedItems),
+		shrinkage(shrinkage),
+		threads(threads),
+		prediction(0) {}
+
+	void Compute() {
+		if (this->method == TOP_CF) {
+			this->recommendations = this->model->getTopCFRecommendations(this->recommender, this->rowIndex, this->limit, this->includeRatedItems,
+				this->threads, this->delta.get());
+		} else if (this->method == HYBRID) {
+			this->recommendations = this->model->getHybridRecommendations(this->recommender, this->rowIndex, this->limit, this->includeRatedItems,
+				this->shrinkage, this->threads, this->delta.get());
+		} else if (this->method == BASELINE_TOP) {
+			this->recommendations = this->model->getGlobalBaselineRecommendations(this->rowIndex, this->limit, this->includeRatedItems,
+				this->delta.get());
+		} else if (this->method == PREDICTION) {
+			this->prediction = this->model->getRatingPrediction(this->recommender, this->rowIndex, this->colIndex, this->threads, this->delta.get());
+		} else {
+			this->prediction = this->model->getGlobalBaselineRatingPrediction(this->rowIndex, this->colIndex, this->delta.get());
+		}
+	}
+
+	Local<Value> GetResult() {
+		if (this->method == PREDICTION || this->method == BASELINE) return Nan::New(this->prediction);
+
+		Local<Array> result = New<v8::Array>(this->recommendations.size());
+		Local<String> itemIdProp = Nan::New<String>("itemId").ToLocalChecked();
+		Local<String> ratingProp = Nan::New<String>("rating").ToLocalChecked();
+		for (unsigned i = 0; i < this->recommendations.size(); i++) {
+			Local<Object> obj = Nan::New<Object>();
+			Nan::Set(obj, itemIdProp, Nan::New<Number>(this->recommendations[i].first));
+			Nan::Set(obj, ratingProp, Nan::New<Number>(this->recommendations[i].second));
+			Nan::Set(result, i, obj);
+		}
+
+		return result;
+	}
+
+	// The worker holds the model and the delta while it is in flight, so no
+	// others can have their addresses until then.
+	string GetCoalescingKey() {
+		return "model|" + to_string((uintptr_t)this->model.get()) + "|" + to_string((uintptr_t)this->delta.get()) + "|" +
+			to_string(this->method) + "|" + to_string(this->rowIndex) + "|" +
+			to_string(this->colIndex) + "|" + to_string(this->limit) + "|" + to_string(this->includeRatedItems) + "|" +
+			to_string(this->recommender.minCoRatings) + "|" + to_string(this->shrinkage);
+	}
+
+private:
+	shared_ptr<const ShardedRatingModel> model;
+	shared_ptr<const DeltaRows> delta;
+	Method method;
+	int rowIndex;
+	int colIndex;
+	int limit;
+	int includeRatedItems;
+	int shrinkage;
+	int threads;
+	double prediction;
+	vector<pair<int, double>> recommendations;
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#ifndef RECOMMENDER_WORKER_H
+#define RECOMMENDER_WORKER_H
+
+#include <exception>
+#include <memory>
+#include <map>
+#include <string>
+#include <vector>
+#include "nan.h"
+#include "../../include/recommender.h"
+#include "../../include/CancellationToken.h"
+#include "../../include/Stats.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// Bound as the 'abort' listener of an AbortSignal. The listener function keeps
+// the wrapped holder alive, so the token outlives the worker if it has to.
+class AbortListener : public ObjectWrap {
+public:
+	static Local<Function> Create(shared_ptr<CancellationToken> token) {
+		Local<ObjectTemplate> holderTemplate = Nan::New<ObjectTemplate>();
+		holderTemplate->SetInternalFieldCount(1);
+		Local<Object> holder = Nan::NewInstance(holderTemplate).ToLocalChecked();
+		AbortListener *listener = new AbortListener(token);
+		listener->Wrap(holder);
+
+		return Nan::GetFunction(Nan::New<FunctionTemplate>(OnAbort, holder)).ToLocalChecked();
+	}
+
+private:
+	shared_ptr<CancellationToken> token;
+
+	explicit AbortListener(shared_ptr<CancellationToken> token) : token(token) {}
+
+	static NAN_METHOD(OnAbort) {
+		AbortListener *listener = ObjectWrap::Unwrap<AbortListener>(info.Data().As<Object>());
+		listener->token->abort();
+	}
+};
+
+// Common base of all async workers. Work whose deadline has passed or whose
+// signal was aborted while it sat in the queue is not started at all, and the
+// callback receives a second status argument whenever the work was cut short.
+//
+// Identical requests that arrive while one is in flight are coalesced: the
+// later ones hand their callbacks to the worker already running and are
+// dropped. Coalescing only happens on the JS thread, and every environment
+// which loads the addon has its own thread and registry, so the registry needs
+// no locking.
+class RecommenderWorker : public AsyncWorker {
+public:
+	RecommenderWorker(Callback *callback, Recommender recommender) :
+		AsyncWorker(callback),
+		recommender(recommender) {}
+
+	~RecommenderWorker() {
+		this->LeaveInFlight();
+		int followersSize = this->followers.size();
+		for (int i = 0; i < followersSize; i++) {
+			delete this->followers[i];
+		}
+	}
+
+	// Returns true if an identical request is in flight and this worker's
+	// callback was handed over to it. The caller must then delete this worker.
+	bool JoinInFlight(const string &key) {
+		map<string, RecommenderWorker *> &inFlight = RecommenderWorker::getInFlight();
+		map<string, RecommenderWorker *>::iterator leader = inFlight.find(key);
+		if (leader != inFlight.end()) {
+			if (!this->HasSameArguments(leader->second)) return false;
+			leader->second->followers.push_back(this->callback);
+			this->callback = NULL;
+			return true;
+		}
+
+		inFlight[key] = this;
+		this->inFlightKey = key;
+
+		return false;
+	}
+
+	// Errors thrown on the pool, such as bad_alloc rethrown by a parallelFor,
+	// reach the callback as an Error instead of ending the process.
+	void Execute() {
+		if (this->recommender.cancellationToken && this->recommender.cancellationToken->isCancelled()) return;
+		try {
+			this->Compute();
+		} catch (const exception &error) {
+			this->SetErrorMessage(error.what());
+		}
+	}
+
+	void HandleOKCallback() {
+		HandleScope scope;
+		this->DetachAbortSignal();
+		// Requests made from within the callbacks must start a new computation.
+		this->LeaveInFlight();
+		if (this->recommender.cancellationToken && this->recommender.cancellationToken->getState() != CancellationToken::ACTIVE) {
+			Stats::getInstance().add(Stats::CANCELLED);
+		}
+
+		this->CallWithResult(callback);
+		int followersSize = this->followers.size();
+		for (int i = 0; i < followersSize; i++) {
+			this->CallWithResult(this->followers[i]);
+		}
+	}
+
+	void HandleErrorCallback() {
+		HandleScope scope;
+		this->DetachAbortSignal();
+		this->LeaveInFlight();
+		if (this->callback) {
+			Local<Value> argv[] = { Nan::Error(this->ErrorMessage()) };
+			this->callback->Call(1, argv);
+		}
+		int followersSize = this->followers.size();
+		for (int i = 0; i < followersSize; i++) {
+			Local<Value> argv[] = { Nan::Error(this->ErrorMessage()) };
+			this->followers[i]->Call(1, argv);
+		}
+	}
+
+	// Subscribes to an AbortSignal-compatible object ({ aborted, addEventListener }).
+	void AttachAbortSignal(Local<Object> signal) {
+		if (!this->recommender.cancellationToken) {
+			this->recommender.cancellationToken = make_shared<CancellationToken>();
+		}
+		Local<Value> aborted = Nan::Get(signal, Nan::New<String>("aborted").ToLocalChecked()).ToLocalChecked();
+		if (aborted->BooleanValue()) {
+			this->recommender.cancellationToken->abort();
+			return;
+		}
+
+		Local<Value> addEventListener = Nan::Get(signal, Nan::New<String>("addEventListener").ToLocalChecked()).ToLocalChecked();
+		if (!addEventListener->IsFunction()) return;
+
+		Local<Function> listener = AbortListener::Create(this->recommender.cancellationToken);
+		Local<Value> argv[] = { Nan::New<String>("abort").ToLocalChecked(), listener };
+		Nan::Call(addEventListener.As<Function>(), signal, 2, argv);
+		SaveToPersistent("signal", signal);
+		SaveToPersistent("abortListener", listener);
+	}
+
+	// Key of the request for coalescing, or an empty string if it should not
+	// be coalesced. The content hash of the ratings or documents stands in for
+	// the model version.
+	virtual string GetCoalescingKey() {
+		return "";
+	}
+
+	// Whether the arguments are those of the leader whose key matched. Keys
+	// built from a content hash can collide, so those workers compare the
+	// content itself. Leaders only read their arguments on the pool.
+	virtual bool HasSameArguments(RecommenderWorker *leader) {
+		return true;
+	}
+
+protected:
+	Recommender recommender;
+
+	virtual void Compute() = 0;
+	virtual Local<Value> GetResult() = 0;
+
+private:
+	string inFlightKey;
+	vector<Callback *> followers;
+
+	static map<string, RecommenderWorker *>& getInFlight() {
+		static thread_local map<string, RecommenderWorker *> inFlight;
+		return inFlight;
+	}
+
+	void LeaveInFlight() {
+		if (this->inFlightKey.empty()) return;
+
+		map<string, RecommenderWorker *> &inFlight = RecommenderWorker::getInFlight();
+		map<string, RecommenderWorker *>::iterator entry = inFlight.find(this->inFlightKey);
+		if (entry != inFlight.end() && entry->second == this) inFlight.erase(entry);
+		this->inFlightKey.clear();
+	}
+
+	// Every caller gets its own copy of the result, so callbacks cannot see
+	// each other's mutations. Workers queued without a callback, such as
+	// background merges, have no target.
+	void CallWithResult(Callback *target) {
+		if (!target) return;
+
+		Local<Value> result;
+		{
+			StatsTimer timer(Stats::CONVERT);
+			result = this->GetResult();
+		}
+		CancellationToken::State state = CancellationToken::ACTIVE;
+		if (this->recommender.cancellationToken) state = this->recommender.cancellationToken->getState();
+
+		if (state == CancellationToken::ACTIVE) {
+			Local<Value> argv[] = { result };
+			target->Call(1, argv);
+			return;
+		}
+
+		Local<Object> status = Nan::New<Object>();
+		Nan::Set(status, Nan::New<String>("cancelled").ToLocalChecked(), Nan::True());
+		Nan::Set(status, Nan::New<String>("reason").ToLocalChecked(),
+			Nan::New<String>(state == CancellationToken::TIMED_OUT ? "timeout" : "abort").ToLocalChecked());
+		Local<Value> argv[] = { result, status };
+		target->Call(2, argv);
+	}
+
+	void DetachAbortSignal() {
+		Local<Value> signal = GetFromPersistent("signal");
+		if (!signal->IsObject()) return;
+
+		Local<Object> signalObject = signal.As<Object>();
+		Local<Value> removeEventListener = Nan::Get(signalObject, Nan::New<String>("removeEventListener").ToLocalChecked()).ToLocalChecked();
+		if (!removeEventListener->IsFunction()) return;
+
+		Local<Value> argv[] = { Nan::New<String>("abort").ToLocalChecked(), GetFromPersistent("abortListener") };
+		Nan::Call(removeEventListener.As<Function>(), signalObject, 2, argv);
+	}
+};
+
+#endif
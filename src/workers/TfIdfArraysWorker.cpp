@@ -1,41 +1,47 @@
 #include "nan.h"
+#include "RecommenderWorker.h"
 #include "../../include/recommender.h"
+#include "../../include/Utils.h"
 
 using namespace std;
 using namespace Nan;
 using namespace v8;
 
-class TfIdfArraysWorker : public AsyncWorker {
+class TfIdfArraysWorker : public RecommenderWorker {
 public:
 	TfIdfArraysWorker(Callback * callback, Recommender recommender, string query, vector<string> documents, bool useStopWords) :
-		AsyncWorker(callback),
-		recommender(recommender),
+		RecommenderWorker(callback, recommender),
 		query(query),
 		documents(documents),
 		useStopWords(useStopWords) {}
 
-	void Execute() {
-		this->recommender.tfidf(this->query, this->documents, this->useStopWords);
-		vector<double> recs = this->recommender.recommend(this->recommender.weights);
-		vector<string> sortedDocuments = this->recommender.getSortedDocuments(recs);
-		this->result = sortedDocuments;
+	void Compute() {
+		this->result = this->recommender.recommendDocuments(this->query, this->documents, this->useStopWords);
 	}
 
-	void HandleOKCallback() {
+	Local<Value> GetResult() {
 		int sortedDocumentsSize = this->result.size();
 		Local<Array> result = New<v8::Array>(sortedDocumentsSize);
 		for (int i = 0; i < sortedDocumentsSize; i++) {
 			Nan::Set(result, i, Nan::New<String>(this->result[i].c_str()).ToLocalChecked());
 		}
 
-		Local<Value> argv[] = { result };
-		callback->Call(1, argv);
+		return result;
+	}
+
+	string GetCoalescingKey() {
+		return "tfidf|" + to_string(Utils::hashStrings(this->documents, Utils::hashBytes(this->query.data(), this->query.size()))) + "|" +
+			to_string(this->useStopWords);
+	}
+
+	bool HasSameArguments(RecommenderWorker *leader) {
+		TfIdfArraysWorker *other = static_cast<TfIdfArraysWorker *>(leader);
+		return this->query == other->query && this->documents == other->documents;
 	}
 
 private:
-	Recommender recommender;
 	string query;
 	vector<string> documents;
 	bool useStopWords;
 	vector<string> result;
-};
\ No newline at end of file
+};
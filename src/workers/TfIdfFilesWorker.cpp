@@ -1,42 +1,44 @@
 #include "nan.h"
+#include "RecommenderWorker.h"
 #include "../../include/recommender.h"
+#include "../../include/Utils.h"
 
 using namespace std;
 using namespace Nan;
 using namespace v8;
 
-class TfIdfFilesWorker : public AsyncWorker {
+class TfIdfFilesWorker : public RecommenderWorker {
 public:
 	TfIdfFilesWorker(Callback * callback, Recommender recommender, string documentFilePath, string documentsFilePath, bool useStopWords) :
-		AsyncWorker(callback),
-		recommender(recommender),
+		RecommenderWorker(callback, recommender),
 		documentFilePath(documentFilePath),
 		documentsFilePath(documentsFilePath),
 		useStopWords(useStopWords) {}
 
-	void Execute() {
+	void Compute() {
 		this->recommender.tfidf(this->documentFilePath, this->documentsFilePath, this->useStopWords);
-		this->recommender.tfidf(documentFilePath, documentsFilePath, useStopWords);
 		vector<double> recs = this->recommender.recommend(this->recommender.weights);
 		vector<string> sortedDocuments = this->recommender.getSortedDocuments(recs);
 		this->result = sortedDocuments;
 	}
 
-	void HandleOKCallback() {
+	Local<Value> GetResult() {
 		int sortedDocumentsSize = this->result.size();
 		Local<Array> result = New<v8::Array>(sortedDocumentsSize);
 		for (int i = 0; i < sortedDocumentsSize; i++) {
 			Nan::Set(result, i, Nan::New<String>(this->result[i].c_str()).ToLocalChecked());
 		}
 
-		Local<Value> argv[] = { result };
-		callback->Call(1, argv);
+		return result;
+	}
+
+	string GetCoalescingKey() {
+		return "tfidfFiles|" + to_string(this->useStopWords) + "|" + this->documentFilePath + "|" + this->documentsFilePath;
 	}
 
 private:
-	Recommender recommender;
 	string documentFilePath;
 	string documentsFilePath;
 	bool useStopWords;
 	vector<string> result;
-};
\ No newline at end of file
+};
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "nan.h"
+#include "ExternalMemory.h"
+#include "../../include/recommender.h"
+#include "../../include/RatingMatrix.h"
+#include "../../include/Stats.h"
+
+using namespace std;
+using namespace Nan;
+using namespace v8;
+
+// Runs getAllTopCFRecommendations on the pool and streams every finished chunk
+// to onChunk. Chunks cross to the JS thread serialized as, per row:
+// int rowIndex, int count, then count times (int itemId, double rating).
+template <typename T>
+class TopCFBatchWorker : public AsyncProgressQueueWorker<char> {
+public:
+	TopCFBatchWorker(Callback *callback, Callback *chunkCallback, Recommender recommender, const RatingMatrix<T> &ratings,
+		vector<int> rowIndexes, int limit, int includeRatedItems, int chunkSize, int threads) :
+		AsyncProgressQueueWorker<char>(callback),
+		chunkCallback(chunkCallback),
+		recommender(recommender),
+		ratings(ratings),
+		rowIndexes(rowIndexes),
+		limit(limit),
+		includeRatedItems(includeRatedItems),
+		chunkSize(chunkSize),
+		threads(threads),
+		processed(0) {
+		this->external.set(this->ratings.getBytes());
+	}
+
+	~TopCFBatchWorker() {
+		delete this->chunkCallback;
+	}
+
+	void Execute(const ExecutionProgress &progress) {
+		if (this->recommender.cancellationToken && this->recommender.cancellationToken->isCancelled()) return;
+
+		this->processed = this->recommender.getAllTopCFRecommendations(this->ratings, this->rowIndexes, this->limit, this->includeRatedItems,
+			this->chunkSize, this->threads, [&progress](const Recommender::TopCFChunk &chunk) {
+				vector<char> data;
+				int chunkSize = chunk.size();
+				for (int i = 0; i < chunkSize; i++) {
+					int count = chunk[i].second.size();
+					TopCFBatchWorker::append(data, &chunk[i].first, sizeof(int));
+					TopCFBatchWorker::append(data, &count, sizeof(int));
+					for (int j = 0; j < count; j++) {
+						TopCFBatchWorker::append(data, &chunk[i].second[j].first, sizeof(int));
+						TopCFBatchWorker::append(data, &chunk[i].second[j].second, sizeof(double));
+					}
+				}
+				progress.Send(data.data(), data.size());
+			});
+	}
+
+	void HandleProgressCallback(const char *data, size_t size) {
+		HandleScope scope;
+		Local<Array> chunk;
+		{
+			StatsTimer timer(Stats::CONVERT);
+			chunk = TopCFBatchWorker::parseChunk(data, size);
+		}
+		Local<Value> argv[] = { chunk };
+		this->chunkCallback->Call(1, argv);
+	}
+
+	void HandleOKCallback() {
+		HandleScope scope;
+		// Chunks sent right before the end may not have been delivered yet.
+		this->WorkProgress();
+
+		CancellationToken::State state = CancellationToken::ACTIVE;
+		if (this->recommender.cancellationToken) state = this->recommender.cancellationToken->getState();
+		if (state == CancellationToken::ACTIVE) {
+			Local<Value> argv[] = { Nan::New(this->processed) };
+			callback->Call(1, argv);
+			return;
+		}
+
+		Stats::getInstance().add(Stats::CANCELLED);
+		Local<Object> status = Nan::New<Object>();
+		Nan::Set(status, Nan::New<String>("cancelled").ToLocalChecked(), Nan::True());
+		Nan::Set(status, Nan::New<String>("reason").ToLocalChecked(),
+			Nan::New<String>(state == CancellationToken::TIMED_OUT ? "timeout" : "abort").ToLocalChecked());
+		Local<Value> argv[] = { Nan::New(this->processed), status };
+		callback->Call(2, argv);
+	}
+
+private:
+	Callback *chunkCallback;
+	Recommender recommender;
+	RatingMatrix<T> ratings;
+	ExternalMemory external;
+	vector<int> rowIndexes;
+	int limit;
+	int includeRatedItems;
+	int chunkSize;
+	int threads;
+	int processed;
+
+	static void append(vector<char> &data, const void *value, size_t size) {
+		const char *bytes = static_cast<const char *>(value);
+		data.insert(data.end(), bytes, bytes + size);
+	}
+
+	static Local<Array> parseChunk(const char *data, size_t size) {
+		Local<Array> chunk = New<v8::Array>();
+		Local<String> rowIndexProp = Nan::New<String>("rowIndex").ToLocalChecked();
+		Local<String> recommendationsProp = Nan::New<String>("recommendations").ToLocalChecked();
+		Local<String> itemIdProp = Nan::New<String>("itemId").ToLocalChecked();
+		Local<String> ratingProp = Nan::New<String>("rating").ToLocalChecked();
+		size_t offset = 0;
+		unsigned rows = 0;
+		while (offset < size) {
+			int rowIndex;
+			int count;
+			memcpy(&rowIndex, data + offset, sizeof(int));
+			memcpy(&count, data + offset + sizeof(int), sizeof(int));
+			offset += 2 * sizeof(int);
+
+			Local<Array> recommendations = New<v8::Array>(count);
+			for (int j = 0; j < count; j++) {
+				int itemId;
+				double rating;
+				memcpy(&itemId, data + offset, sizeof(int));
+				memcpy(&rating, data + offset + sizeof(int), sizeof(double));
+				offset += sizeof(int) + sizeof(double);
+
+				Local<Object> obj = Nan::New<Object>();
+				Nan::Set(obj, itemIdProp, Nan::New<Number>(itemId));
+				Nan::Set(obj, ratingProp, Nan::New<Number>(rating));
+				Nan::Set(recommendations, j, obj);
+			}
+
+			Local<Object> row = Nan::New<Object>();
+			Nan::Set(row, rowIndexProp, Nan::New<Number>(rowIndex));
+			Nan::Set(row, recommendationsProp, recommendations);
+			Nan::Set(chunk, rows++, row);
+		}
+
+		return chunk;
+	}
+};
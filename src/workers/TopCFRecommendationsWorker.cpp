@@ -1,25 +1,31 @@
 #include "nan.h"
+#include "ExternalMemory.h"
+#include "RecommenderWorker.h"
 #include "../../include/recommender.h"
+#include "../../include/Utils.h"
+#include "../../include/RatingMatrix.h"
 
 using namespace std;
 using namespace Nan;
 using namespace v8;
 
-class TopCFRecommendationsWorker : public AsyncWorker {
+template <typename T>
+class TopCFRecommendationsWorker : public RecommenderWorker {
 public:
-	TopCFRecommendationsWorker(Callback * callback, Recommender recommender, vector<vector<double>> ratings, int rowIndex, int limit, int includeRatedItems) :
-		AsyncWorker(callback),
-		recommender(recommender),
+	TopCFRecommendationsWorker(Callback * callback, Recommender recommender, const RatingMatrix<T> &ratings, int rowIndex, int limit, int includeRatedItems) :
+		RecommenderWorker(callback, recommender),
 		ratings(ratings),
 		rowIndex(rowIndex),
 		limit(limit),
-		includeRatedItems(includeRatedItems) {}
+		includeRatedItems(includeRatedItems) {
+		this->external.set(this->ratings.getBytes());
+	}
 
-	void Execute() {
+	void Compute() {
 		this->result = this->recommender.getTopCFRecommendations(this->ratings, this->rowIndex, this->limit, this->includeRatedItems);
 	}
 
-	void HandleOKCallback() {
+	Local<Value> GetResult() {
 		Local<Array> result = New<v8::Array>();
 		for (unsigned i = 0; i < this->result.size(); i++) {
 			Local<Object> obj = Nan::New<Object>();
@@ -30,15 +36,26 @@ public:
 
 			Nan::Set(result, i, obj);
 		}
-		Local<Value> argv[] = { result };
-		callback->Call(1, argv);
+
+		return result;
+	}
+
+	string GetCoalescingKey() {
+		return string("topcf|") + StorageTraits<T>::getName() + "|" +
+			to_string(this->ratings.getVersion()) + "|" + to_string(this->rowIndex) + "|" + to_string(this->limit) + "|" +
+			to_string(this->includeRatedItems) + "|" + to_string(this->recommender.minCoRatings);
+	}
+
+	// The key names the worker and its storage, so the leader has this type.
+	bool HasSameArguments(RecommenderWorker *leader) {
+		return this->ratings.equals(static_cast<TopCFRecommendationsWorker<T> *>(leader)->ratings);
 	}
 
 private:
-	Recommender recommender;
-	vector<vector<double>> ratings;
+	RatingMatrix<T> ratings;
+	ExternalMemory external;
 	int rowIndex;
 	int limit;
 	int includeRatedItems;
 	vector<pair<int, double>> result;
-};
\ No newline at end of file
+};